@@ -0,0 +1,33 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+bool arena_init(Arena *a, size_t capacity) {
+  a->capacity = arena_round(capacity);
+  a->used = 0;
+  a->raw = malloc(a->capacity + ARENA_ALIGN);
+  if (a->raw == NULL) {
+    a->base = NULL;
+    return false;
+  }
+  uintptr_t p = (uintptr_t)a->raw;
+  a->base = (unsigned char *)((p + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN);
+  return true;
+}
+
+void arena_free(Arena *a) {
+  free(a->raw);
+  a->raw = NULL;
+  a->base = NULL;
+  a->capacity = 0;
+  a->used = 0;
+}
+
+void *arena_alloc(Arena *a, size_t size) {
+  size = arena_round(size);
+  if (size > a->capacity - a->used) return NULL;
+  void *p = a->base + a->used;
+  a->used += size;
+  return p;
+}
@@ -0,0 +1,31 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Every allocation is aligned to a cache line, which is also the width of
+ * an AVX-512 register. */
+#define ARENA_ALIGN 64
+
+/* A bump allocator over one block reserved up front. Allocations are never
+ * freed one by one, the whole arena goes away at once. */
+typedef struct {
+  void *raw;
+  unsigned char *base;
+  size_t capacity;
+  size_t used;
+} Arena;
+
+/* Round size up to the arena alignment. */
+static inline size_t arena_round(size_t size) {
+  return (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+}
+
+bool arena_init(Arena *a, size_t capacity);
+void arena_free(Arena *a);
+
+/* Return size bytes aligned to ARENA_ALIGN, or NULL if the arena is full. */
+void *arena_alloc(Arena *a, size_t size);
+
+#endif // ARENA_H_
@@ -0,0 +1,535 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "bitrow.h"
+#include "lifegrid.h"
+#include "hashlife.h"
+#include "lifepool.h"
+#include "lifetiles.h"
+#include "lifeplane.h"
+#include "rule.h"
+
+/* Generations run by the cross-check against the reference implementations. */
+#define CHECK_GENERATIONS 8
+
+/* Largest board (in cells) still cross-checked, the reference is slow. */
+#define CHECK_MAX_CELLS (1 << 20)
+
+typedef enum {
+  RULE110_WORD,
+  RULE110_LUT,
+  LIFE_SCALAR,
+  LIFE_AVX2,
+  LIFE_AVX512,
+  LIFE_POOL,
+  LIFE_TILES,
+  LIFE_PLANE,
+  LIFE_HASHLIFE,
+  BACKEND_COUNT
+} Backend;
+
+static const char *backend_names[BACKEND_COUNT] = {
+  [RULE110_WORD] = "word",
+  [RULE110_LUT] = "lut",
+  [LIFE_SCALAR] = "scalar",
+  [LIFE_AVX2] = "avx2",
+  [LIFE_AVX512] = "avx512",
+  [LIFE_POOL] = "pool",
+  [LIFE_TILES] = "tiles",
+  [LIFE_PLANE] = "plane",
+  [LIFE_HASHLIFE] = "hashlife",
+};
+
+typedef struct {
+  Backend backend;
+  size_t width;
+  size_t height;
+  double density;
+  size_t generations;
+  bool check;
+  uint8_t wolfram; // the rule of the 1D backends
+  LifeRule life_rule; // the rule of the Life backends, all but B3/S23 only on the board stepper
+} Case;
+
+/* Rules besides B3/S23 and Rule 110, on the kernels made for them: HighLife,
+ * Day & Night and Seeds have one each, B35/S236 has none and runs on the
+ * generic kernel. */
+static const char *const life_rules[] = {"B36/S23", "B3678/S34678", "B2/S", "B35/S236"};
+static const uint8_t elementary_rules[] = {30, 90, 184};
+
+/* What the child process running a case sends back to the parent. */
+typedef struct {
+  int status; // 1 matches the reference, 0 does not, 2 unchecked, -1 not supported here
+  double seconds;
+} Outcome;
+
+static size_t threads = 1;
+
+static bool is_rule110(Backend b) {
+  return b == RULE110_WORD || b == RULE110_LUT;
+}
+
+/* The unbounded backends are far slower per cell on random soup, so they
+ * get a smaller share of the work budget. */
+static bool is_unbounded(Backend b) {
+  return b == LIFE_PLANE || b == LIFE_HASHLIFE;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* xorshift64*, seeded per case so every backend sees the same soup. */
+static uint64_t rng_state;
+
+static bool random_cell(double density) {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return (double)((rng_state * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53) < density;
+}
+
+/* The original scalar steppers of rule110.c and game_of_life.c, the
+ * reference the optimized backends are checked against. Besides taking
+ * their sizes and rule at runtime, the Life wrap is fixed: cell_to_index
+ * wrapped y at COLS and indexed rows by ROWS, which only held on square
+ * boards. Other elementary rules only change ref_patterns. */
+
+char ref_patterns[8] = {
+  [0b000] = 0,
+  [0b001] = 1,
+  [0b010] = 1,
+  [0b011] = 1,
+  [0b100] = 0,
+  [0b101] = 1,
+  [0b110] = 1,
+  [0b111] = 0,
+};
+
+void ref_next_row(const char *prev, char *next, size_t width) {
+  memset(next, 0, width);
+  for (size_t i = 1; i + 1 < width; ++i) {
+    int pattern_index = prev[i-1]<<2 | prev[i]<<1 | prev[i+1];
+    next[i] = ref_patterns[pattern_index];
+  }
+}
+
+char ref_get_cell(const char *grid, int x, int y, int cols, int rows) {
+  if (x>=cols) x %=cols;
+  if (y>=rows) y %=rows;
+
+  if (x<0) {
+    x = (-x) % cols;
+    x = cols - x;
+  };
+  if (y<0) {
+    y = (-y) % rows;
+    y = rows - y;
+  };
+  return grid[y*cols+x];
+}
+
+int ref_count_living_neighbors(const char *grid, int x, int y, int cols, int rows) {
+  int alive = 0;
+  for (int yo=-1; yo<=1; yo++) {
+    for (int xo=-1; xo<=1; xo++) {
+      if (xo == 0 && yo == 0) continue;
+      if (ref_get_cell(grid, x+xo, y+yo, cols, rows)) alive++;
+    }
+  }
+  return alive;
+}
+
+void ref_compute_new_state(const char *old, char *new, int cols, int rows, LifeRule rule) {
+  for (int y=0; y<rows; y++) {
+    for (int x=0; x<cols; x++) {
+      int n_alive = ref_count_living_neighbors(old, x, y, cols, rows);
+      int new_state = 0;
+      if (ref_get_cell(old, x, y, cols, rows)) {
+        if (rule.survive >> n_alive & 1) new_state = 1;
+      } else {
+          if (rule.birth >> n_alive & 1) new_state = 1;
+      }
+      new[y*cols+x] = new_state;
+    }
+  }
+}
+
+/* The kernel of the elementary rule of the case. */
+static RowStepFn rule_step = bitrow_rule110;
+
+/* Same fixed borders as next_row in rule110.c. */
+static void pinned_rule110(const BitRow *prev, BitRow *next) {
+  rule_step(prev, next);
+  bitrow_set(next, 0, false);
+  bitrow_set(next, next->width - 1, false);
+}
+
+static Rule110Lut lut;
+
+static void rule110_advance(Backend b, Tape *tape, size_t n) {
+  if (b == RULE110_LUT) {
+    for (; n >= RULE110_LUT_STEPS; n -= RULE110_LUT_STEPS) {
+      rule110_lut_step(&lut, tape_current(tape), tape_next(tape), pinned_rule110);
+      tape_swap(tape);
+    }
+  }
+  // The rest one generation at a time
+  for (; n > 0; --n) {
+    pinned_rule110(tape_current(tape), tape_next(tape));
+    tape_swap(tape);
+  }
+}
+
+static Outcome run_rule110(const Case *c) {
+  Outcome out = {-1, 0};
+  Tape tape;
+  char *ref = malloc(c->width), *ref_next = malloc(c->width);
+  if (ref == NULL || ref_next == NULL || !tape_init(&tape, c->width)) return out;
+  rule_step = bitrow_elementary(c->wolfram);
+  if (c->backend == RULE110_LUT) elementary_lut_init(&lut, c->wolfram);
+  for (int i = 0; i < 8; ++i) ref_patterns[i] = c->wolfram >> i & 1;
+
+  for (size_t i = 0; i < c->width; ++i) {
+    ref[i] = random_cell(c->density);
+    bitrow_set(tape_current(&tape), i, ref[i]);
+  }
+  out.status = 2;
+  if (c->check) {
+    rule110_advance(c->backend, &tape, CHECK_GENERATIONS);
+    for (size_t g = 0; g < CHECK_GENERATIONS; ++g) {
+      ref_next_row(ref, ref_next, c->width);
+      char *t = ref; ref = ref_next; ref_next = t;
+    }
+    out.status = 1;
+    for (size_t i = 0; i < c->width; ++i) {
+      if (bitrow_get(tape_current(&tape), i) != ref[i]) out.status = 0;
+    }
+  }
+
+  double start = now();
+  rule110_advance(c->backend, &tape, c->generations);
+  out.seconds = now() - start;
+
+  tape_free(&tape);
+  free(ref);
+  free(ref_next);
+  return out;
+}
+
+/* The torus backends step the board in place. */
+static void life_advance(const Case *c, LifeBoard *board, LifePool *pool, LifeTiles *tiles, size_t n) {
+  switch (c->backend) {
+  case LIFE_POOL:
+    lifepool_step(pool, n);
+    break;
+  case LIFE_TILES:
+    for (size_t g = 0; g < n; ++g) lifetiles_step(tiles);
+    break;
+  default:
+    for (size_t g = 0; g < n; ++g) lifeboard_step(board);
+    break;
+  }
+}
+
+static Outcome run_life_torus(const Case *c, const char *ref) {
+  Outcome out = {-1, 0};
+  static const LifeKernel kernels[BACKEND_COUNT] = {
+    [LIFE_SCALAR] = LIFE_KERNEL_SCALAR,
+    [LIFE_AVX2] = LIFE_KERNEL_AVX2,
+    [LIFE_AVX512] = LIFE_KERNEL_AVX512,
+  };
+  if (kernels[c->backend] != LIFE_KERNEL_AUTO && !lifegrid_use_kernel(kernels[c->backend])) return out;
+
+  LifeBoard board;
+  if (!lifeboard_init(&board, c->width, c->height)) return out;
+  LifeGrid *grid = lifeboard_current(&board);
+  for (size_t y = 0; y < c->height; ++y) {
+    for (size_t x = 0; x < c->width; ++x) {
+      lifegrid_set(grid, x, y, ref[y * c->width + x]);
+    }
+  }
+
+  LifePool *pool = NULL;
+  LifeTiles tiles;
+  if (c->backend == LIFE_POOL && (pool = lifepool_new(&board, threads)) == NULL) return out;
+  if (c->backend == LIFE_TILES && !lifetiles_init(&tiles, &board)) return out;
+
+  out.status = 2;
+  if (c->check) {
+    life_advance(c, &board, pool, &tiles, CHECK_GENERATIONS);
+    grid = lifeboard_current(&board);
+    out.status = 1;
+    for (size_t y = 0; y < c->height; ++y) {
+      for (size_t x = 0; x < c->width; ++x) {
+        if (lifegrid_get(grid, x, y) != ref[y * c->width + x + c->width * c->height]) out.status = 0;
+      }
+    }
+  }
+
+  double start = now();
+  life_advance(c, &board, pool, &tiles, c->generations);
+  out.seconds = now() - start;
+
+  if (pool) lifepool_free(pool);
+  if (c->backend == LIFE_TILES) lifetiles_free(&tiles);
+  lifeboard_free(&board);
+  return out;
+}
+
+/* The soup sits in the middle of a reference torus with a margin wider than
+ * anything can travel during the check, so the torus and the plane agree. */
+static Outcome run_life_unbounded(const Case *c, const char *ref, size_t margin) {
+  Outcome out = {-1, 0};
+  LifeGrid soup, view;
+  if (!lifegrid_init(&soup, c->width, c->height)) return out;
+  if (!lifegrid_init(&view, c->width + 2 * margin, c->height + 2 * margin)) return out;
+  size_t rw = view.width, rh = view.height;
+  for (size_t y = 0; y < c->height; ++y) {
+    for (size_t x = 0; x < c->width; ++x) {
+      lifegrid_set(&soup, x, y, ref[(y + margin) * rw + x + margin]);
+    }
+  }
+
+  LifePlane *plane = NULL;
+  HashLife *hl = NULL;
+  if (c->backend == LIFE_PLANE) {
+    if ((plane = lifeplane_new()) == NULL) return out;
+    lifeplane_load(plane, &soup, 0, 0);
+  } else {
+    if ((hl = hashlife_new(4 * 1024 * 1024)) == NULL) return out;
+    hashlife_load(hl, &soup, 0, 0);
+  }
+
+  out.status = 2;
+  if (c->check) {
+    if (plane) {
+      for (size_t g = 0; g < CHECK_GENERATIONS; ++g) lifeplane_step(plane);
+      lifeplane_read(plane, -(int64_t)margin, -(int64_t)margin, &view);
+    } else {
+      hashlife_step(hl, CHECK_GENERATIONS);
+      hashlife_read(hl, -(int64_t)margin, -(int64_t)margin, &view);
+    }
+    out.status = 1;
+    for (size_t y = 0; y < rh; ++y) {
+      for (size_t x = 0; x < rw; ++x) {
+        if (lifegrid_get(&view, x, y) != ref[y * rw + x + rw * rh]) out.status = 0;
+      }
+    }
+  }
+
+  double start = now();
+  if (plane) {
+    for (size_t g = 0; g < c->generations; ++g) lifeplane_step(plane);
+  } else {
+    hashlife_step(hl, c->generations);
+  }
+  out.seconds = now() - start;
+
+  if (plane) lifeplane_free(plane);
+  if (hl) hashlife_free(hl);
+  lifegrid_free(&soup);
+  lifegrid_free(&view);
+  return out;
+}
+
+/* Fill the reference board with the soup (surrounded by margin dead cells)
+ * and run the reference for CHECK_GENERATIONS; ref holds the start and the
+ * expected end state one after the other. */
+static Outcome run_life(const Case *c) {
+  size_t margin = is_unbounded(c->backend) ? CHECK_GENERATIONS + 1 : 0;
+  size_t rw = c->width + 2 * margin, rh = c->height + 2 * margin;
+  char *ref = calloc(2 * rw * rh, 1);
+  char *tmp = malloc(rw * rh);
+  if (ref == NULL || tmp == NULL) return (Outcome){-1, 0};
+
+  for (size_t y = 0; y < c->height; ++y) {
+    for (size_t x = 0; x < c->width; ++x) {
+      ref[(y + margin) * rw + x + margin] = random_cell(c->density);
+    }
+  }
+  char *end = ref + rw * rh;
+  memcpy(end, ref, rw * rh);
+  for (size_t g = 0; c->check && g < CHECK_GENERATIONS; ++g) {
+    ref_compute_new_state(end, tmp, rw, rh, c->life_rule);
+    memcpy(end, tmp, rw * rh);
+  }
+
+  Outcome out = margin ? run_life_unbounded(c, ref, margin) : run_life_torus(c, ref);
+  free(ref);
+  free(tmp);
+  return out;
+}
+
+/* Run a case in a child process, so the peak memory that wait4 reports is
+ * the case's own and nothing one backend allocates stays around for the next. */
+static bool run_case(const Case *c, Outcome *out, long *peak_kib) {
+  int fds[2];
+  if (pipe(fds) != 0) return false;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) return false;
+  if (pid == 0) {
+    close(fds[0]);
+    rng_state = 0x9E3779B97F4A7C15ULL ^ (c->width * 31 + c->height) ^ (uint64_t)(c->density * 1e6);
+    lifegrid_use_rule(c->life_rule);
+    Outcome o = is_rule110(c->backend) ? run_rule110(c) : run_life(c);
+    ssize_t written = write(fds[1], &o, sizeof(o));
+    _exit(written == sizeof(o) ? 0 : 1);
+  }
+  close(fds[1]);
+  ssize_t got = read(fds[0], out, sizeof(*out));
+  close(fds[0]);
+
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) < 0 || got != sizeof(*out)) return false;
+#ifdef __APPLE__
+  *peak_kib = usage.ru_maxrss / 1024;
+#else
+  *peak_kib = usage.ru_maxrss;
+#endif
+  return true;
+}
+
+/* The rule column: rule110 and life for the classic pair, the Wolfram
+ * number or B/S notation for the others. */
+static void rule_name(const Case *c, char *out) {
+  LifeRule conway = {LIFE_RULE_CONWAY_BIRTH, LIFE_RULE_CONWAY_SURVIVE};
+  if (is_rule110(c->backend)) {
+    snprintf(out, LIFE_RULE_TEXT_MAX, "rule%u", c->wolfram);
+  } else if (liferule_equal(c->life_rule, conway)) {
+    strcpy(out, "life");
+  } else {
+    liferule_format(c->life_rule, out);
+  }
+}
+
+/* Run the case if its cell updates fit in the budget and print its row.
+ * Returns false if the case could not be run at all. */
+static bool bench_case(Case *c, double budget, bool quick, FILE *csv, int *failures) {
+  double updates = (double)c->width * c->height * c->generations;
+  if (updates > (is_unbounded(c->backend) ? budget / 64 : budget)) return true;
+  c->check = c->width * c->height <= (quick ? CHECK_MAX_CELLS / 16 : CHECK_MAX_CELLS);
+
+  Outcome out;
+  long peak_kib;
+  if (!run_case(c, &out, &peak_kib)) {
+    fprintf(stderr, "ERROR: could not run %s %zux%zu\n", backend_names[c->backend], c->width, c->height);
+    return false;
+  }
+  if (out.status < 0) return true;
+  const char *check = out.status == 2 ? "-" : out.status ? "ok" : "MISMATCH";
+  *failures += out.status == 0;
+
+  char rule[LIFE_RULE_TEXT_MAX];
+  rule_name(c, rule);
+  double rate = updates / out.seconds;
+  printf("%-12s %-9s %9zu %6zu %5.2f %6zu %11.3e %9.4f %10ld  %s\n",
+         rule, backend_names[c->backend], c->width, c->height,
+         c->density, c->generations, rate, 1e9 / rate, peak_kib, check);
+  if (csv != NULL) {
+    fprintf(csv, "%s,%s,%zu,%zu,%.2f,%zu,%.6f,%.6e,%.6f,%ld,%s\n",
+            rule, backend_names[c->backend], c->width, c->height,
+            c->density, c->generations, out.seconds, rate, 1e9 / rate, peak_kib, check);
+  }
+  return true;
+}
+
+static void usage(const char *program) {
+  fprintf(stderr, "Usage: %s [--quick] [--threads N] [--csv <file>]\n", program);
+}
+
+int main(int argc, char **argv) {
+  bool quick = false;
+  const char *csv_path = NULL;
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  threads = cpus > 0 ? (size_t)cpus : 1;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--quick") == 0) {
+      quick = true;
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      threads = (size_t)atoi(argv[++i]);
+      if (threads == 0) {
+        fprintf(stderr, "ERROR: invalid thread count '%s'\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+      csv_path = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  FILE *csv = NULL;
+  if (csv_path != NULL) {
+    csv = fopen(csv_path, "w");
+    if (csv == NULL) {
+      fprintf(stderr, "ERROR: could not open %s\n", csv_path);
+      return 1;
+    }
+    fprintf(csv, "automaton,backend,width,height,density,generations,seconds,"
+                 "cells_per_second,ns_per_cell,peak_rss_kib,check\n");
+  }
+
+  // A case runs only if its cell updates fit in the budget
+  double budget = quick ? 1e8 : 4e9;
+  // Both lists have the same length, one for each automaton
+  static const size_t tape_widths[] = {1024, 65536, 1 << 20, 1 << 24};
+  static const size_t board_sizes[] = {64, 256, 1024, 4096};
+  static const double densities[] = {0.05, 0.25, 0.5};
+  static const size_t generation_counts[] = {16, 256, 4096};
+
+  LifeRule conway = {LIFE_RULE_CONWAY_BIRTH, LIFE_RULE_CONWAY_SURVIVE};
+  int failures = 0;
+  printf("%-12s %-9s %9s %6s %5s %6s %11s %9s %10s  %s\n",
+         "rule", "backend", "width", "height", "dens", "gens", "cells/s", "ns/cell", "peak KiB", "check");
+  for (Backend b = 0; b < BACKEND_COUNT; ++b) {
+    for (size_t s = 0; s < 4; ++s) {
+      for (size_t d = 0; d < sizeof(densities) / sizeof(densities[0]); ++d) {
+        for (size_t n = 0; n < sizeof(generation_counts) / sizeof(generation_counts[0]); ++n) {
+          Case c = {b, 0, 0, densities[d], generation_counts[n], false, 110, conway};
+          c.width = is_rule110(b) ? tape_widths[s] : board_sizes[s];
+          c.height = is_rule110(b) ? 1 : board_sizes[s];
+          if (!bench_case(&c, budget, quick, csv, &failures)) return 1;
+        }
+      }
+    }
+  }
+
+  // The other rules at one density and length, to set against the rows of
+  // B3/S23 on the scalar kernel and of Rule 110 above
+  for (size_t s = 0; s < 4; ++s) {
+    for (size_t r = 0; r < sizeof(life_rules) / sizeof(life_rules[0]); ++r) {
+      Case c = {LIFE_SCALAR, board_sizes[s], board_sizes[s], densities[1], generation_counts[1], false, 110, conway};
+      if (!liferule_parse(life_rules[r], &c.life_rule)) return 1;
+      if (!bench_case(&c, budget, quick, csv, &failures)) return 1;
+    }
+    for (size_t r = 0; r < sizeof(elementary_rules) / sizeof(elementary_rules[0]); ++r) {
+      for (Backend b = RULE110_WORD; b <= RULE110_LUT; ++b) {
+        Case c = {b, tape_widths[s], 1, densities[1], generation_counts[1], false, elementary_rules[r], conway};
+        if (!bench_case(&c, budget, quick, csv, &failures)) return 1;
+      }
+    }
+  }
+
+  if (csv != NULL) fclose(csv);
+  if (failures > 0) {
+    fprintf(stderr, "ERROR: %d runs did not match the reference\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,228 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitrow.h"
+
+bool bitrow_init(BitRow *row, size_t width) {
+  row->width = width;
+  row->words = bitrow_words(width);
+  row->owned = true;
+  row->bits = calloc(row->words ? row->words : 1, sizeof(uint64_t));
+  return row->bits != NULL;
+}
+
+bool bitrow_init_arena(BitRow *row, size_t width, Arena *arena) {
+  row->width = width;
+  row->words = bitrow_words(width);
+  row->owned = false;
+  row->bits = arena_alloc(arena, (row->words ? row->words : 1) * sizeof(uint64_t));
+  if (row->bits == NULL) return false;
+  bitrow_clear(row);
+  return true;
+}
+
+void bitrow_free(BitRow *row) {
+  if (row->owned) free(row->bits);
+  row->bits = NULL;
+  row->width = 0;
+  row->words = 0;
+}
+
+void bitrow_clear(BitRow *row) {
+  memset(row->bits, 0, row->words * sizeof(uint64_t));
+}
+
+void bitrow_copy(BitRow *dst, const BitRow *src) {
+  assert(dst->width == src->width);
+  memcpy(dst->bits, src->bits, src->words * sizeof(uint64_t));
+}
+
+size_t bitrow_popcount(const BitRow *row) {
+  size_t count = 0;
+  for (size_t w = 0; w < row->words; ++w) {
+    count += __builtin_popcountll(row->bits[w]);
+  }
+  return count;
+}
+
+/* Rule 110 maps the neighbourhood (l,c,r) to 1 for 001,010,011,101,110 and
+ * to 0 for 000,100,111, which is the same as (c XOR r) OR (c AND NOT l).
+ * The left and right neighbours of a whole word are the word shifted by one,
+ * with the bit that crosses the word boundary carried in from its neighbour. */
+void bitrow_rule110(const BitRow *prev, BitRow *next) {
+  assert(prev->width == next->width);
+  const uint64_t *p = prev->bits;
+  uint64_t *n = next->bits;
+  size_t words = prev->words;
+  if (words == 0) return;
+
+  uint64_t carry = 0;
+  for (size_t w = 0; w + 1 < words; ++w) {
+    uint64_t c = p[w];
+    uint64_t l = (c << 1) | carry;
+    uint64_t r = (c >> 1) | (p[w + 1] << 63);
+    n[w] = (c ^ r) | (c & ~l);
+    carry = c >> 63;
+  }
+
+  uint64_t c = p[words - 1];
+  uint64_t l = (c << 1) | carry;
+  uint64_t r = c >> 1;
+  n[words - 1] = ((c ^ r) | (c & ~l)) & bitrow_tail_mask(prev->width);
+}
+
+/* Bit k of an elementary rule is the next state of a cell whose left
+ * neighbour, itself and its right neighbour spell k in binary, so the word
+ * is the OR of the minterms of the set bits. With a constant rule the
+ * minterms of the clear bits fold away and the compiler merges the rest. */
+static inline __attribute__((always_inline)) uint64_t elementary_word(uint8_t rule, uint64_t l, uint64_t c, uint64_t r) {
+  return (rule & 0x01 ? ~l & ~c & ~r : 0) | (rule & 0x02 ? ~l & ~c & r : 0) |
+         (rule & 0x04 ? ~l & c & ~r : 0) | (rule & 0x08 ? ~l & c & r : 0) |
+         (rule & 0x10 ? l & ~c & ~r : 0) | (rule & 0x20 ? l & ~c & r : 0) |
+         (rule & 0x40 ? l & c & ~r : 0) | (rule & 0x80 ? l & c & r : 0);
+}
+
+/* bitrow_rule110 for any rule, meant to be inlined with a constant rule. */
+static inline __attribute__((always_inline)) void elementary_step(uint8_t rule, const BitRow *prev, BitRow *next) {
+  assert(prev->width == next->width);
+  const uint64_t *p = prev->bits;
+  uint64_t *n = next->bits;
+  size_t words = prev->words;
+  if (words == 0) return;
+
+  uint64_t carry = 0;
+  for (size_t w = 0; w + 1 < words; ++w) {
+    uint64_t c = p[w];
+    n[w] = elementary_word(rule, (c << 1) | carry, c, (c >> 1) | (p[w + 1] << 63));
+    carry = c >> 63;
+  }
+
+  uint64_t c = p[words - 1];
+  n[words - 1] = elementary_word(rule, (c << 1) | carry, c, c >> 1) & bitrow_tail_mask(prev->width);
+}
+
+/* One kernel per rule, elementary_0x00 to elementary_0xff, and a table of
+ * them in rule order. */
+#define ELEMENTARY_KERNEL(n) \
+  static void elementary_##n(const BitRow *prev, BitRow *next) { elementary_step(n, prev, next); }
+#define ELEMENTARY_ENTRY(n) elementary_##n,
+#define ELEMENTARY_16(X, h) \
+  X(0x##h##0) X(0x##h##1) X(0x##h##2) X(0x##h##3) X(0x##h##4) X(0x##h##5) X(0x##h##6) X(0x##h##7) \
+  X(0x##h##8) X(0x##h##9) X(0x##h##a) X(0x##h##b) X(0x##h##c) X(0x##h##d) X(0x##h##e) X(0x##h##f)
+#define ELEMENTARY_256(X) \
+  ELEMENTARY_16(X, 0) ELEMENTARY_16(X, 1) ELEMENTARY_16(X, 2) ELEMENTARY_16(X, 3) \
+  ELEMENTARY_16(X, 4) ELEMENTARY_16(X, 5) ELEMENTARY_16(X, 6) ELEMENTARY_16(X, 7) \
+  ELEMENTARY_16(X, 8) ELEMENTARY_16(X, 9) ELEMENTARY_16(X, a) ELEMENTARY_16(X, b) \
+  ELEMENTARY_16(X, c) ELEMENTARY_16(X, d) ELEMENTARY_16(X, e) ELEMENTARY_16(X, f)
+
+ELEMENTARY_256(ELEMENTARY_KERNEL)
+
+static const RowStepFn elementary_kernels[256] = {ELEMENTARY_256(ELEMENTARY_ENTRY)};
+
+RowStepFn bitrow_elementary(uint8_t rule) {
+  // Rule 110 keeps its hand simplified kernel
+  return rule == 110 ? bitrow_rule110 : elementary_kernels[rule];
+}
+
+/* Every entry is computed by running the window RULE110_LUT_STEPS times with
+ * dead cells around it. The wrong guess about the outside only travels one
+ * cell per generation, so the centre cells come out exact. */
+void elementary_lut_init(Rule110Lut *lut, uint8_t rule) {
+  uint64_t mask = ((uint64_t)1 << RULE110_LUT_IN) - 1;
+  for (uint64_t window = 0; window <= mask; ++window) {
+    uint64_t c = window;
+    for (int g = 0; g < RULE110_LUT_STEPS; ++g) {
+      c = elementary_word(rule, c << 1, c, c >> 1) & mask;
+    }
+    lut->table[window] = (uint8_t)(c >> RULE110_LUT_STEPS);
+  }
+}
+
+void rule110_lut_init(Rule110Lut *lut) {
+  elementary_lut_init(lut, 110);
+}
+
+/* Step the row s times with edge_step, alternating between the row and tmp;
+ * the result ends up back in the row since s is even. */
+static void step_exact(BitRow *row, BitRow *tmp, int s, RowStepFn edge_step) {
+  for (int g = 0; g < s; g += 2) {
+    edge_step(row, tmp);
+    edge_step(tmp, row);
+  }
+}
+
+void rule110_lut_step(const Rule110Lut *lut, const BitRow *prev, BitRow *next, RowStepFn edge_step) {
+  enum { K = RULE110_LUT_STEPS, EDGE_WORDS = 3 };
+  assert(prev->width == next->width);
+  const uint64_t *p = prev->bits;
+  uint64_t *n = next->bits;
+  size_t words = prev->words;
+
+  // Short tapes are all edge
+  uint64_t a_bits[2 * EDGE_WORDS], b_bits[2 * EDGE_WORDS];
+  if (words <= 2 * EDGE_WORDS) {
+    BitRow a = {prev->width, words, a_bits, false}, b = {prev->width, words, b_bits, false};
+    memcpy(a_bits, p, words * sizeof(uint64_t));
+    step_exact(&a, &b, K, edge_step);
+    memcpy(n, a_bits, words * sizeof(uint64_t));
+    return;
+  }
+
+  // Byte j of the output needs cells 8j-K to 8j+8+K of the input
+  for (size_t w = 0; w < words; ++w) {
+    uint64_t before = w > 0 ? p[w - 1] : 0;
+    uint64_t c = p[w];
+    uint64_t after = w + 1 < words ? p[w + 1] : 0;
+    uint64_t out = lut->table[((c << K) | (before >> (64 - K))) & 0xffff];
+    for (int b = 1; b < 7; ++b) {
+      out |= (uint64_t)lut->table[(c >> (8 * b - K)) & 0xffff] << (8 * b);
+    }
+    out |= (uint64_t)lut->table[((c >> (56 - K)) | (after << (8 + K))) & 0xffff] << 56;
+    n[w] = out;
+  }
+  n[words - 1] &= bitrow_tail_mask(prev->width);
+
+  // Redo the first word from the first EDGE_WORDS words, whose own right end
+  // is only wrong K cells deep, and the same for the last words on the right
+  BitRow a = {EDGE_WORDS * 64, EDGE_WORDS, a_bits, false}, b = {EDGE_WORDS * 64, EDGE_WORDS, b_bits, false};
+  memcpy(a_bits, p, EDGE_WORDS * sizeof(uint64_t));
+  step_exact(&a, &b, K, edge_step);
+  n[0] = a_bits[0];
+
+  size_t first = words - EDGE_WORDS;
+  a.width = b.width = prev->width - first * 64;
+  memcpy(a_bits, p + first, EDGE_WORDS * sizeof(uint64_t));
+  step_exact(&a, &b, K, edge_step);
+  n[words - 2] = a_bits[EDGE_WORDS - 2];
+  n[words - 1] = a_bits[EDGE_WORDS - 1];
+}
+
+bool tape_init(Tape *t, size_t width) {
+  size_t bytes = arena_round((bitrow_words(width) ? bitrow_words(width) : 1) * sizeof(uint64_t));
+  t->current = 0;
+  if (!arena_init(&t->arena, 2 * bytes)) return false;
+  if (!bitrow_init_arena(&t->rows[0], width, &t->arena) ||
+      !bitrow_init_arena(&t->rows[1], width, &t->arena)) {
+    arena_free(&t->arena);
+    return false;
+  }
+  return true;
+}
+
+bool tape_init_bits(Tape *t, size_t width, uint64_t *bits) {
+  size_t bytes = arena_round((bitrow_words(width) ? bitrow_words(width) : 1) * sizeof(uint64_t));
+  t->current = 0;
+  t->rows[0] = (BitRow){width, bitrow_words(width), bits, false};
+  if (!arena_init(&t->arena, bytes)) return false;
+  if (!bitrow_init_arena(&t->rows[1], width, &t->arena)) {
+    arena_free(&t->arena);
+    return false;
+  }
+  return true;
+}
+
+void tape_free(Tape *t) {
+  arena_free(&t->arena);
+  t->rows[0].bits = t->rows[1].bits = NULL;
+}
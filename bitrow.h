@@ -0,0 +1,114 @@
+#ifndef BITROW_H_
+#define BITROW_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+#define BITROW_WORD_BITS 64
+
+/* The k-step lookup table maps a window of 2k+w cells to its w centre cells
+ * k generations later: 16 cells in, 8 cells out, 4 generations per lookup. */
+#define RULE110_LUT_STEPS 4
+#define RULE110_LUT_OUT 8
+#define RULE110_LUT_IN (2 * RULE110_LUT_STEPS + RULE110_LUT_OUT)
+
+/* A row of cells packed 64 per machine word. Cell i lives in bit i%64 of
+ * word i/64, the bits past width in the last word are always kept at zero. */
+typedef struct {
+  size_t width;
+  size_t words;
+  uint64_t *bits;
+  bool owned; // freed by bitrow_free, unlike bits in an arena or borrowed
+} BitRow;
+
+/* The current and the next generation of a tape, allocated together from
+ * one arena. Stepping writes the next row and then swaps which one is current. */
+typedef struct {
+  Arena arena;
+  BitRow rows[2];
+  int current;
+} Tape;
+
+typedef struct {
+  uint8_t table[1 << RULE110_LUT_IN];
+} Rule110Lut;
+
+/* A single generation stepper, bitrow_rule110 or a variant of it with
+ * different edges. */
+typedef void (*RowStepFn)(const BitRow *prev, BitRow *next);
+
+/* Number of words needed to store width cells. */
+static inline size_t bitrow_words(size_t width) {
+  return (width + BITROW_WORD_BITS - 1) / BITROW_WORD_BITS;
+}
+
+/* Mask of the valid bits in the last word of a row of the given width. */
+static inline uint64_t bitrow_tail_mask(size_t width) {
+  size_t rem = width % BITROW_WORD_BITS;
+  return rem == 0 ? ~(uint64_t)0 : ((uint64_t)1 << rem) - 1;
+}
+
+static inline bool bitrow_get(const BitRow *row, size_t i) {
+  return (row->bits[i / BITROW_WORD_BITS] >> (i % BITROW_WORD_BITS)) & 1;
+}
+
+static inline void bitrow_set(BitRow *row, size_t i, bool alive) {
+  uint64_t bit = (uint64_t)1 << (i % BITROW_WORD_BITS);
+  if (alive) row->bits[i / BITROW_WORD_BITS] |= bit;
+  else row->bits[i / BITROW_WORD_BITS] &= ~bit;
+}
+
+bool bitrow_init(BitRow *row, size_t width);
+void bitrow_free(BitRow *row);
+
+/* Like bitrow_init, with the memory taken from the arena. */
+bool bitrow_init_arena(BitRow *row, size_t width, Arena *arena);
+
+void bitrow_clear(BitRow *row);
+void bitrow_copy(BitRow *dst, const BitRow *src);
+size_t bitrow_popcount(const BitRow *row);
+
+/* Compute the next Rule 110 generation of prev into next, 64 cells per
+ * operation. Cells outside the row are considered dead. */
+void bitrow_rule110(const BitRow *prev, BitRow *next);
+
+/* The stepper of the elementary rule with the given Wolfram number, with
+ * dead cells outside the row like bitrow_rule110. Every rule has a kernel
+ * of its own, generated at build time, so the rule costs nothing per cell. */
+RowStepFn bitrow_elementary(uint8_t rule);
+
+/* Fill the table for the given elementary rule; the table and
+ * rule110_lut_step work the same for all of them. */
+void elementary_lut_init(Rule110Lut *lut, uint8_t rule);
+void rule110_lut_init(Rule110Lut *lut);
+
+/* Advance prev by RULE110_LUT_STEPS generations into next with one table
+ * lookup per 8 cells, reading and writing the tape once instead of once per
+ * generation. The table assumes the tape goes on forever, so the words next
+ * to the two edges are redone with edge_step, the single generation stepper
+ * that defines what happens at the edges of the tape. */
+void rule110_lut_step(const Rule110Lut *lut, const BitRow *prev, BitRow *next, RowStepFn edge_step);
+
+bool tape_init(Tape *t, size_t width);
+
+/* Like tape_init, with the current row already in bits and used in place,
+ * as with lifeboard_init_cells. */
+bool tape_init_bits(Tape *t, size_t width, uint64_t *bits);
+void tape_free(Tape *t);
+
+static inline BitRow *tape_current(Tape *t) {
+  return &t->rows[t->current];
+}
+
+static inline BitRow *tape_next(Tape *t) {
+  return &t->rows[!t->current];
+}
+
+static inline void tape_swap(Tape *t) {
+  t->current = !t->current;
+}
+
+#endif // BITROW_H_
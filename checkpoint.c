@@ -0,0 +1,95 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+
+// The cells must start cache line aligned
+typedef char checkpoint_header_is_64_bytes[sizeof(CheckpointHeader) == 64 ? 1 : -1];
+
+bool checkpoint_write(const char *path, const CheckpointHeader *header, const uint64_t *cells) {
+  CheckpointHeader h = *header;
+  memcpy(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic));
+  h.header_size = sizeof(h);
+
+  size_t len = strlen(path);
+  char *tmp = malloc(len + 5);
+  if (tmp == NULL) return false;
+  memcpy(tmp, path, len);
+  memcpy(tmp + len, ".tmp", 5);
+
+  FILE *f = fopen(tmp, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "ERROR: could not write checkpoint %s: %s\n", tmp, strerror(errno));
+    free(tmp);
+    return false;
+  }
+  size_t words = h.stride * h.height;
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+            fwrite(cells, sizeof(uint64_t), words, f) == words &&
+            fflush(f) == 0 && fsync(fileno(f)) == 0;
+  ok = fclose(f) == 0 && ok;
+  if (ok) ok = rename(tmp, path) == 0;
+  if (!ok) {
+    fprintf(stderr, "ERROR: could not write checkpoint %s: %s\n", path, strerror(errno));
+    remove(tmp);
+  }
+  free(tmp);
+  return ok;
+}
+
+bool checkpoint_open(Checkpoint *ck, const char *path) {
+  memset(ck, 0, sizeof(*ck));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "ERROR: could not open checkpoint %s: %s\n", path, strerror(errno));
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CheckpointHeader)) {
+    fprintf(stderr, "ERROR: %s is not a checkpoint\n", path);
+    close(fd);
+    return false;
+  }
+  ck->size = st.st_size;
+  ck->map = mmap(NULL, ck->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (ck->map == MAP_FAILED) {
+    fprintf(stderr, "ERROR: could not map checkpoint %s: %s\n", path, strerror(errno));
+    ck->map = NULL;
+    return false;
+  }
+
+  const CheckpointHeader *h = ck->map;
+  if (memcmp(h->magic, CHECKPOINT_MAGIC, sizeof(h->magic)) != 0 || h->header_size != sizeof(*h)) {
+    fprintf(stderr, "ERROR: %s is not a checkpoint of this version and byte order\n", path);
+    checkpoint_close(ck);
+    return false;
+  }
+  if (h->width == 0 || h->height == 0) {
+    fprintf(stderr, "ERROR: checkpoint %s has no cells\n", path);
+    checkpoint_close(ck);
+    return false;
+  }
+  if (h->stride != (h->width + 63) / 64 ||
+      (ck->size - sizeof(*h)) / sizeof(uint64_t) / (h->stride ? h->stride : 1) < h->height) {
+    fprintf(stderr, "ERROR: checkpoint %s is truncated or corrupt\n", path);
+    checkpoint_close(ck);
+    return false;
+  }
+  ck->header = h;
+  ck->cells = (uint64_t *)(h + 1);
+  posix_madvise(ck->map, ck->size, POSIX_MADV_SEQUENTIAL);
+  return true;
+}
+
+void checkpoint_close(Checkpoint *ck) {
+  if (ck->map != NULL) munmap(ck->map, ck->size);
+  memset(ck, 0, sizeof(*ck));
+}
@@ -0,0 +1,59 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHECKPOINT_MAGIC "CATOMCK1"
+
+/* Rules are stored as their Wolfram number for the 1D automata and as a
+ * birth and a survival mask (bit n set for n live neighbours) for Life-like
+ * rules, with bit 16 telling the two apart. */
+#define CHECKPOINT_RULE_110 110u
+#define CHECKPOINT_RULE_BS(birth, survive) (0x10000u | (birth) | (survive) << 20)
+#define CHECKPOINT_RULE_LIFE CHECKPOINT_RULE_BS(1u << 3, 1u << 2 | 1u << 3)
+#define CHECKPOINT_RULE_IS_BS(rule) (((rule) & 0x10000u) != 0)
+#define CHECKPOINT_RULE_BIRTH(rule) ((rule) & 0x1ffu)
+#define CHECKPOINT_RULE_SURVIVE(rule) ((rule) >> 20 & 0x1ffu)
+
+/* A checkpoint is this header followed by the cells exactly as they are laid
+ * out in memory: height rows of stride words, 64 cells per word with cell x
+ * of a row in bit x%64 of word x/64. The header is 64 bytes so the cells
+ * start cache line aligned in a mapping of the file. Words are stored in the
+ * byte order of the machine; header_size doubles as a check for it. */
+typedef struct {
+  char magic[8];
+  uint32_t header_size;
+  uint32_t rule;
+  uint64_t width;
+  uint64_t height;
+  uint64_t stride;
+  uint64_t generation;
+  uint64_t seed;
+  uint64_t reserved;
+} CheckpointHeader;
+
+/* A checkpoint file mapped into memory. The mapping is private, so the
+ * cells can be stepped in place: a page is copied the first time it is
+ * written and nothing ever reaches the file. */
+typedef struct {
+  void *map;
+  size_t size;
+  const CheckpointHeader *header;
+  uint64_t *cells;
+} Checkpoint;
+
+/* Write the header and the stride*height words of cells to path. The file is
+ * written next to path first and renamed over it once complete, so a run that
+ * dies while writing leaves the previous checkpoint intact. Prints the reason
+ * to stderr on failure. */
+bool checkpoint_write(const char *path, const CheckpointHeader *header, const uint64_t *cells);
+
+/* Map the checkpoint at path and check its header. Nothing is read or parsed
+ * up front, the cells are paged in when they are first touched. Prints the
+ * reason to stderr on failure. */
+bool checkpoint_open(Checkpoint *ck, const char *path);
+void checkpoint_close(Checkpoint *ck);
+
+#endif // CHECKPOINT_H_
@@ -0,0 +1,94 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+static char *trim(char *s) {
+  while (isspace((unsigned char)*s)) s++;
+  char *end = s + strlen(s);
+  while (end > s && isspace((unsigned char)end[-1])) *--end = '\0';
+  return s;
+}
+
+bool config_load(Config *cfg, const char *path) {
+  memset(cfg, 0, sizeof(*cfg));
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    fprintf(stderr, "ERROR: could not read config %s: %s\n", path, strerror(errno));
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  cfg->text = malloc(size + 1);
+  if (cfg->text == NULL) {
+    fclose(f);
+    return false;
+  }
+  size_t n = fread(cfg->text, 1, size, f);
+  cfg->text[n] = '\0';
+  fclose(f);
+
+  size_t lines = 1;
+  for (size_t i = 0; i < n; ++i) lines += cfg->text[i] == '\n';
+  cfg->keys = malloc(lines * sizeof(char *));
+  cfg->values = malloc(lines * sizeof(char *));
+  if (cfg->keys == NULL || cfg->values == NULL) {
+    config_free(cfg);
+    return false;
+  }
+
+  size_t line_number = 0;
+  for (char *line = cfg->text; line != NULL;) {
+    char *next = strchr(line, '\n');
+    if (next != NULL) *next++ = '\0';
+    line_number++;
+
+    line = trim(line);
+    if (*line != '\0' && *line != '#') {
+      char *eq = strchr(line, '=');
+      if (eq == NULL) {
+        fprintf(stderr, "ERROR: %s:%zu: expected key = value\n", path, line_number);
+        config_free(cfg);
+        return false;
+      }
+      *eq = '\0';
+      cfg->keys[cfg->count] = trim(line);
+      cfg->values[cfg->count] = trim(eq + 1);
+      cfg->count++;
+    }
+    line = next;
+  }
+  return true;
+}
+
+void config_free(Config *cfg) {
+  free(cfg->text);
+  free(cfg->keys);
+  free(cfg->values);
+  memset(cfg, 0, sizeof(*cfg));
+}
+
+const char *config_get(const Config *cfg, const char *key) {
+  // The last assignment wins, like in a shell script
+  for (size_t i = cfg->count; i-- > 0;) {
+    if (strcmp(cfg->keys[i], key) == 0) return cfg->values[i];
+  }
+  return NULL;
+}
+
+bool config_get_size(const Config *cfg, const char *key, size_t *out) {
+  const char *value = config_get(cfg, key);
+  if (value == NULL) return false;
+  char *end;
+  unsigned long long n = strtoull(value, &end, 10);
+  if (*end != '\0' || n == 0 || *value == '-') {
+    fprintf(stderr, "ERROR: config key %s needs a positive integer, got '%s'\n", key, value);
+    exit(1);
+  }
+  *out = (size_t)n;
+  return true;
+}
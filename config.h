@@ -0,0 +1,27 @@
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A config file of `key = value` lines. Blank lines and lines starting
+ * with # are ignored, keys and values are trimmed. */
+typedef struct {
+  char *text;
+  size_t count;
+  char **keys;
+  char **values;
+} Config;
+
+/* Load and parse the file, printing the reason to stderr on failure. */
+bool config_load(Config *cfg, const char *path);
+void config_free(Config *cfg);
+
+/* The value of key, or NULL if the file does not set it. */
+const char *config_get(const Config *cfg, const char *key);
+
+/* Parse a positive integer value into out. Returns false, leaving out
+ * untouched, if the key is missing; exits with an error if it is invalid. */
+bool config_get_size(const Config *cfg, const char *key, size_t *out);
+
+#endif // CONFIG_H_
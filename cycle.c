@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cycle.h"
+
+/* The hash of a state is the XOR of a mix of every word with its index, so
+ * a word that changes from a to b changes the hash by mix(i,a) ^ mix(i,b)
+ * whatever the other words are. The mix is the splitmix64 finalizer. */
+static uint64_t mix(size_t i, uint64_t w) {
+  uint64_t z = w + (i + 1) * 0x9e3779b97f4a7c15ull;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+uint64_t cycle_hash(const uint64_t *state, size_t words) {
+  uint64_t hash = 0;
+  for (size_t i = 0; i < words; ++i) hash ^= mix(i, state[i]);
+  return hash;
+}
+
+bool cycle_init(CycleDetector *c, const uint64_t *state, size_t words, uint64_t generation) {
+  memset(c, 0, sizeof(*c));
+  c->words = words;
+  c->start = generation;
+  c->initial = malloc((words ? words : 1) * sizeof(uint64_t));
+  c->saved = malloc((words ? words : 1) * sizeof(uint64_t));
+  if (c->initial == NULL || c->saved == NULL) {
+    cycle_free(c);
+    return false;
+  }
+  memcpy(c->initial, state, words * sizeof(uint64_t));
+  memcpy(c->saved, state, words * sizeof(uint64_t));
+  c->hash = c->saved_hash = cycle_hash(state, words);
+  c->power = 1;
+  return true;
+}
+
+void cycle_free(CycleDetector *c) {
+  free(c->initial);
+  free(c->saved);
+  c->initial = c->saved = NULL;
+}
+
+bool cycle_step(CycleDetector *c, const uint64_t *prev, const uint64_t *next) {
+  if (c->period > 0) return true;
+  for (size_t i = 0; i < c->words; ++i) {
+    if (prev[i] != next[i]) c->hash ^= mix(i, prev[i]) ^ mix(i, next[i]);
+  }
+
+  c->steps++;
+  if (c->hash == c->saved_hash && memcmp(next, c->saved, c->words * sizeof(uint64_t)) == 0) {
+    c->period = c->steps;
+    return true;
+  }
+  // Nothing found within this power of two, move the saved state up to here
+  if (c->steps == c->power) {
+    memcpy(c->saved, next, c->words * sizeof(uint64_t));
+    c->saved_hash = c->hash;
+    c->power *= 2;
+    c->steps = 0;
+  }
+  return false;
+}
+
+bool cycle_transient(const CycleDetector *c, CycleStepFn step, void *ctx, uint64_t *transient) {
+  size_t n = c->words ? c->words : 1, bytes = c->words * sizeof(uint64_t);
+  uint64_t *buf = malloc(4 * n * sizeof(uint64_t));
+  if (buf == NULL) return false;
+  uint64_t *tortoise[2] = {buf, buf + n};
+  uint64_t *hare[2] = {buf + 2 * n, buf + 3 * n};
+  int t = 0, h = 0;
+
+  memcpy(tortoise[t], c->initial, bytes);
+  memcpy(hare[h], c->initial, bytes);
+  for (uint64_t i = 0; i < c->period; ++i) {
+    step(ctx, hare[h], hare[!h]);
+    h = !h;
+  }
+
+  // The first generation the two meet is where the cycle starts
+  uint64_t mu = 0;
+  while (memcmp(tortoise[t], hare[h], bytes) != 0) {
+    step(ctx, tortoise[t], tortoise[!t]);
+    step(ctx, hare[h], hare[!h]);
+    t = !t;
+    h = !h;
+    mu++;
+  }
+  *transient = mu;
+  free(buf);
+  return true;
+}
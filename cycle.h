@@ -0,0 +1,47 @@
+#ifndef CYCLE_H_
+#define CYCLE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Finds when a bounded automaton becomes periodic, with Brent's algorithm:
+ * the state at every power of two generations is kept, and each new state
+ * is compared against it until one matches, which gives the period. States
+ * are the words of the cells as they are laid out in memory, and they are
+ * compared by a 64-bit hash first, which is updated from the words that
+ * changed only. A matching hash is confirmed by comparing the states. */
+typedef struct {
+  size_t words;
+  uint64_t start;    // generation of the first state
+  uint64_t *initial; // the first state, to find the transient from
+  uint64_t *saved;   // the state at the last power of two
+  uint64_t hash;
+  uint64_t saved_hash;
+  uint64_t power;
+  uint64_t steps;  // generations since the saved state
+  uint64_t period; // 0 until a cycle is found
+} CycleDetector;
+
+/* Computes the next state of words words from prev into next. */
+typedef void (*CycleStepFn)(void *ctx, const uint64_t *prev, uint64_t *next);
+
+/* Hash of a whole state. */
+uint64_t cycle_hash(const uint64_t *state, size_t words);
+
+/* Start watching from state, the given generation of the run. */
+bool cycle_init(CycleDetector *c, const uint64_t *state, size_t words, uint64_t generation);
+void cycle_free(CycleDetector *c);
+
+/* Feed the generation after prev, which must be the state fed last.
+ * Returns true once the run is found to be periodic, with the period in
+ * c->period. */
+bool cycle_step(CycleDetector *c, const uint64_t *prev, const uint64_t *next);
+
+/* Once the period is known, find the transient: the number of generations
+ * from the first state until the cycle is entered. The run is replayed from
+ * the first state with step, a tortoise and a hare period generations apart,
+ * which takes 2*transient + period steps. Returns false if out of memory. */
+bool cycle_transient(const CycleDetector *c, CycleStepFn step, void *ctx, uint64_t *transient);
+
+#endif // CYCLE_H_
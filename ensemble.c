@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ensemble.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ENSEMBLE_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/* Step the n words at p into out. The left and right neighbours of a word
+ * are the words lanes before and after it, the same cell of the same runs
+ * one step along the tape. */
+typedef void (*EnsembleRowFn)(uint64_t *out, const uint64_t *p, size_t lanes, size_t n);
+
+static void ensemble_row_scalar(uint64_t *out, const uint64_t *p, size_t lanes, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    uint64_t l = p[i - lanes], c = p[i], r = p[i + lanes];
+    out[i] = (c ^ r) | (c & ~l);
+  }
+}
+
+#ifdef ENSEMBLE_HAVE_X86_SIMD
+
+__attribute__((target("avx2")))
+static void ensemble_row_avx2(uint64_t *out, const uint64_t *p, size_t lanes, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i l = _mm256_loadu_si256((const __m256i *)(p + i - lanes));
+    __m256i c = _mm256_loadu_si256((const __m256i *)(p + i));
+    __m256i r = _mm256_loadu_si256((const __m256i *)(p + i + lanes));
+    __m256i next = _mm256_or_si256(_mm256_xor_si256(c, r), _mm256_andnot_si256(l, c));
+    _mm256_storeu_si256((__m256i *)(out + i), next);
+  }
+  ensemble_row_scalar(out + i, p + i, lanes, n - i);
+}
+
+/* The truth table of a ternary logic instruction is indexed by the bits of
+ * its operands like the rule number by the neighbourhood, so with l, c and
+ * r in that order the immediate is simply 110. */
+__attribute__((target("avx512f")))
+static void ensemble_row_avx512(uint64_t *out, const uint64_t *p, size_t lanes, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m512i l = _mm512_loadu_si512((const void *)(p + i - lanes));
+    __m512i c = _mm512_loadu_si512((const void *)(p + i));
+    __m512i r = _mm512_loadu_si512((const void *)(p + i + lanes));
+    _mm512_storeu_si512((void *)(out + i), _mm512_ternarylogic_epi64(l, c, r, 110));
+  }
+  ensemble_row_scalar(out + i, p + i, lanes, n - i);
+}
+
+#endif // ENSEMBLE_HAVE_X86_SIMD
+
+static EnsembleRowFn row_fn = NULL;
+
+static EnsembleRowFn pick_row_fn(void) {
+#ifdef ENSEMBLE_HAVE_X86_SIMD
+  if (__builtin_cpu_supports("avx512f")) return ensemble_row_avx512;
+  if (__builtin_cpu_supports("avx2")) return ensemble_row_avx2;
+#endif
+  return ensemble_row_scalar;
+}
+
+bool ensemble_init(Ensemble *e, size_t width, size_t runs, size_t probe) {
+  memset(e, 0, sizeof(*e));
+  e->width = width;
+  e->lanes = (runs + 63) / 64;
+  e->runs = e->lanes * 64;
+  e->probe = probe < width ? probe : width - 1;
+  e->cells = calloc(width * e->lanes, sizeof(uint64_t));
+  e->next = calloc(width * e->lanes, sizeof(uint64_t));
+  e->hit = calloc(e->lanes, sizeof(uint64_t));
+  e->first_hit = malloc(e->runs * sizeof(uint64_t));
+  if (width == 0 || e->cells == NULL || e->next == NULL || e->hit == NULL || e->first_hit == NULL) {
+    ensemble_free(e);
+    return false;
+  }
+  for (size_t i = 0; i < e->runs; ++i) e->first_hit[i] = UINT64_MAX;
+  if (row_fn == NULL) row_fn = pick_row_fn();
+  return true;
+}
+
+void ensemble_free(Ensemble *e) {
+  free(e->cells);
+  free(e->next);
+  free(e->hit);
+  free(e->first_hit);
+  memset(e, 0, sizeof(*e));
+}
+
+/* Record the runs whose probe cell is alive for the first time. */
+static void record_hits(Ensemble *e) {
+  const uint64_t *probe = e->cells + e->probe * e->lanes;
+  for (size_t k = 0; k < e->lanes; ++k) {
+    uint64_t new_hits = probe[k] & ~e->hit[k];
+    e->hit[k] |= new_hits;
+    for (; new_hits != 0; new_hits &= new_hits - 1) {
+      e->first_hit[64 * k + __builtin_ctzll(new_hits)] = e->generation;
+    }
+  }
+}
+
+void ensemble_start(Ensemble *e) {
+  record_hits(e);
+}
+
+void ensemble_step(Ensemble *e, uint64_t n) {
+  size_t lanes = e->lanes, width = e->width;
+  for (uint64_t g = 0; g < n; ++g) {
+    // The borders are pinned, only the cells between them are computed
+    if (width > 2) row_fn(e->next + lanes, e->cells + lanes, lanes, (width - 2) * lanes);
+    memset(e->next, 0, lanes * sizeof(uint64_t));
+    memset(e->next + (width - 1) * lanes, 0, lanes * sizeof(uint64_t));
+
+    uint64_t *t = e->cells;
+    e->cells = e->next;
+    e->next = t;
+    e->generation++;
+    record_hits(e);
+  }
+}
+
+void ensemble_populations(const Ensemble *e, uint32_t *counts) {
+  size_t lanes = e->lanes, planes = 0;
+  while (((size_t)1 << planes) <= e->width) planes++;
+  uint64_t *counter = calloc(planes * lanes, sizeof(uint64_t));
+  if (counter == NULL) abort();
+
+  // Add every cell word to a binary counter of planes bit-planes per lane;
+  // carries rarely go past the first few planes
+  for (size_t x = 0; x < e->width; ++x) {
+    for (size_t k = 0; k < lanes; ++k) {
+      uint64_t carry = e->cells[x * lanes + k];
+      for (size_t b = 0; carry != 0; ++b) {
+        uint64_t *plane = &counter[b * lanes + k];
+        uint64_t t = *plane & carry;
+        *plane ^= carry;
+        carry = t;
+      }
+    }
+  }
+
+  for (size_t run = 0; run < e->runs; ++run) {
+    uint32_t count = 0;
+    for (size_t b = 0; b < planes; ++b) {
+      count |= (uint32_t)((counter[b * lanes + run / 64] >> (run % 64)) & 1) << b;
+    }
+    counts[run] = count;
+  }
+  free(counter);
+}
@@ -0,0 +1,54 @@
+#ifndef ENSEMBLE_H_
+#define ENSEMBLE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Many Rule 110 tapes of the same width stepped together, transposed: bit i
+ * of a word belongs to run i and the words go along the tape, so the one
+ * bitwise formula of bitrow_rule110 steps 64 runs per operation, or 256 and
+ * 512 with AVX2 and AVX-512. With lanes words per cell, cell x of run
+ * 64*k+i is bit i of cells[x*lanes + k]. The tapes have the fixed borders
+ * of rule110.c: the first and last cells are dead after every step. */
+typedef struct {
+  size_t width;
+  size_t runs;  // a multiple of 64
+  size_t lanes; // runs / 64
+  uint64_t *cells;
+  uint64_t *next;
+  uint64_t generation;
+  // Per run statistics
+  size_t probe;        // the cell whose first live generation is recorded
+  uint64_t *hit;       // lanes words, the runs whose probe was alive already
+  uint64_t *first_hit; // runs entries, UINT64_MAX until the probe is alive
+} Ensemble;
+
+/* At least runs runs of width cells, all dead, watching probe. */
+bool ensemble_init(Ensemble *e, size_t width, size_t runs, size_t probe);
+void ensemble_free(Ensemble *e);
+
+static inline bool ensemble_get(const Ensemble *e, size_t run, size_t x) {
+  return (e->cells[x * e->lanes + run / 64] >> (run % 64)) & 1;
+}
+
+static inline void ensemble_set(Ensemble *e, size_t run, size_t x, bool alive) {
+  uint64_t bit = (uint64_t)1 << (run % 64);
+  if (alive) e->cells[x * e->lanes + run / 64] |= bit;
+  else e->cells[x * e->lanes + run / 64] &= ~bit;
+}
+
+/* Record the probe of the runs as they are now, once they are all set up.
+ * Like a random row in rule110.c the borders may start alive, they are
+ * pinned from the first step on. */
+void ensemble_start(Ensemble *e);
+
+/* Advance all runs by n generations. */
+void ensemble_step(Ensemble *e, uint64_t n);
+
+/* The live cells of every run into counts, added up with bit-sliced
+ * counters across the words of the tape, 64 runs per operation, without
+ * transposing the cells back. */
+void ensemble_populations(const Ensemble *e, uint32_t *counts);
+
+#endif // ENSEMBLE_H_
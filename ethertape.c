@@ -0,0 +1,377 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ethertape.h"
+
+#define ETHER_MASK ((1u << ETHERTAPE_PERIOD) - 1)
+
+/* Word and bit of cell x, rounding towards minus infinity so that cells left
+ * of 0 are laid out like the others. */
+static int64_t word_of(int64_t x) {
+  return x >= 0 ? x / BITROW_WORD_BITS : -((-x + BITROW_WORD_BITS - 1) / BITROW_WORD_BITS);
+}
+
+static unsigned bit_of(int64_t x) {
+  return (unsigned)(x - word_of(x) * BITROW_WORD_BITS);
+}
+
+static unsigned phase_of(int64_t x) {
+  int64_t m = x % ETHERTAPE_PERIOD;
+  return (unsigned)(m < 0 ? m + ETHERTAPE_PERIOD : m);
+}
+
+/* One generation of a periodic row, which stays periodic. */
+static uint16_t pattern_step(uint8_t rule, uint16_t p) {
+  uint16_t next = 0;
+  for (unsigned i = 0; i < ETHERTAPE_PERIOD; ++i) {
+    unsigned l = p >> (i + ETHERTAPE_PERIOD - 1) % ETHERTAPE_PERIOD & 1;
+    unsigned c = p >> i & 1;
+    unsigned r = p >> (i + 1) % ETHERTAPE_PERIOD & 1;
+    next |= (uint16_t)((rule >> (l << 2 | c << 1 | r) & 1) << i);
+  }
+  return next;
+}
+
+/* The 64 cells of word q of the tape in the ether of pattern p. */
+static uint64_t ether_word(uint16_t p, int64_t q) {
+  unsigned phase = phase_of(q * BITROW_WORD_BITS);
+  uint64_t r = ((unsigned)p >> phase | (unsigned)p << (ETHERTAPE_PERIOD - phase)) & ETHER_MASK;
+  return r | r << 14 | r << 28 | r << 42 | r << 56;
+}
+
+static bool literal_get(const TapeSegment *s, int64_t x) {
+  return s->cells[word_of(x) - s->base] >> bit_of(x) & 1;
+}
+
+static void literal_set(TapeSegment *s, int64_t x, bool alive) {
+  uint64_t bit = (uint64_t)1 << bit_of(x);
+  if (alive) s->cells[word_of(x) - s->base] |= bit;
+  else s->cells[word_of(x) - s->base] &= ~bit;
+}
+
+static bool segment_get(const TapeSegment *s, int64_t x) {
+  return s->literal ? literal_get(s, x) : s->pattern >> phase_of(x) & 1;
+}
+
+/* Cell x, found by walking from segment i, which is close to it. */
+static bool cell_near(const EtherTape *t, size_t i, int64_t x) {
+  while (x < t->segs[i].start) i--;
+  while (x >= t->segs[i].end) i++;
+  return segment_get(&t->segs[i], x);
+}
+
+/* Give the literal room for words lo to hi and some slack on both sides,
+ * keeping whatever of its words falls in there. */
+static bool literal_realloc(TapeSegment *s, int64_t lo, int64_t hi) {
+  int64_t slack = 2 + (hi - lo) / 4;
+  lo -= slack;
+  hi += slack;
+  size_t words = (size_t)(hi - lo + 1);
+  uint64_t *block = calloc(2 * words, sizeof(uint64_t));
+  if (block == NULL) return false;
+  if (s->block != NULL) {
+    int64_t from = lo > s->base ? lo : s->base;
+    int64_t to = s->base + (int64_t)s->words - 1;
+    if (to > hi) to = hi;
+    if (from <= to) memcpy(block + (from - lo), s->cells + (from - s->base), (size_t)(to - from + 1) * sizeof(uint64_t));
+    free(s->block);
+  }
+  s->base = lo;
+  s->words = words;
+  s->block = block;
+  s->cells = block;
+  s->next = block + words;
+  return true;
+}
+
+static bool literal_reserve(TapeSegment *s, int64_t lo, int64_t hi) {
+  if (s->block != NULL) {
+    int64_t last = s->base + (int64_t)s->words - 1;
+    if (lo >= s->base && hi <= last) return true;
+    if (lo > s->base) lo = s->base;
+    if (hi < last) hi = last;
+  }
+  return literal_realloc(s, lo, hi);
+}
+
+/* Hand the memory back once a literal has shrunk to a fraction of it. */
+static void literal_fit(TapeSegment *s) {
+  int64_t lo = word_of(s->start), hi = word_of(s->end - 1);
+  if (s->words > 2 * (size_t)(hi - lo + 1) + 16) literal_realloc(s, lo, hi);
+}
+
+/* Append the cells of literal b to literal a, which it overlaps or touches,
+ * and free b. Both have the same cells where they overlap. */
+static bool literal_join(TapeSegment *a, TapeSegment *b) {
+  if (!literal_reserve(a, word_of(a->start), word_of(b->end - 1))) return false;
+  int64_t first = word_of(a->end);
+  for (int64_t q = first; q <= word_of(b->end - 1); ++q) {
+    uint64_t keep = q == first ? ((uint64_t)1 << bit_of(a->end)) - 1 : 0;
+    uint64_t *w = &a->cells[q - a->base];
+    *w = (*w & keep) | (b->cells[q - b->base] & ~keep);
+  }
+  a->end = b->end;
+  free(b->block);
+  return true;
+}
+
+static bool segments_insert(EtherTape *t, size_t i, size_t n) {
+  if (t->count + n > t->cap) {
+    size_t cap = 2 * t->cap + n;
+    TapeSegment *segs = realloc(t->segs, cap * sizeof(TapeSegment));
+    if (segs == NULL) return false;
+    t->segs = segs;
+    t->cap = cap;
+  }
+  memmove(&t->segs[i + n], &t->segs[i], (t->count - i) * sizeof(TapeSegment));
+  memset(&t->segs[i], 0, n * sizeof(TapeSegment));
+  t->count += n;
+  return true;
+}
+
+static void segments_remove(EtherTape *t, size_t i, size_t n) {
+  memmove(&t->segs[i], &t->segs[i + n], (t->count - i - n) * sizeof(TapeSegment));
+  t->count -= n;
+}
+
+/* Give the cells at the start of the literal that match the ether before it
+ * back to that ether, keeping at least one. */
+static void trim_left(TapeSegment *s, uint16_t pattern) {
+  int64_t x = s->start, last = s->end - 1;
+  while (x < last) {
+    int64_t q = word_of(x);
+    uint64_t diff = (s->cells[q - s->base] ^ ether_word(pattern, q)) >> bit_of(x);
+    if (diff != 0) {
+      x += __builtin_ctzll(diff);
+      break;
+    }
+    x = (q + 1) * BITROW_WORD_BITS;
+  }
+  s->start = x < last ? x : last;
+}
+
+/* The same at the end of the literal, with the ether after it. */
+static void trim_right(TapeSegment *s, uint16_t pattern) {
+  int64_t x = s->end - 1;
+  while (x > s->start) {
+    int64_t q = word_of(x);
+    uint64_t diff = (s->cells[q - s->base] ^ ether_word(pattern, q)) << (63 - bit_of(x));
+    if (diff != 0) {
+      x -= __builtin_clzll(diff);
+      break;
+    }
+    x = q * BITROW_WORD_BITS - 1;
+  }
+  s->end = (x > s->start ? x : s->start) + 1;
+}
+
+/* Find the first stretch of at least ETHERTAPE_MIN_RUN cells of literal i
+ * that repeats every ETHERTAPE_PERIOD cells and move it into an ether
+ * segment of its own, followed by a new literal with the rest of the cells.
+ * Cell x extends a stretch when it equals cell x - 14, which is tested a
+ * word at a time. */
+static bool split_literal(EtherTape *t, size_t i) {
+  TapeSegment *s = &t->segs[i];
+  if (s->end - s->start < ETHERTAPE_MIN_RUN + 2) return true;
+  int64_t from = s->start + ETHERTAPE_PERIOD, need = ETHERTAPE_MIN_RUN - ETHERTAPE_PERIOD;
+  int64_t run = from, found = s->end;
+  bool periodic = false;
+  int64_t first = word_of(from), last = word_of(s->end - 1);
+  for (int64_t q = first; q <= last && !periodic; ++q) {
+    uint64_t c = s->cells[q - s->base];
+    uint64_t prev = q > s->base ? s->cells[q - 1 - s->base] : 0;
+    uint64_t mismatch = c ^ (c << ETHERTAPE_PERIOD | prev >> (BITROW_WORD_BITS - ETHERTAPE_PERIOD));
+    // Cells outside the literal never match
+    if (q == first) mismatch |= ((uint64_t)1 << bit_of(from)) - 1;
+    if (q == last && bit_of(s->end - 1) < 63) mismatch |= ~(uint64_t)0 << (bit_of(s->end - 1) + 1);
+    for (; mismatch != 0; mismatch &= mismatch - 1) {
+      int64_t x = q * BITROW_WORD_BITS + __builtin_ctzll(mismatch);
+      if (x - run >= need) {
+        found = x;
+        periodic = true;
+        break;
+      }
+      run = x + 1;
+    }
+  }
+  if (!periodic && s->end - run < need) return true;
+
+  // Keep a literal cell on both sides, the ether only borders literals
+  int64_t u = run - ETHERTAPE_PERIOD, v = found;
+  if (u < s->start + 1) u = s->start + 1;
+  if (v > s->end - 1) v = s->end - 1;
+  uint16_t pattern = 0;
+  for (int64_t x = u; x < u + ETHERTAPE_PERIOD; ++x) {
+    pattern |= (uint16_t)(literal_get(s, x) << phase_of(x));
+  }
+
+  if (!segments_insert(t, i + 1, 2)) return false;
+  s = &t->segs[i];
+  TapeSegment *ether = &t->segs[i + 1], *rest = &t->segs[i + 2];
+  ether->start = u;
+  ether->end = v;
+  ether->pattern = pattern;
+  rest->literal = true;
+  rest->start = v;
+  rest->end = s->end;
+  if (!literal_reserve(rest, word_of(v), word_of(s->end - 1))) return false;
+  memcpy(rest->cells + (word_of(v) - rest->base), s->cells + (word_of(v) - s->base),
+         (size_t)(word_of(s->end - 1) - word_of(v) + 1) * sizeof(uint64_t));
+  s->end = u;
+  return true;
+}
+
+/* Trim every literal against the ether around it, drop the ones that were
+ * nothing but ether and split the long periodic stretches out of the rest. */
+static bool compress(EtherTape *t) {
+  size_t i = 1;
+  while (i + 1 < t->count) {
+    TapeSegment *s = &t->segs[i], *left = &t->segs[i - 1], *right = &t->segs[i + 1];
+    trim_left(s, left->pattern);
+    left->end = s->start;
+    trim_right(s, right->pattern);
+    right->start = s->end;
+    if (s->end - s->start == 1 && left->pattern == right->pattern &&
+        literal_get(s, s->start) == (left->pattern >> phase_of(s->start) & 1)) {
+      left->end = right->end;
+      free(s->block);
+      segments_remove(t, i, 2);
+      continue;
+    }
+    if (!split_literal(t, i)) return false;
+    literal_fit(&t->segs[i]);
+    i += 2;
+  }
+  return true;
+}
+
+bool ethertape_init(EtherTape *t, uint8_t rule, uint16_t background, int64_t x0, const BitRow *row) {
+  memset(t, 0, sizeof(*t));
+  t->rule = rule;
+  t->step = bitrow_elementary(rule);
+  t->cap = 4;
+  t->segs = calloc(t->cap, sizeof(TapeSegment));
+  if (t->segs == NULL) return false;
+  t->count = 1;
+  t->segs[0].start = INT64_MIN;
+  t->segs[0].end = INT64_MAX;
+  t->segs[0].pattern = background & ETHER_MASK;
+  if (row->width == 0) return true;
+
+  int64_t end = x0 + (int64_t)row->width;
+  if (!segments_insert(t, 1, 2)) {
+    ethertape_free(t);
+    return false;
+  }
+  t->segs[0].end = x0;
+  t->segs[2] = t->segs[0];
+  t->segs[2].start = end;
+  t->segs[2].end = INT64_MAX;
+  TapeSegment *s = &t->segs[1];
+  s->literal = true;
+  s->start = x0;
+  s->end = end;
+  if (!literal_reserve(s, word_of(x0), word_of(end - 1))) {
+    ethertape_free(t);
+    return false;
+  }
+  for (size_t i = 0; i < row->width; ++i) literal_set(s, x0 + (int64_t)i, bitrow_get(row, i));
+  if (!compress(t)) {
+    ethertape_free(t);
+    return false;
+  }
+  return true;
+}
+
+void ethertape_free(EtherTape *t) {
+  for (size_t i = 0; i < t->count; ++i) free(t->segs[i].block);
+  free(t->segs);
+  memset(t, 0, sizeof(*t));
+}
+
+bool ethertape_step(EtherTape *t) {
+  // Fill in the two cells past both ends of every literal from the tape as
+  // it is, before any of it moves
+  for (size_t i = 1; i + 1 < t->count; i += 2) {
+    TapeSegment *s = &t->segs[i];
+    if (!literal_reserve(s, word_of(s->start - 2), word_of(s->end + 1))) return false;
+    for (int64_t d = 1; d <= 2; ++d) {
+      literal_set(s, s->start - d, cell_near(t, i - 1, s->start - d));
+      literal_set(s, s->end + d - 1, cell_near(t, i + 1, s->end + d - 1));
+    }
+  }
+
+  // Literals step whole words with the kernel of the rule and come out one
+  // cell longer on both sides, as far as the light cone goes
+  for (size_t i = 1; i + 1 < t->count; i += 2) {
+    TapeSegment *s = &t->segs[i];
+    int64_t lo = word_of(s->start - 2), hi = word_of(s->end + 1);
+    size_t words = (size_t)(hi - lo + 1);
+    BitRow prev = {words * BITROW_WORD_BITS, words, s->cells + (lo - s->base), false};
+    BitRow next = {words * BITROW_WORD_BITS, words, s->next + (lo - s->base), false};
+    t->step(&prev, &next);
+    uint64_t *cells = s->cells;
+    s->cells = s->next;
+    s->next = cells;
+    s->start--;
+    s->end++;
+  }
+
+  // Every ether segment advances one generation in O(1), only its period
+  // is stepped whatever its length, and loses a cell on both sides to the
+  // literals; literals with no ether left between them join
+  size_t w = 0;
+  for (size_t r = 0; r < t->count; ++r) {
+    TapeSegment s = t->segs[r];
+    if (!s.literal) {
+      s.pattern = pattern_step(t->rule, s.pattern);
+      if (w > 0) s.start = t->segs[w - 1].end;
+      if (r + 1 < t->count) s.end = t->segs[r + 1].start;
+      if (w > 0 && r + 1 < t->count && s.start >= s.end) {
+        if (!literal_join(&t->segs[w - 1], &t->segs[r + 1])) return false;
+        r++;
+        continue;
+      }
+    }
+    t->segs[w++] = s;
+  }
+  t->count = w;
+  t->generation++;
+  return compress(t);
+}
+
+static size_t find_segment(const EtherTape *t, int64_t x) {
+  size_t lo = 0, hi = t->count - 1;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (x >= t->segs[mid].end) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+bool ethertape_get(const EtherTape *t, int64_t x) {
+  return segment_get(&t->segs[find_segment(t, x)], x);
+}
+
+void ethertape_read(const EtherTape *t, int64_t x0, BitRow *row) {
+  size_t i = find_segment(t, x0);
+  bitrow_clear(row);
+  for (size_t k = 0; k < row->width; ++k) {
+    int64_t x = x0 + (int64_t)k;
+    while (x >= t->segs[i].end) i++;
+    if (segment_get(&t->segs[i], x)) bitrow_set(row, k, true);
+  }
+}
+
+uint64_t ethertape_literal_cells(const EtherTape *t) {
+  uint64_t cells = 0;
+  for (size_t i = 1; i + 1 < t->count; i += 2) cells += (uint64_t)(t->segs[i].end - t->segs[i].start);
+  return cells;
+}
+
+size_t ethertape_memory(const EtherTape *t) {
+  size_t bytes = t->cap * sizeof(TapeSegment);
+  for (size_t i = 1; i + 1 < t->count; i += 2) bytes += 2 * t->segs[i].words * sizeof(uint64_t);
+  return bytes;
+}
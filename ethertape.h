@@ -0,0 +1,70 @@
+#ifndef ETHERTAPE_H_
+#define ETHERTAPE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitrow.h"
+
+/* Every background the tape compresses repeats every 14 cells, the period of
+ * the Rule 110 ether; the dead background of period 1 is one of them. */
+#define ETHERTAPE_PERIOD 14
+
+/* The Rule 110 ether, cell x is bit x%14. It comes back to itself every 7
+ * generations. */
+#define ETHERTAPE_RULE110_ETHER 0x191f
+
+/* Shortest periodic stretch of a literal segment split out as ether. */
+#define ETHERTAPE_MIN_RUN 128
+
+/* A stretch of the tape, cells [start, end). Ether is periodic and stored as
+ * one period, cell x is bit x%14 of pattern, and advances in one step
+ * whatever its length. A literal holds its cells in words aligned to the
+ * whole tape: cell x is bit x%64 of cells[x/64 - base], so segments can be
+ * stepped, split and joined without shifting. */
+typedef struct {
+  int64_t start;
+  int64_t end;
+  bool literal;
+  uint16_t pattern;
+  int64_t base;
+  size_t words;
+  uint64_t *cells;
+  uint64_t *next;
+  uint64_t *block; // cells and next, words each
+} TapeSegment;
+
+/* An elementary automaton on a tape without edges: alternating ether and
+ * literal segments ordered along the tape, starting and ending with an
+ * ether that goes on forever. Literals grow by one cell a generation where
+ * they differ from the ether next to them, give cells back where they turn
+ * into it and lose long periodic stretches to new ether segments, so time
+ * and memory follow the structures and not the width they span. */
+typedef struct {
+  uint8_t rule;
+  RowStepFn step;
+  TapeSegment *segs;
+  size_t count;
+  size_t cap;
+  uint64_t generation;
+} EtherTape;
+
+/* The cells of row placed from cell x0 on, on an endless background of the
+ * given ether pattern. */
+bool ethertape_init(EtherTape *t, uint8_t rule, uint16_t background, int64_t x0, const BitRow *row);
+void ethertape_free(EtherTape *t);
+
+/* Advance by one generation. Fails only when out of memory. */
+bool ethertape_step(EtherTape *t);
+
+bool ethertape_get(const EtherTape *t, int64_t x);
+
+/* The cells from x0 on into row, as many as it is wide. */
+void ethertape_read(const EtherTape *t, int64_t x0, BitRow *row);
+
+/* The literal cells, and the bytes used by the tape. */
+uint64_t ethertape_literal_cells(const EtherTape *t);
+size_t ethertape_memory(const EtherTape *t);
+
+#endif // ETHERTAPE_H_
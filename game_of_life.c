@@ -1,152 +1,613 @@
+#define _DEFAULT_SOURCE
 #include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "checkpoint.h"
+#include "config.h"
+#include "cycle.h"
+#include "hashlife.h"
+#include "lifegrid.h"
+#include "lifepattern.h"
+#include "lifeplane.h"
+#include "lifepool.h"
+#include "lifeshards.h"
+#include "lifetiles.h"
+#include "perfstats.h"
+#include "randfill.h"
+#include "raster.h"
+#include "rule.h"
+#include "termview.h"
+
 #define ROWS 50
 #define COLS 50
-#define CELLS (ROWS*COLS)
 #define ALIVE '*'
 #define DEAD ' '
+#define HASHLIFE_MAX_NODES (4*1024*1024)
+#define MAX_PATTERNS 16
+
+/* Timings of a batch run with --stats: the time of every generation and of
+ * every checkpoint. */
+enum { STATS_STEP, STATS_CHECKPOINT };
+const char *const stats_phases[] = {"step", "checkpoint"};
+PerfStats *stats = NULL;
+
+/* Frames of a batch run go to images, the rasterizer taking all CPUs while
+ * the board waits. */
+const char *image_path = NULL;
+RasterStyle image_style = {1, false, 0};
 
-/* Translate the x,y grip point into the inex in the linar array.
- * It implements wrapping so both positive and negative x,y coordinates will work*/
-int cell_to_index(int x, int y) {
-  if (x>=COLS) x %=COLS;
-  if (y>=COLS) y %=ROWS;
+/* The seed of the random cells, kept in every checkpoint of the board, 0 if
+ * it has none. */
+uint64_t board_seed = 0;
 
-  if (x<0) {
-    x = (-x) % COLS;
-    x = COLS - x;
-  };
-  if (y<0) {
-    y = (-y) % ROWS;
-    y = ROWS - y;
-  };
-  return y*ROWS+x;
+/* Wrap a coordinate onto [0,n), so both positive and negative values work. */
+int wrap(int v, int n) {
+  v %= n;
+  return v < 0 ? v + n : v;
 }
 
 /* The function sets the specified cell at x,y to the specified state. */
-void set_cell(char *grid, int x, int y, char state) {
-  grid[cell_to_index(x,y)] = state;
+void set_cell(LifeGrid *grid, int x, int y, char state) {
+  lifegrid_set(grid, wrap(x, grid->width), wrap(y, grid->height), state == ALIVE);
 }
 
 /* The function returns the state at x,y. */
-char get_cell(char *grid, int x, int y) {
-  return grid[cell_to_index(x, y)];
-}
-
-/* Print the grid on the screen, clearing the terminal using the required VT100 escape sequence. */
-void print_grid(char *grid) {
-  printf("\x1b[H\x1b[J");
-  for (int y=-1; y<=ROWS; y++) {
-    printf("|");
-    for (int x=0; x<COLS; x++) {
-      if (y==-1 | y==ROWS) {
-        printf("-");
-      } else {
-        printf("%c", get_cell(grid, x,y));
-      }
-    }
-    printf("|");
-    printf("\n");
+char get_cell(const LifeGrid *grid, int x, int y) {
+  return lifegrid_get(grid, wrap(x, grid->width), wrap(y, grid->height)) ? ALIVE : DEAD;
+}
+
+/* Frames only send the cells that changed since the previous one. */
+TermView term;
+
+/* Print the grid on the screen. The first frame clears the terminal, the
+ * following ones are drawn over it with VT100 cursor moves. */
+void print_grid(const LifeGrid *grid) {
+  if (!termview_frame(&term, grid->cells, grid->stride, grid->width, grid->height)) {
+    fprintf(stderr, "ERROR: could not write to the terminal\n");
+    exit(1);
   }
 }
 
-/* Set all the grid cells to the specified state.*/
-void set_grid(char *grid, char state) {
-  for (int y=0; y<ROWS; y++) {
-    for (int x=0; x<COLS; x++) {
-      set_cell(grid, x, y, state);
-    }
+/* Jump the pattern n generations ahead with HashLife on the unbounded plane
+ * and print the window of the grid size at the origin. */
+int run_hashlife(const LifeGrid *initial, LifeGrid *view, uint64_t n) {
+  HashLife *hl = hashlife_new(HASHLIFE_MAX_NODES);
+  if (hl == NULL) {
+    fprintf(stderr, "ERROR: could not allocate the HashLife universe\n");
+    return 1;
+  }
+  hashlife_load(hl, initial, 0, 0);
+  hashlife_step(hl, n);
+  hashlife_read(hl, 0, 0, view);
+  print_grid(view);
+  printf("generation %" PRIu64 ", population %" PRIu64 ", %zu nodes\n",
+         hashlife_generation(hl), hashlife_population(hl), hashlife_node_count(hl));
+  hashlife_free(hl);
+  return 0;
+}
+
+/* Run the pattern on the unbounded plane, where gliders leave the window
+ * instead of wrapping around, and show the window of the grid size at the
+ * origin. */
+int run_plane(const LifeGrid *initial, LifeGrid *view) {
+  LifePlane *plane = lifeplane_new();
+  if (plane == NULL) {
+    fprintf(stderr, "ERROR: could not allocate the plane\n");
+    return 1;
+  }
+  lifeplane_load(plane, initial, 0, 0);
+  while (1) {
+    lifeplane_step(plane);
+    lifeplane_read(plane, 0, 0, view);
+    print_grid(view);
+    printf("generation %" PRIu64 ", population %" PRIu64 ", %zu chunks\n",
+           lifeplane_generation(plane), lifeplane_population(plane), lifeplane_chunk_count(plane));
+    usleep(100000);
   }
 }
 
-/* Return the number of living cells neigbors of x,y. */
-int count_living_neighbors(char *grid, int x, int y) {
-  int alive = 0;
-  for (int yo=-1; yo<=1; yo++) {
-    for (int xo=-1; xo<=1; xo++) {
-      if (xo == 0 && yo == 0) continue;
-      if(get_cell(grid,x+xo,y+yo) == ALIVE) alive++;
+/* The initial patterns as RLE, in the orientation they are usually drawn
+ * in. On the board they lie transposed, their rows running down. */
+const struct {
+  const char *name;
+  const char *rle;
+  int x, y;
+} initial_patterns[] = {
+  // Gosper Glider Gun (top-left corner, around 5x1)
+  {"the glider gun", "x = 36, y = 9\n24bo$22bobo$12b2o6b2o12b2o$11bo3bo4b2o12b2o$2o8bo5bo3b2o$"
+                     "2o8bo3bob2o4bobo$10bo5bo7bo$11bo3bo$12b2o!", 1, 1},
+  // Glider (top-right)
+  {"the glider", "x = 3, y = 3\nbo$2bo$3o!", 1, 69},
+  // Pulsar (center)
+  {"the pulsar", "x = 13, y = 5\n2b3o3b3o$o4bobo4bo$ob4ob4obo$o4bobo4bo$2b3o3b3o!", 10, 28},
+  // Lightweight spaceship (bottom left)
+  {"the spaceship", "x = 5, y = 5\nbo2bo$o$o$o3bo$4o!", 20, 0},
+};
+
+/* A pattern file given on the command line and where it goes. */
+typedef struct {
+  const char *path;
+  int64_t x, y;
+  int orientation;
+  LifePattern pattern;
+} Placement;
+
+/* Place the initial patterns on the grid. */
+void place_patterns(LifeGrid *grid) {
+  for (size_t i = 0; i < sizeof(initial_patterns) / sizeof(initial_patterns[0]); i++) {
+    LifePattern p;
+    const char *rle = initial_patterns[i].rle;
+    if (!lifepattern_parse(&p, rle, strlen(rle), initial_patterns[i].name) ||
+        !lifepattern_place(&p, grid, initial_patterns[i].x, initial_patterns[i].y, LIFE_ORIENT_TRANSPOSE)) {
+      exit(1);
     }
+    lifepattern_free(&p);
+  }
+}
+
+/* Save the current generation of the board to path. */
+bool save_checkpoint(const char *path, const LifeGrid *grid, uint64_t generation) {
+  LifeRule rule = lifegrid_current_rule();
+  CheckpointHeader h = {0};
+  h.rule = CHECKPOINT_RULE_BS(rule.birth, rule.survive);
+  h.width = grid->width;
+  h.height = grid->height;
+  h.stride = grid->stride;
+  h.generation = generation;
+  h.seed = board_seed;
+  uint64_t start = perfstats_now();
+  bool ok = checkpoint_write(path, &h, grid->cells);
+  if (stats != NULL) perfstats_record(stats, STATS_CHECKPOINT, perfstats_now() - start);
+  return ok;
+}
+
+/* Draw the grid to the image, if there is one. A run of #s in its path
+ * becomes the generation, so every frame gets a file of its own. */
+bool save_image(const LifeGrid *grid, uint64_t generation) {
+  if (image_path == NULL) return true;
+  char path[4096];
+  const char *hash = strchr(image_path, '#');
+  if (hash == NULL) {
+    snprintf(path, sizeof(path), "%s", image_path);
+  } else {
+    int digits = (int)strspn(hash, "#");
+    snprintf(path, sizeof(path), "%.*s%0*" PRIu64 "%s", (int)(hash - image_path), image_path, digits, generation,
+             hash + digits);
+  }
+  return raster_write(path, grid->cells, grid->stride, grid->width, grid->height, &image_style);
+}
+
+/* Print the timings of a batch run, if it was timed. */
+bool report_stats(void) {
+  if (stats == NULL) return true;
+  perfstats_poll(stats);
+  perfstats_report(stats, stdout);
+  return perfstats_finish(stats);
+}
+
+/* Run n generations on the pool, one at a time and timed when timings are
+ * on. */
+void pool_step(LifePool *pool, uint64_t n) {
+  if (stats == NULL) {
+    lifepool_step(pool, n);
+    return;
+  }
+  for (uint64_t i = 0; i < n; ++i) {
+    uint64_t start = perfstats_now();
+    lifepool_step(pool, 1);
+    perfstats_record(stats, STATS_STEP, perfstats_now() - start);
+    perfstats_add_generations(stats, 1);
+    perfstats_poll(stats);
+  }
+}
+
+/* Likewise on the worker processes. Returns false if a worker died. */
+bool shards_step(LifeShards *shards, uint64_t n) {
+  if (stats == NULL) return lifeshards_step(shards, n);
+  for (uint64_t i = 0; i < n; ++i) {
+    uint64_t start = perfstats_now();
+    if (!lifeshards_step(shards, 1)) return false;
+    perfstats_record(stats, STATS_STEP, perfstats_now() - start);
+    perfstats_add_generations(stats, 1);
+    perfstats_poll(stats);
+  }
+  return true;
+}
+
+/* Step the cells of a grid shaped like ctx, for cycle_transient. */
+void step_cells(void *ctx, const uint64_t *prev, uint64_t *next) {
+  LifeGrid old = *(const LifeGrid *)ctx, new = old;
+  old.cells = (uint64_t *)prev;
+  new.cells = next;
+  lifegrid_step(&old, &new);
+}
+
+/* Work out the transient of a run found to be periodic and print both. */
+void report_cycle(const CycleDetector *cycle, const LifeGrid *shape) {
+  uint64_t transient;
+  if (!cycle_transient(cycle, step_cells, (void *)shape, &transient)) {
+    fprintf(stderr, "ERROR: could not allocate the states to find the transient\n");
+    exit(1);
+  }
+  printf("cycle: transient %" PRIu64 " (from generation %" PRIu64 "), period %" PRIu64 "\n",
+         transient, cycle->start + transient, cycle->period);
+}
+
+/* Run the board on worker processes, which hold all of it. The board is
+ * only gathered into a grid of its own for what needs it whole: every
+ * frame, and in batch mode the checkpoints and images. */
+int run_shards(LifeShards *shards, size_t cols, size_t rows, uint64_t generation, uint64_t batch_generations,
+               const char *checkpoint_path, uint64_t checkpoint_every) {
+  LifeGrid snapshot = {0};
+  if ((batch_generations == 0 || checkpoint_path != NULL || image_path != NULL) &&
+      !lifegrid_init(&snapshot, cols, rows)) {
+    fprintf(stderr, "ERROR: could not allocate a %zux%zu snapshot of the board\n", cols, rows);
+    lifeshards_free(shards);
+    return 1;
   }
-  return alive;
-}
-
-/* Compute the new state of game of life accoring to its rules*/
-void compute_new_state(char *old, char *new) {
-  for (int y=0; y<ROWS; y++) {
-    for (int x=0; x<COLS; x++) {
-      int n_alive = count_living_neighbors(old,x,y);
-      int new_state = DEAD;
-      if (get_cell(old,x,y) == ALIVE) {
-        if (n_alive == 2 || n_alive == 3) new_state = ALIVE;
-      } else {
-          if (n_alive == 3) new_state =ALIVE;
+
+  bool ok = true;
+  if (batch_generations > 0) {
+    uint64_t end = generation + batch_generations;
+    while (ok && generation < end) {
+      uint64_t n = end - generation;
+      if (checkpoint_every > 0 && n > checkpoint_every) n = checkpoint_every;
+      if (!(ok = shards_step(shards, n))) break;
+      generation += n;
+      if (checkpoint_path != NULL || image_path != NULL) {
+        lifeshards_gather(shards, &snapshot);
+        ok = (checkpoint_path == NULL || save_checkpoint(checkpoint_path, &snapshot, generation)) &&
+             save_image(&snapshot, generation);
       }
-      set_cell(new,x,y,new_state);
+    }
+    if (ok) {
+      printf("generation %" PRIu64 ", population %zu, %zu processes\n",
+             generation, lifeshards_popcount(shards), lifeshards_procs(shards));
+    }
+  } else {
+    while (ok) {
+      if (!(ok = lifeshards_step(shards, 1))) break;
+      generation++;
+      lifeshards_gather(shards, &snapshot);
+      print_grid(&snapshot);
+      ok = checkpoint_path == NULL || checkpoint_every == 0 || generation % checkpoint_every != 0 ||
+           save_checkpoint(checkpoint_path, &snapshot, generation);
+      usleep(100000);
     }
   }
+  lifeshards_free(shards);
+  lifegrid_free(&snapshot);
+  return ok && report_stats() ? 0 : 1;
 }
 
-int main() {
-    char old_grid[CELLS];
-    char new_grid[CELLS];
-    set_grid(old_grid, DEAD);
-
-    // Gosper Glider Gun (top-left corner, around 5x1)
-    int gun[][2] = {
-        {5,1},{5,2},{6,1},{6,2},
-        {5,11},{6,11},{7,11},
-        {4,12},{8,12},
-        {3,13},{9,13},{3,14},{9,14},
-        {6,15},
-        {4,16},{8,16},
-        {5,17},{6,17},{7,17},
-        {6,18},
-        {3,21},{4,21},{5,21},
-        {3,22},{4,22},{5,22},
-        {2,23},{6,23},
-        {1,25},{2,25},{6,25},{7,25},
-        {3,35},{4,35},{3,36},{4,36}
-    };
-    for (int i = 0; i < sizeof(gun)/sizeof(gun[0]); i++)
-        set_cell(old_grid, gun[i][0], gun[i][1], ALIVE);
-
-    // Glider (top-right)
-    set_cell(old_grid, 1, 70, ALIVE);
-    set_cell(old_grid, 2, 71, ALIVE);
-    set_cell(old_grid, 3, 69, ALIVE);
-    set_cell(old_grid, 3, 70, ALIVE);
-    set_cell(old_grid, 3, 71, ALIVE);
-
-    // Pulsar (center)
-    int pulsar[][2] = {
-        {10, 30}, {10, 31}, {10, 32}, {10, 36}, {10, 37}, {10, 38},
-        {12, 30}, {12, 31}, {12, 32}, {12, 36}, {12, 37}, {12, 38},
-        {14, 30}, {14, 31}, {14, 32}, {14, 36}, {14, 37}, {14, 38},
-        {11, 28}, {12, 28}, {13, 28}, {11, 33}, {12, 33}, {13, 33},
-        {11, 35}, {12, 35}, {13, 35}, {11, 40}, {12, 40}, {13, 40}
-    };
-    for (int i = 0; i < sizeof(pulsar)/sizeof(pulsar[0]); i++)
-        set_cell(old_grid, pulsar[i][0], pulsar[i][1], ALIVE);
-
-    // Lightweight spaceship (bottom left)
-    int lwss[][2] = {
-        {20, 1}, {20, 4},
-        {21, 0}, {22, 0},
-        {23, 0}, {23, 4},
-        {24, 0}, {24, 1}, {24, 2}, {24, 3}
-    };
-    for (int i = 0; i < sizeof(lwss)/sizeof(lwss[0]); i++)
-        set_cell(old_grid, lwss[i][0], lwss[i][1], ALIVE);
+/* Parse a positive size argument. */
+size_t parse_size(const char *arg) {
+  char *end;
+  long long value = strtoll(arg, &end, 10);
+  if (*end != '\0' || value <= 0) {
+    fprintf(stderr, "ERROR: invalid size '%s'\n", arg);
+    exit(1);
+  }
+  return (size_t)value;
+}
+
+void usage(const char *program) {
+  fprintf(stderr, "Usage: %s [--config <file>] [--size <cols>x<rows>] [--rule <B/S>] [--resume <file>]\n"
+                  "          [--random <density> [--seed <n>]] [--pattern <file> [--at <x>,<y>] [--orient <orientation>]]...\n"
+                  "          [--threads <n> | --procs <n> | --tiles | --plane | --hashlife <generations>] [--half-blocks]\n"
+                  "          [--batch <generations> [--stats <file>] [--image <file> [--scale <n>] [--grid]]]\n"
+                  "          [--checkpoint <file> [--checkpoint-every <n>]] [--cycles]\n", program);
+  exit(1);
+}
+
+/* Read the board size, thread count and rule from a config file. */
+void load_config(const char *path, size_t *cols, size_t *rows, size_t *threads, LifeRule *rule, bool *rule_given) {
+  Config cfg;
+  if (!config_load(&cfg, path)) exit(1);
+  config_get_size(&cfg, "width", cols);
+  config_get_size(&cfg, "height", rows);
+  config_get_size(&cfg, "threads", threads);
+  const char *value = config_get(&cfg, "rule");
+  if (value != NULL) {
+    if (!liferule_parse(value, rule)) exit(1);
+    *rule_given = true;
+  }
+  config_free(&cfg);
+}
+
+int main(int argc, char **argv) {
+    size_t cols = COLS;
+    size_t rows = ROWS;
+    size_t threads = 1;
+    size_t procs = 0;
+    bool use_tiles = false;
+    bool use_plane = false;
+    bool use_hashlife = false;
+    uint64_t hashlife_generations = 0;
+    uint64_t batch_generations = 0;
+    const char *checkpoint_path = NULL;
+    uint64_t checkpoint_every = 0;
+    const char *resume_path = NULL;
+    bool detect_cycles = false;
+    const char *stats_path = NULL;
+    LifeRule rule = {LIFE_RULE_CONWAY_BIRTH, LIFE_RULE_CONWAY_SURVIVE};
+    bool rule_given = false;
+    Placement placements[MAX_PATTERNS];
+    size_t pattern_count = 0;
+    double density = -1; // no random cells
+    uint64_t seed = time(0);
+    bool seed_given = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            load_config(argv[++i], &cols, &rows, &threads, &rule, &rule_given);
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%zux%zu", &cols, &rows) != 2 || cols == 0 || rows == 0) usage(argv[0]);
+        } else if (strcmp(argv[i], "--rule") == 0 && i + 1 < argc) {
+            if (!liferule_parse(argv[++i], &rule)) return 1;
+            rule_given = true;
+        } else if (strcmp(argv[i], "--pattern") == 0 && i + 1 < argc) {
+            if (pattern_count == MAX_PATTERNS) usage(argv[0]);
+            placements[pattern_count++] = (Placement){.path = argv[++i]};
+        } else if (strcmp(argv[i], "--at") == 0 && i + 1 < argc) {
+            // --at and --orient go with the pattern before them
+            if (pattern_count == 0) usage(argv[0]);
+            Placement *pl = &placements[pattern_count - 1];
+            if (sscanf(argv[++i], "%" SCNd64 ",%" SCNd64, &pl->x, &pl->y) != 2) usage(argv[0]);
+        } else if (strcmp(argv[i], "--orient") == 0 && i + 1 < argc) {
+            if (pattern_count == 0) usage(argv[0]);
+            if (!lifepattern_parse_orientation(argv[++i], &placements[pattern_count - 1].orientation)) return 1;
+        } else if (strcmp(argv[i], "--random") == 0 && i + 1 < argc) {
+            char *end;
+            density = strtod(argv[++i], &end);
+            if (*end != '\0' || !(density >= 0 && density <= 1)) usage(argv[0]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            if (!randfill_parse_seed(argv[++i], &seed)) return 1;
+            seed_given = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = parse_size(argv[++i]);
+        } else if (strcmp(argv[i], "--procs") == 0 && i + 1 < argc) {
+            procs = parse_size(argv[++i]);
+        } else if (strcmp(argv[i], "--tiles") == 0) {
+            use_tiles = true;
+        } else if (strcmp(argv[i], "--half-blocks") == 0) {
+            term.half_blocks = true;
+        } else if (strcmp(argv[i], "--plane") == 0) {
+            use_plane = true;
+        } else if (strcmp(argv[i], "--hashlife") == 0 && i + 1 < argc) {
+            use_hashlife = true;
+            hashlife_generations = parse_size(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch_generations = parse_size(argv[++i]);
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpoint_path = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) {
+            checkpoint_every = parse_size(argv[++i]);
+        } else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+            resume_path = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            stats_path = argv[++i];
+        } else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc) {
+            image_path = argv[++i];
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            image_style.scale = parse_size(argv[++i]);
+        } else if (strcmp(argv[i], "--grid") == 0) {
+            image_style.grid = true;
+        } else if (strcmp(argv[i], "--cycles") == 0) {
+            detect_cycles = true;
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    // HashLife jumps the board, resumed or not, once and prints it, outside
+    // the batch runs
+    if (use_hashlife && (batch_generations > 0 || detect_cycles || checkpoint_path != NULL)) {
+        fprintf(stderr, "ERROR: --hashlife runs without --batch, --cycles or --checkpoint\n");
+        return 1;
+    }
+
+    // The tiles show the board forever, without the batch runs
+    if (use_tiles && (batch_generations > 0 || detect_cycles || checkpoint_path != NULL)) {
+        fprintf(stderr, "ERROR: --tiles runs without --batch, --cycles or --checkpoint\n");
+        return 1;
+    }
+
+    // The plane has no edges to checkpoint and shows its window forever
+    if (use_plane && (batch_generations > 0 || detect_cycles || checkpoint_path != NULL)) {
+        fprintf(stderr, "ERROR: --plane runs without --batch, --cycles or --checkpoint\n");
+        return 1;
+    }
+
+    if (procs > 0 && (use_tiles || use_plane || use_hashlife || detect_cycles)) {
+        fprintf(stderr, "ERROR: --procs runs the torus without --tiles, --plane, --hashlife or --cycles\n");
+        return 1;
+    }
+
+    // Without one the seed is the time, printed so the board can be had again
+    if (seed_given && density < 0) {
+        fprintf(stderr, "ERROR: --seed is for the cells of --random\n");
+        return 1;
+    }
+    if (density >= 0) {
+        if (!seed_given) printf("Seed: %" PRIu64 "\n", seed);
+        board_seed = seed;
+    }
+
+    // A checkpoint brings its own size, rule, generation and seed
+    Checkpoint ck = {0};
+    uint64_t generation = 0;
+    if (resume_path != NULL) {
+        if (!checkpoint_open(&ck, resume_path)) return 1;
+        if (!CHECKPOINT_RULE_IS_BS(ck.header->rule)) {
+            fprintf(stderr, "ERROR: %s is not a Life-like checkpoint\n", resume_path);
+            return 1;
+        }
+        cols = ck.header->width;
+        rows = ck.header->height;
+        generation = ck.header->generation;
+        board_seed = ck.header->seed;
+        rule.birth = CHECKPOINT_RULE_BIRTH(ck.header->rule);
+        rule.survive = CHECKPOINT_RULE_SURVIVE(ck.header->rule);
+    }
+
+    // Pattern files and random cells start a new board, in the rule of the
+    // first pattern that names a rule unless one was given
+    if ((pattern_count > 0 || density >= 0) && resume_path != NULL) {
+        fprintf(stderr, "ERROR: --pattern and --random start a new board, they do not go with --resume\n");
+        return 1;
+    }
+    for (size_t i = 0; i < pattern_count; i++) {
+        if (!lifepattern_load(&placements[i].pattern, placements[i].path)) return 1;
+        if (!rule_given && placements[i].pattern.has_rule) {
+            rule = placements[i].pattern.rule;
+            rule_given = true;
+        }
+    }
+
+    // The tiles, the plane and HashLife have B3/S23 built in
+    LifeRule conway = {LIFE_RULE_CONWAY_BIRTH, LIFE_RULE_CONWAY_SURVIVE};
+    if (!liferule_equal(rule, conway) && (use_tiles || use_plane || use_hashlife)) {
+        fprintf(stderr, "ERROR: --tiles, --plane and --hashlife only run B3/S23\n");
+        return 1;
+    }
+    lifegrid_use_rule(rule);
+
+    // Both generations come from one arena sized for the board, or only
+    // the next one when the current one is the mapped checkpoint. Worker
+    // processes step the board in their own strips, so they only need the
+    // first generation, and no second one to step into
+    LifeBoard board;
+    LifeGrid start;
+    LifeGrid *grid = &start;
+    bool allocated;
+    if (procs > 0 && resume_path != NULL) {
+        start = (LifeGrid){cols, rows, (cols + 63) / 64, ck.cells, NULL, false};
+        allocated = true;
+    } else if (procs > 0) {
+        allocated = lifegrid_init(&start, cols, rows);
+    } else {
+        allocated = resume_path != NULL ? lifeboard_init_cells(&board, cols, rows, ck.cells)
+                                        : lifeboard_init(&board, cols, rows);
+        grid = lifeboard_current(&board);
+    }
+    if (!allocated) {
+        fprintf(stderr, "ERROR: could not allocate a %zux%zu board\n", cols, rows);
+        return 1;
+    }
+    if (pattern_count > 0 || density >= 0) {
+        // The patterns go on top of the random cells, filled on all CPUs
+        // and the same for a seed whatever the number of them
+        if (density >= 0) randfill(grid->cells, grid->width, grid->height, grid->stride, seed, density, 0);
+        for (size_t i = 0; i < pattern_count; i++) {
+            Placement *pl = &placements[i];
+            if (!lifepattern_place(&pl->pattern, grid, pl->x, pl->y, pl->orientation)) return 1;
+            lifepattern_free(&pl->pattern);
+        }
+    } else if (resume_path == NULL) {
+        place_patterns(grid);
+    }
+
+    if ((stats_path != NULL || image_path != NULL) &&
+        (batch_generations == 0 || use_hashlife || use_plane || use_tiles)) {
+        fprintf(stderr, "ERROR: --stats and --image are for batch runs on threads or processes\n");
+        return 1;
+    }
+    if (stats_path != NULL) {
+        if ((stats = perfstats_new(stats_phases, 2, stats_path)) == NULL) return 1;
+    }
+
+    if (use_hashlife) {
+        return run_hashlife(grid, lifeboard_next(&board), hashlife_generations);
+    }
+
+    if (use_plane) {
+        return run_plane(grid, lifeboard_next(&board));
+    }
+    if (procs > 0) {
+        LifeShards *shards = lifeshards_new(grid, procs);
+        // The strips hold the board from here on
+        lifegrid_free(&start);
+        checkpoint_close(&ck);
+        if (shards == NULL) return 1;
+        return run_shards(shards, cols, rows, generation, batch_generations, checkpoint_path, checkpoint_every);
+    }
+    if (use_tiles) {
+        LifeTiles tiles;
+        if (!lifetiles_init(&tiles, &board)) {
+            fprintf(stderr, "ERROR: could not allocate the tile maps\n");
+            return 1;
+        }
+        while (1) {
+            lifetiles_step(&tiles);
+            print_grid(lifeboard_current(&board));
+            printf("active tiles %zu/%zu\n", lifetiles_active(&tiles), lifetiles_count(&tiles));
+            usleep(100000);
+        }
+    }
+
+    LifePool *pool = lifepool_new(&board, threads);
+    if (pool == NULL) {
+        fprintf(stderr, "ERROR: could not start %zu threads\n", threads);
+        return 1;
+    }
+
+    // The torus only has so many states, every run ends up in a cycle
+    CycleDetector cycle;
+    if (detect_cycles && !cycle_init(&cycle, grid->cells, grid->stride * grid->height, generation)) {
+        fprintf(stderr, "ERROR: could not allocate the cycle detector\n");
+        return 1;
+    }
+
+    // Headless: run all the generations at full speed, checkpointing on the
+    // way, and stop as soon as the run turns out to be periodic
+    if (batch_generations > 0) {
+        uint64_t end = generation + batch_generations;
+        bool periodic = false;
+        while (generation < end && !periodic) {
+            uint64_t n = end - generation;
+            if (checkpoint_every > 0 && n > checkpoint_every) n = checkpoint_every;
+            if (detect_cycles) {
+                // One generation at a time, the detector sees every state
+                for (uint64_t i = 0; i < n && !periodic; ++i) {
+                    pool_step(pool, 1);
+                    generation++;
+                    periodic = cycle_step(&cycle, lifeboard_next(&board)->cells, lifeboard_current(&board)->cells);
+                }
+            } else {
+                pool_step(pool, n);
+                generation += n;
+            }
+            if (checkpoint_path != NULL &&
+                !save_checkpoint(checkpoint_path, lifeboard_current(&board), generation)) return 1;
+            if (!save_image(lifeboard_current(&board), generation)) return 1;
+        }
+        if (periodic) report_cycle(&cycle, grid);
+        printf("generation %" PRIu64 ", population %zu\n", generation, lifegrid_popcount(lifeboard_current(&board)));
+        if (detect_cycles) cycle_free(&cycle);
+        lifepool_free(pool);
+        lifeboard_free(&board);
+        checkpoint_close(&ck);
+        return report_stats() ? 0 : 1;
+    }
 
     // Main loop
+    bool periodic = false;
     while (1) {
-        compute_new_state(old_grid, new_grid);
-        print_grid(new_grid);
-        usleep(100000);
-        compute_new_state(new_grid, old_grid);
-        print_grid(old_grid);
+        lifepool_step(pool, 1);
+        generation++;
+        print_grid(lifeboard_current(&board));
+        if (detect_cycles && !periodic &&
+            cycle_step(&cycle, lifeboard_next(&board)->cells, lifeboard_current(&board)->cells)) {
+            periodic = true;
+            report_cycle(&cycle, grid);
+        }
+        if (checkpoint_path != NULL && checkpoint_every > 0 && generation % checkpoint_every == 0 &&
+            !save_checkpoint(checkpoint_path, lifeboard_current(&board), generation)) return 1;
         usleep(100000);
     }
     return 0;
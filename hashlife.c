@@ -0,0 +1,487 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashlife.h"
+
+#define LEAF_LEVEL 3
+#define MIN_ROOT_LEVEL 5
+#define MAX_LEVEL 62
+#define NIL 0
+#define FREE_LEVEL 0xFF
+#define NO_STEP UINT_MAX
+
+enum { NW, NE, SW, SE };
+
+/* Nodes live in one growable array and refer to each other by index, so the
+ * array can be reallocated while a RESULT is being computed. Leaves hold an
+ * 8x8 block, cell x,y is bit y*8+x. */
+typedef struct {
+  union {
+    uint32_t child[4];
+    uint64_t bits;
+  } u;
+  uint64_t population;
+  uint32_t next;
+  uint32_t result;
+  uint8_t level;
+  uint8_t marked;
+} Node;
+
+struct HashLife {
+  Node *nodes;
+  size_t capacity;
+  size_t count;
+  size_t live;
+  uint32_t free_list;
+
+  uint32_t *buckets;
+  size_t bucket_mask;
+
+  size_t max_nodes;
+  size_t gc_threshold;
+
+  uint32_t empty[MAX_LEVEL + 1];
+  uint32_t root;
+  unsigned step_log2;
+  uint64_t generation;
+};
+
+static uint64_t mix64(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+static uint64_t hash_children(const uint32_t child[4]) {
+  uint64_t h = child[NW];
+  h = h * 0x9E3779B97F4A7C15ULL + child[NE];
+  h = h * 0x9E3779B97F4A7C15ULL + child[SW];
+  h = h * 0x9E3779B97F4A7C15ULL + child[SE];
+  return mix64(h);
+}
+
+static uint64_t hash_node(const Node *n) {
+  return n->level == LEAF_LEVEL ? mix64(n->u.bits) : hash_children(n->u.child);
+}
+
+static void rehash(HashLife *hl, size_t buckets) {
+  free(hl->buckets);
+  hl->buckets = calloc(buckets, sizeof(uint32_t));
+  if (hl->buckets == NULL) abort();
+  hl->bucket_mask = buckets - 1;
+  for (size_t i = 1; i < hl->count; ++i) {
+    Node *n = &hl->nodes[i];
+    if (n->level == FREE_LEVEL) continue;
+    size_t b = hash_node(n) & hl->bucket_mask;
+    n->next = hl->buckets[b];
+    hl->buckets[b] = (uint32_t)i;
+  }
+}
+
+static uint32_t alloc_node(HashLife *hl) {
+  uint32_t i;
+  if (hl->free_list != NIL) {
+    i = hl->free_list;
+    hl->free_list = hl->nodes[i].next;
+  } else {
+    if (hl->count == hl->capacity) {
+      hl->capacity *= 2;
+      hl->nodes = realloc(hl->nodes, hl->capacity * sizeof(Node));
+      if (hl->nodes == NULL) abort();
+    }
+    i = (uint32_t)hl->count++;
+  }
+  hl->live++;
+  return i;
+}
+
+/* Link a node, filled in by now, into its bucket. The table grows only
+ * here, as a rehash hashes every node in use. */
+static void insert_node(HashLife *hl, uint32_t i) {
+  size_t b = hash_node(&hl->nodes[i]) & hl->bucket_mask;
+  hl->nodes[i].next = hl->buckets[b];
+  hl->buckets[b] = i;
+  if (hl->live > hl->bucket_mask + 1) rehash(hl, 2 * (hl->bucket_mask + 1));
+}
+
+static uint32_t make_leaf(HashLife *hl, uint64_t bits) {
+  size_t b = mix64(bits) & hl->bucket_mask;
+  for (uint32_t i = hl->buckets[b]; i != NIL; i = hl->nodes[i].next) {
+    if (hl->nodes[i].level == LEAF_LEVEL && hl->nodes[i].u.bits == bits) return i;
+  }
+  uint32_t i = alloc_node(hl);
+  Node *n = &hl->nodes[i];
+  memset(n, 0, sizeof(*n));
+  n->u.bits = bits;
+  n->population = __builtin_popcountll(bits);
+  n->result = NIL;
+  n->level = LEAF_LEVEL;
+  insert_node(hl, i);
+  return i;
+}
+
+static uint32_t make_node(HashLife *hl, uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se) {
+  uint32_t child[4] = {nw, ne, sw, se};
+  size_t b = hash_children(child) & hl->bucket_mask;
+  for (uint32_t i = hl->buckets[b]; i != NIL; i = hl->nodes[i].next) {
+    const Node *n = &hl->nodes[i];
+    if (n->level != LEAF_LEVEL && n->u.child[NW] == nw && n->u.child[NE] == ne &&
+        n->u.child[SW] == sw && n->u.child[SE] == se) return i;
+  }
+  uint32_t i = alloc_node(hl);
+  Node *n = &hl->nodes[i];
+  memset(n, 0, sizeof(*n));
+  memcpy(n->u.child, child, sizeof(child));
+  n->population = hl->nodes[nw].population + hl->nodes[ne].population +
+                  hl->nodes[sw].population + hl->nodes[se].population;
+  n->result = NIL;
+  n->level = hl->nodes[nw].level + 1;
+  insert_node(hl, i);
+  return i;
+}
+
+static uint32_t empty_node(HashLife *hl, unsigned level) {
+  assert(level >= LEAF_LEVEL && level <= MAX_LEVEL);
+  if (hl->empty[level] == NIL) {
+    if (level == LEAF_LEVEL) {
+      hl->empty[level] = make_leaf(hl, 0);
+    } else {
+      uint32_t e = empty_node(hl, level - 1);
+      hl->empty[level] = make_node(hl, e, e, e, e);
+    }
+  }
+  return hl->empty[level];
+}
+
+static void mark(HashLife *hl, uint32_t i) {
+  if (i == NIL || hl->nodes[i].marked) return;
+  hl->nodes[i].marked = 1;
+  const Node *n = &hl->nodes[i];
+  if (n->level > LEAF_LEVEL) {
+    for (int q = 0; q < 4; ++q) mark(hl, hl->nodes[i].u.child[q]);
+  }
+}
+
+/* Free every node that is not reachable from the root or the empty nodes.
+ * Memoized results survive when the node they point to survives too. */
+static void collect_garbage(HashLife *hl) {
+  mark(hl, hl->root);
+  for (int l = 0; l <= MAX_LEVEL; ++l) mark(hl, hl->empty[l]);
+
+  for (size_t i = 1; i < hl->count; ++i) {
+    Node *n = &hl->nodes[i];
+    if (n->level != FREE_LEVEL && n->marked && n->result != NIL && !hl->nodes[n->result].marked) {
+      n->result = NIL;
+    }
+  }
+
+  hl->free_list = NIL;
+  hl->live = 0;
+  for (size_t i = hl->count - 1; i >= 1; --i) {
+    Node *n = &hl->nodes[i];
+    if (n->level != FREE_LEVEL && n->marked) {
+      n->marked = 0;
+      hl->live++;
+    } else {
+      n->level = FREE_LEVEL;
+      n->next = hl->free_list;
+      hl->free_list = (uint32_t)i;
+    }
+  }
+  rehash(hl, hl->bucket_mask + 1);
+
+  hl->gc_threshold = hl->max_nodes;
+  if (hl->live * 2 > hl->gc_threshold) hl->gc_threshold = hl->live * 2;
+}
+
+static void maybe_collect_garbage(HashLife *hl) {
+  if (hl->live > hl->gc_threshold) collect_garbage(hl);
+}
+
+HashLife *hashlife_new(size_t max_nodes) {
+  HashLife *hl = calloc(1, sizeof(*hl));
+  if (hl == NULL) return NULL;
+  hl->capacity = 1024;
+  hl->nodes = malloc(hl->capacity * sizeof(Node));
+  hl->buckets = calloc(1024, sizeof(uint32_t));
+  if (hl->nodes == NULL || hl->buckets == NULL) {
+    hashlife_free(hl);
+    return NULL;
+  }
+  hl->bucket_mask = 1024 - 1;
+  memset(&hl->nodes[NIL], 0, sizeof(Node));
+  hl->count = 1;
+  hl->max_nodes = max_nodes;
+  hl->gc_threshold = max_nodes;
+  hl->step_log2 = NO_STEP;
+  hl->root = empty_node(hl, MIN_ROOT_LEVEL);
+  return hl;
+}
+
+void hashlife_free(HashLife *hl) {
+  if (hl == NULL) return;
+  free(hl->nodes);
+  free(hl->buckets);
+  free(hl);
+}
+
+/* Grow the root one level, keeping the pattern centred on the origin. */
+static void expand(HashLife *hl) {
+  const Node *r = &hl->nodes[hl->root];
+  assert(r->level < MAX_LEVEL);
+  uint32_t c[4];
+  memcpy(c, r->u.child, sizeof(c));
+  uint32_t e = empty_node(hl, r->level - 1);
+  uint32_t nw = make_node(hl, e, e, e, c[NW]);
+  uint32_t ne = make_node(hl, e, e, c[NE], e);
+  uint32_t sw = make_node(hl, e, c[SW], e, e);
+  uint32_t se = make_node(hl, c[SE], e, e, e);
+  hl->root = make_node(hl, nw, ne, sw, se);
+}
+
+static int64_t root_half(const HashLife *hl) {
+  return (int64_t)1 << (hl->nodes[hl->root].level - 1);
+}
+
+static bool root_contains(const HashLife *hl, int64_t x, int64_t y) {
+  int64_t half = root_half(hl);
+  return x >= -half && x < half && y >= -half && y < half;
+}
+
+static uint32_t set_rec(HashLife *hl, uint32_t i, int64_t x, int64_t y, bool alive) {
+  const Node *n = &hl->nodes[i];
+  if (n->level == LEAF_LEVEL) {
+    uint64_t bit = (uint64_t)1 << (y * 8 + x);
+    return make_leaf(hl, alive ? n->u.bits | bit : n->u.bits & ~bit);
+  }
+  int64_t half = (int64_t)1 << (n->level - 1);
+  uint32_t c[4];
+  memcpy(c, n->u.child, sizeof(c));
+  int q = (y >= half) * 2 + (x >= half);
+  c[q] = set_rec(hl, c[q], x % half, y % half, alive);
+  return make_node(hl, c[NW], c[NE], c[SW], c[SE]);
+}
+
+void hashlife_set(HashLife *hl, int64_t x, int64_t y, bool alive) {
+  if (!alive && !root_contains(hl, x, y)) return;
+  while (!root_contains(hl, x, y)) expand(hl);
+  int64_t half = root_half(hl);
+  hl->root = set_rec(hl, hl->root, x + half, y + half, alive);
+  maybe_collect_garbage(hl);
+}
+
+bool hashlife_get(HashLife *hl, int64_t x, int64_t y) {
+  if (!root_contains(hl, x, y)) return false;
+  int64_t half = root_half(hl);
+  x += half;
+  y += half;
+  uint32_t i = hl->root;
+  while (hl->nodes[i].level > LEAF_LEVEL) {
+    if (hl->nodes[i].population == 0) return false;
+    half = (int64_t)1 << (hl->nodes[i].level - 1);
+    int q = (y >= half) * 2 + (x >= half);
+    i = hl->nodes[i].u.child[q];
+    x %= half;
+    y %= half;
+  }
+  return (hl->nodes[i].u.bits >> (y * 8 + x)) & 1;
+}
+
+void hashlife_load(HashLife *hl, const LifeGrid *grid, int64_t x, int64_t y) {
+  for (size_t gy = 0; gy < grid->height; ++gy) {
+    const uint64_t *row = lifegrid_row(grid, gy);
+    for (size_t k = 0; k < grid->stride; ++k) {
+      for (uint64_t word = row[k]; word != 0; word &= word - 1) {
+        size_t gx = k * 64 + __builtin_ctzll(word);
+        hashlife_set(hl, x + (int64_t)gx, y + (int64_t)gy, true);
+      }
+    }
+  }
+}
+
+static void read_rec(HashLife *hl, uint32_t i, int64_t nx, int64_t ny, int64_t rx, int64_t ry, LifeGrid *out) {
+  const Node *n = &hl->nodes[i];
+  int64_t size = (int64_t)1 << n->level;
+  if (n->population == 0) return;
+  if (nx >= rx + (int64_t)out->width || ny >= ry + (int64_t)out->height) return;
+  if (nx + size <= rx || ny + size <= ry) return;
+
+  if (n->level == LEAF_LEVEL) {
+    for (uint64_t bits = n->u.bits; bits != 0; bits &= bits - 1) {
+      int b = __builtin_ctzll(bits);
+      int64_t x = nx + b % 8 - rx, y = ny + b / 8 - ry;
+      if (x >= 0 && y >= 0 && x < (int64_t)out->width && y < (int64_t)out->height) {
+        lifegrid_set(out, (size_t)x, (size_t)y, true);
+      }
+    }
+    return;
+  }
+  int64_t half = size / 2;
+  uint32_t c[4];
+  memcpy(c, n->u.child, sizeof(c));
+  read_rec(hl, c[NW], nx, ny, rx, ry, out);
+  read_rec(hl, c[NE], nx + half, ny, rx, ry, out);
+  read_rec(hl, c[SW], nx, ny + half, rx, ry, out);
+  read_rec(hl, c[SE], nx + half, ny + half, rx, ry, out);
+}
+
+void hashlife_read(HashLife *hl, int64_t x, int64_t y, LifeGrid *out) {
+  lifegrid_clear(out);
+  int64_t half = root_half(hl);
+  read_rec(hl, hl->root, -half, -half, x, y, out);
+}
+
+/* A level 4 node as 16 rows of 16 cells. */
+static void gather16(const HashLife *hl, uint32_t i, uint32_t rows[16]) {
+  memset(rows, 0, 16 * sizeof(uint32_t));
+  for (int q = 0; q < 4; ++q) {
+    uint64_t bits = hl->nodes[hl->nodes[i].u.child[q]].u.bits;
+    int ox = (q & 1) * 8, oy = (q >> 1) * 8;
+    for (int r = 0; r < 8; ++r) {
+      rows[oy + r] |= (uint32_t)((bits >> (8 * r)) & 0xff) << ox;
+    }
+  }
+}
+
+static uint32_t centre_leaf16(HashLife *hl, const uint32_t rows[16]) {
+  uint64_t bits = 0;
+  for (int r = 0; r < 8; ++r) {
+    bits |= (uint64_t)((rows[4 + r] >> 4) & 0xff) << (8 * r);
+  }
+  return make_leaf(hl, bits);
+}
+
+/* The centre half of a node, at the same generation. */
+static uint32_t centre(HashLife *hl, uint32_t i) {
+  const Node *n = &hl->nodes[i];
+  if (n->level == LEAF_LEVEL + 1) {
+    uint32_t rows[16];
+    gather16(hl, i, rows);
+    return centre_leaf16(hl, rows);
+  }
+  const Node *c[4];
+  for (int q = 0; q < 4; ++q) c[q] = &hl->nodes[n->u.child[q]];
+  return make_node(hl, c[NW]->u.child[SE], c[NE]->u.child[SW], c[SW]->u.child[NE], c[SE]->u.child[NW]);
+}
+
+/* The 16x16 base case, stepped with the bit-sliced word kernel. Cells on the
+ * border see dead cells outside, but the damage only travels one cell per
+ * generation so the centre 8x8 is exact for up to four generations. */
+static uint32_t base_result(HashLife *hl, uint32_t i, unsigned generations) {
+  uint32_t rows[16], next[16];
+  gather16(hl, i, rows);
+  for (unsigned g = 0; g < generations; ++g) {
+    for (int y = 0; y < 16; ++y) {
+      uint64_t u = y > 0 ? rows[y - 1] : 0;
+      uint64_t c = rows[y];
+      uint64_t d = y < 15 ? rows[y + 1] : 0;
+      next[y] = (uint32_t)(lifegrid_word(u << 1, u, u >> 1, c << 1, c, c >> 1, d << 1, d, d >> 1) & 0xffff);
+    }
+    memcpy(rows, next, sizeof(rows));
+  }
+  return centre_leaf16(hl, rows);
+}
+
+/* RESULT of a level L node: its centre half, 2^min(step_log2, L-2)
+ * generations later. */
+static uint32_t result(HashLife *hl, uint32_t i) {
+  if (hl->nodes[i].result != NIL) return hl->nodes[i].result;
+
+  unsigned level = hl->nodes[i].level;
+  uint32_t res;
+  if (hl->nodes[i].population == 0) {
+    res = empty_node(hl, level - 1);
+  } else if (level == LEAF_LEVEL + 1) {
+    unsigned k = hl->step_log2 < 2 ? hl->step_log2 : 2;
+    res = base_result(hl, i, 1u << k);
+  } else {
+    bool full_speed = hl->step_log2 >= level - 2;
+
+    // The 4x4 grandchildren, from which the 9 overlapping sub-squares are built
+    uint32_t g[4][4];
+    for (int q = 0; q < 4; ++q) {
+      uint32_t c = hl->nodes[i].u.child[q];
+      for (int s = 0; s < 4; ++s) {
+        g[(q >> 1) * 2 + (s >> 1)][(q & 1) * 2 + (s & 1)] = hl->nodes[c].u.child[s];
+      }
+    }
+    uint32_t r[3][3];
+    for (int y = 0; y < 3; ++y) {
+      for (int x = 0; x < 3; ++x) {
+        uint32_t sub = make_node(hl, g[y][x], g[y][x + 1], g[y + 1][x], g[y + 1][x + 1]);
+        r[y][x] = result(hl, sub);
+      }
+    }
+    uint32_t out[2][2];
+    for (int y = 0; y < 2; ++y) {
+      for (int x = 0; x < 2; ++x) {
+        uint32_t sub = make_node(hl, r[y][x], r[y][x + 1], r[y + 1][x], r[y + 1][x + 1]);
+        out[y][x] = full_speed ? result(hl, sub) : centre(hl, sub);
+      }
+    }
+    res = make_node(hl, out[0][0], out[0][1], out[1][0], out[1][1]);
+  }
+  hl->nodes[i].result = res;
+  return res;
+}
+
+/* The grandchild of node i in quadrant q of quadrant q. */
+static uint32_t corner(const HashLife *hl, uint32_t i, int q) {
+  return hl->nodes[hl->nodes[i].u.child[q]].u.child[q];
+}
+
+/* True when all the live cells of the root are in the centre square of a
+ * quarter of its width, the square made of the innermost great-grandchildren.
+ * The result is the centre half, so the pattern can then grow by a quarter of
+ * the width on every side without being cut. Needs a root of level 6. */
+static bool root_is_padded(const HashLife *hl) {
+  const Node *r = &hl->nodes[hl->root];
+  uint64_t inner = hl->nodes[corner(hl, r->u.child[NW], SE)].population +
+                   hl->nodes[corner(hl, r->u.child[NE], SW)].population +
+                   hl->nodes[corner(hl, r->u.child[SW], NE)].population +
+                   hl->nodes[corner(hl, r->u.child[SE], NW)].population;
+  return inner == r->population;
+}
+
+void hashlife_step_pow2(HashLife *hl, unsigned k) {
+  assert(k + 3 <= MAX_LEVEL);
+  if (k != hl->step_log2) {
+    // Memoized results are only valid for the step size they were computed with
+    for (size_t i = 1; i < hl->count; ++i) hl->nodes[i].result = NIL;
+    hl->step_log2 = k;
+  }
+  maybe_collect_garbage(hl);
+
+  // Pad the root so that nothing can travel out of its centre half in 2^k generations
+  while (hl->nodes[hl->root].level < k + 3 || hl->nodes[hl->root].level < LEAF_LEVEL + 3 ||
+         !root_is_padded(hl)) {
+    expand(hl);
+  }
+  hl->root = result(hl, hl->root);
+  hl->generation += (uint64_t)1 << k;
+
+  maybe_collect_garbage(hl);
+}
+
+void hashlife_step(HashLife *hl, uint64_t n) {
+  for (unsigned k = 0; n != 0; ++k, n >>= 1) {
+    if (n & 1) hashlife_step_pow2(hl, k);
+  }
+}
+
+uint64_t hashlife_generation(const HashLife *hl) {
+  return hl->generation;
+}
+
+uint64_t hashlife_population(const HashLife *hl) {
+  return hl->nodes[hl->root].population;
+}
+
+size_t hashlife_node_count(const HashLife *hl) {
+  return hl->live;
+}
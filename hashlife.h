@@ -0,0 +1,42 @@
+#ifndef HASHLIFE_H_
+#define HASHLIFE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lifegrid.h"
+
+/* HashLife on the unbounded plane. The universe is a hash-consed quadtree
+ * whose leaves are 8x8 blocks of cells; the RESULT of every node (its centre
+ * half, 2^k generations later) is memoized in the node itself, so repeated
+ * structure in space and time is only ever computed once. */
+typedef struct HashLife HashLife;
+
+/* Create an empty universe. max_nodes bounds the node cache: when a step or
+ * an edit leaves more nodes than that, the nodes unreachable from the current
+ * pattern are garbage collected. Live nodes are never dropped, so a pattern
+ * that needs more than max_nodes raises the bound instead. */
+HashLife *hashlife_new(size_t max_nodes);
+void hashlife_free(HashLife *hl);
+
+void hashlife_set(HashLife *hl, int64_t x, int64_t y, bool alive);
+bool hashlife_get(HashLife *hl, int64_t x, int64_t y);
+
+/* Set every live cell of grid at the offset x,y of the plane. */
+void hashlife_load(HashLife *hl, const LifeGrid *grid, int64_t x, int64_t y);
+
+/* Copy the region of the plane starting at x,y with the size of out into out. */
+void hashlife_read(HashLife *hl, int64_t x, int64_t y, LifeGrid *out);
+
+/* Advance the universe by 2^k generations. */
+void hashlife_step_pow2(HashLife *hl, unsigned k);
+
+/* Advance the universe by n generations, as a sum of power of two jumps. */
+void hashlife_step(HashLife *hl, uint64_t n);
+
+uint64_t hashlife_generation(const HashLife *hl);
+uint64_t hashlife_population(const HashLife *hl);
+size_t hashlife_node_count(const HashLife *hl);
+
+#endif // HASHLIFE_H_
@@ -0,0 +1,358 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "history.h"
+
+#define TILE HISTORY_TILE
+#define TILE_BYTES (TILE * TILE)
+
+/* A level 0 tile is one word (64 cells) of 64 generations. Every word gets
+ * a 2-bit tag, and only the literal ones are stored after the tags, so
+ * empty, full and vertically repeating regions shrink to the 16 tag bytes. */
+enum { WORD_ZERO, WORD_ONES, WORD_ABOVE, WORD_LITERAL };
+#define TAG_BYTES (TILE / 4)
+
+/* TILE texel rows of a level, one tile per TILE texels across. */
+typedef struct {
+  uint8_t **tiles;
+  size_t *sizes;
+  size_t filled; // texel rows written so far, published with a release store
+} Band;
+
+typedef struct {
+  size_t texels;
+  size_t tiles_x;
+  Band *bands; // band ty lives in bands[ty % cap]
+  size_t cap;
+  uint64_t first; // oldest band still stored
+  uint64_t end;   // one past the newest band
+} Level;
+
+struct History {
+  size_t width;
+  size_t words;
+  size_t budget;
+  size_t bytes;
+  Level levels[HISTORY_LEVELS];
+  uint64_t generations;
+  uint64_t *band_bits; // the level 0 band being filled, TILE rows of words
+  uint64_t *prev;      // the generation before the current one
+  pthread_mutex_t lock;
+};
+
+static Band *level_band(const Level *lv, uint64_t ty) {
+  if (ty < lv->first || ty >= lv->end) return NULL;
+  return &lv->bands[ty % lv->cap];
+}
+
+static size_t band_bytes(const Level *lv, const Band *b, bool compressed) {
+  if (!compressed) return lv->tiles_x * TILE_BYTES;
+  size_t bytes = 0;
+  for (size_t tx = 0; tx < lv->tiles_x; ++tx) bytes += b->sizes[tx];
+  return bytes;
+}
+
+static void band_free(Band *b, size_t tiles_x) {
+  for (size_t tx = 0; tx < tiles_x; ++tx) free(b->tiles[tx]);
+  free(b->tiles);
+  free(b->sizes);
+  memset(b, 0, sizeof(*b));
+}
+
+/* Drop the oldest bands of the finest levels until the pyramid fits in its
+ * budget again. The newest band of a level is never dropped, it is the one
+ * being written. Called with the lock held. */
+static void evict(History *h) {
+  while (h->bytes > h->budget) {
+    unsigned l = 0;
+    while (l < HISTORY_LEVELS && h->levels[l].end - h->levels[l].first <= 1) l++;
+    if (l == HISTORY_LEVELS) return;
+    Level *lv = &h->levels[l];
+    Band *b = &lv->bands[lv->first % lv->cap];
+    h->bytes -= band_bytes(lv, b, l == 0);
+    band_free(b, lv->tiles_x);
+    lv->first++;
+  }
+}
+
+/* Append a new band to the level, growing the ring of bands if it is full.
+ * Coarse levels get zeroed tiles to fill in row by row, level 0 gets the
+ * compressed tiles handed in. */
+static Band *push_band(History *h, unsigned l, uint8_t **tiles, size_t *sizes) {
+  Level *lv = &h->levels[l];
+  pthread_mutex_lock(&h->lock);
+  if (lv->end - lv->first == lv->cap) {
+    size_t cap = lv->cap ? 2 * lv->cap : 4;
+    Band *bands = calloc(cap, sizeof(Band));
+    if (bands == NULL) abort();
+    for (uint64_t ty = lv->first; ty < lv->end; ++ty) bands[ty % cap] = lv->bands[ty % lv->cap];
+    free(lv->bands);
+    lv->bands = bands;
+    lv->cap = cap;
+  }
+
+  Band *b = &lv->bands[lv->end % lv->cap];
+  if (tiles != NULL) {
+    b->tiles = tiles;
+    b->sizes = sizes;
+    b->filled = TILE;
+  } else {
+    b->tiles = calloc(lv->tiles_x, sizeof(uint8_t *));
+    if (b->tiles == NULL) abort();
+    for (size_t tx = 0; tx < lv->tiles_x; ++tx) {
+      if ((b->tiles[tx] = calloc(TILE_BYTES, 1)) == NULL) abort();
+    }
+    b->filled = 0;
+  }
+  h->bytes += band_bytes(lv, b, l == 0);
+  lv->end++;
+  evict(h);
+  pthread_mutex_unlock(&h->lock);
+  return b;
+}
+
+History *history_new(size_t width, size_t budget) {
+  History *h = calloc(1, sizeof(History));
+  if (h == NULL) return NULL;
+  pthread_mutex_init(&h->lock, NULL);
+  h->width = width;
+  h->words = bitrow_words(width);
+  h->budget = budget;
+  h->band_bits = calloc(TILE * (h->words ? h->words : 1), sizeof(uint64_t));
+  h->prev = calloc(h->words ? h->words : 1, sizeof(uint64_t));
+  if (h->band_bits == NULL || h->prev == NULL) {
+    history_free(h);
+    return NULL;
+  }
+  for (unsigned l = 0; l < HISTORY_LEVELS; ++l) {
+    Level *lv = &h->levels[l];
+    lv->texels = (width + ((size_t)1 << l) - 1) >> l;
+    lv->tiles_x = (lv->texels + TILE - 1) / TILE;
+  }
+  return h;
+}
+
+static void clear_levels(History *h) {
+  for (unsigned l = 0; l < HISTORY_LEVELS; ++l) {
+    Level *lv = &h->levels[l];
+    for (uint64_t ty = lv->first; ty < lv->end; ++ty) band_free(&lv->bands[ty % lv->cap], lv->tiles_x);
+    lv->first = lv->end = 0;
+  }
+  h->bytes = 0;
+}
+
+void history_free(History *h) {
+  if (h == NULL) return;
+  clear_levels(h);
+  pthread_mutex_destroy(&h->lock);
+  for (unsigned l = 0; l < HISTORY_LEVELS; ++l) free(h->levels[l].bands);
+  free(h->band_bits);
+  free(h->prev);
+  free(h);
+}
+
+void history_clear(History *h) {
+  pthread_mutex_lock(&h->lock);
+  clear_levels(h);
+  __atomic_store_n(&h->generations, 0, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&h->lock);
+}
+
+uint64_t history_generations(History *h) {
+  return __atomic_load_n(&h->generations, __ATOMIC_ACQUIRE);
+}
+
+size_t history_level_width(const History *h, unsigned level) {
+  return h->levels[level].texels;
+}
+
+size_t history_memory(History *h) {
+  pthread_mutex_lock(&h->lock);
+  size_t bytes = h->bytes;
+  pthread_mutex_unlock(&h->lock);
+  return bytes;
+}
+
+/* Compress word tx of the TILE rows of band_bits into out, returning the
+ * number of bytes used. */
+static size_t compress_tile(const uint64_t *bits, size_t words, size_t tx, uint8_t *out) {
+  memset(out, 0, TAG_BYTES);
+  size_t n = TAG_BYTES;
+  uint64_t above = 0;
+  for (size_t r = 0; r < TILE; ++r) {
+    uint64_t w = bits[r * words + tx];
+    unsigned tag = w == 0 ? WORD_ZERO : w == ~(uint64_t)0 ? WORD_ONES : w == above ? WORD_ABOVE : WORD_LITERAL;
+    out[r / 4] |= tag << (2 * (r % 4));
+    if (tag == WORD_LITERAL) {
+      memcpy(out + n, &w, sizeof(w));
+      n += sizeof(w);
+    }
+    above = w;
+  }
+  return n;
+}
+
+/* Expand a compressed level 0 tile into TILE x TILE densities of 0 or 255. */
+static void expand_tile(const uint8_t *data, uint8_t *out) {
+  const uint8_t *literal = data + TAG_BYTES;
+  uint64_t w = 0;
+  for (size_t r = 0; r < TILE; ++r) {
+    switch ((data[r / 4] >> (2 * (r % 4))) & 3) {
+    case WORD_ZERO: w = 0; break;
+    case WORD_ONES: w = ~(uint64_t)0; break;
+    case WORD_ABOVE: break;
+    default:
+      memcpy(&w, literal, sizeof(w));
+      literal += sizeof(w);
+      break;
+    }
+    for (size_t x = 0; x < TILE; ++x) out[r * TILE + x] = (w >> x) & 1 ? 255 : 0;
+  }
+}
+
+static void commit_level0(History *h) {
+  Level *lv = &h->levels[0];
+  uint8_t **tiles = calloc(lv->tiles_x, sizeof(uint8_t *));
+  size_t *sizes = calloc(lv->tiles_x, sizeof(size_t));
+  if (tiles == NULL || sizes == NULL) abort();
+  uint8_t buf[TAG_BYTES + TILE * sizeof(uint64_t)];
+  for (size_t tx = 0; tx < lv->tiles_x; ++tx) {
+    sizes[tx] = compress_tile(h->band_bits, h->words, tx, buf);
+    if ((tiles[tx] = malloc(sizes[tx])) == NULL) abort();
+    memcpy(tiles[tx], buf, sizes[tx]);
+  }
+  push_band(h, 0, tiles, sizes);
+}
+
+/* The band that texel row y of a coarse level goes into, added if y is the
+ * first row of a new band. */
+static Band *band_for_write(History *h, unsigned l, uint64_t y) {
+  Level *lv = &h->levels[l];
+  if (y / TILE == lv->end) return push_band(h, l, NULL, NULL);
+  return &lv->bands[(y / TILE) % lv->cap];
+}
+
+static void publish_row(Band *b, uint64_t y) {
+  __atomic_store_n(&b->filled, (size_t)(y % TILE) + 1, __ATOMIC_RELEASE);
+}
+
+/* Write texel row y of level l from the two rows below it in level l-1, and
+ * carry on upwards every time a level completes a pair of rows. */
+static void aggregate(History *h, unsigned l, uint64_t y) {
+  for (; l < HISTORY_LEVELS; ++l, y /= 2) {
+    Level *lv = &h->levels[l];
+    Level *below = &h->levels[l - 1];
+    Band *b = band_for_write(h, l, y);
+    const Band *src = &below->bands[(2 * y / TILE) % below->cap];
+    size_t r0 = (2 * y) % TILE, r1 = r0 + 1;
+
+    for (size_t x = 0; x < lv->texels; ++x) {
+      size_t sx = 2 * x;
+      const uint8_t *t0 = src->tiles[sx / TILE];
+      unsigned sum = t0[r0 * TILE + sx % TILE] + t0[r1 * TILE + sx % TILE];
+      if (sx + 1 < below->texels) {
+        const uint8_t *t1 = src->tiles[(sx + 1) / TILE];
+        sum += t1[r0 * TILE + (sx + 1) % TILE] + t1[r1 * TILE + (sx + 1) % TILE];
+      }
+      b->tiles[x / TILE][(y % TILE) * TILE + x % TILE] = (sum + 2) / 4;
+    }
+    publish_row(b, y);
+    if (y % 2 == 0) return;
+  }
+}
+
+void history_append(History *h, const BitRow *row) {
+  uint64_t g = h->generations;
+  size_t r = g % TILE;
+  memcpy(h->band_bits + r * h->words, row->bits, h->words * sizeof(uint64_t));
+
+  // Level 1 counts the live cells of 2x2 blocks straight from the bits
+  if (g % 2 == 1) {
+    Level *lv = &h->levels[1];
+    uint64_t y = g / 2;
+    Band *b = band_for_write(h, 1, y);
+    for (size_t x = 0; x < lv->texels; ++x) {
+      size_t w = 2 * x / 64, s = 2 * x % 64;
+      unsigned n = __builtin_popcountll((h->prev[w] >> s) & 3) + __builtin_popcountll((row->bits[w] >> s) & 3);
+      b->tiles[x / TILE][(y % TILE) * TILE + x % TILE] = (n * 255 + 2) / 4;
+    }
+    publish_row(b, y);
+    if (y % 2 == 1) aggregate(h, 2, y / 2);
+  } else {
+    memcpy(h->prev, row->bits, h->words * sizeof(uint64_t));
+  }
+
+  if (r == TILE - 1) commit_level0(h);
+  __atomic_store_n(&h->generations, g + 1, __ATOMIC_RELEASE);
+}
+
+/* The tile of level l at ty,tx and the number of its rows written so far,
+ * or NULL if the level does not have it. Level 0 tiles are expanded into
+ * scratch. Called with the lock held. */
+static const uint8_t *read_tile(History *h, unsigned l, uint64_t ty, size_t tx, size_t *filled, uint8_t *scratch) {
+  const Level *lv = &h->levels[l];
+  const Band *b = level_band(lv, ty);
+  if (b == NULL || tx >= lv->tiles_x) return NULL;
+  *filled = __atomic_load_n(&b->filled, __ATOMIC_ACQUIRE);
+  if (l > 0) return b->tiles[tx];
+  expand_tile(b->tiles[tx], scratch);
+  return scratch;
+}
+
+/* Fill the rows [y0,y1) and columns [x0,x1) of out, which starts at texel
+ * ox,oy of level l and has w texels per row, from coarser levels. */
+static void fill_coarser(History *h, unsigned l, uint64_t y0, uint64_t y1, size_t x0, size_t x1,
+                         int64_t ox, int64_t oy, size_t w, uint8_t *out) {
+  for (uint64_t y = y0; y < y1; ++y) {
+    for (unsigned c = l + 1; c < HISTORY_LEVELS; ++c) {
+      unsigned d = c - l;
+      uint64_t cy = y >> d;
+      size_t filled;
+      bool found = false;
+      for (size_t x = x0; x < x1;) {
+        size_t cx = x >> d, tx = cx / TILE;
+        const uint8_t *tile = read_tile(h, c, cy / TILE, tx, &filled, NULL);
+        if (tile == NULL || cy % TILE >= filled) break;
+        found = true;
+        // All the texels of out that fall in this coarse tile
+        size_t end = ((tx + 1) * TILE) << d;
+        if (end > x1) end = x1;
+        for (; x < end; ++x) out[(y - oy) * w + (x - ox)] = tile[(cy % TILE) * TILE + (x >> d) % TILE];
+      }
+      if (found) break;
+    }
+  }
+}
+
+void history_read(History *h, unsigned level, int64_t x0, int64_t y0, size_t w, size_t rows, uint8_t *out) {
+  memset(out, 0, w * rows);
+  const Level *lv = &h->levels[level];
+
+  // Clip the region to the diagram
+  int64_t xs = x0 < 0 ? 0 : x0, ys = y0 < 0 ? 0 : y0;
+  int64_t xe = x0 + (int64_t)w, ye = y0 + (int64_t)rows;
+  if (xe > (int64_t)lv->texels) xe = lv->texels;
+  if (xs >= xe || ys >= ye) return;
+
+  uint8_t scratch[TILE_BYTES];
+  pthread_mutex_lock(&h->lock);
+  for (uint64_t ty = ys / TILE; ty * TILE < (uint64_t)ye; ++ty) {
+    uint64_t ty0 = ty * TILE > (uint64_t)ys ? ty * TILE : (uint64_t)ys;
+    uint64_t ty1 = (ty + 1) * TILE < (uint64_t)ye ? (ty + 1) * TILE : (uint64_t)ye;
+    for (size_t tx = xs / TILE; tx * TILE < (size_t)xe; ++tx) {
+      size_t tx0 = tx * TILE > (size_t)xs ? tx * TILE : (size_t)xs;
+      size_t tx1 = (tx + 1) * TILE < (size_t)xe ? (tx + 1) * TILE : (size_t)xe;
+      size_t filled = 0;
+      const uint8_t *tile = read_tile(h, level, ty, tx, &filled, scratch);
+      uint64_t copied = ty0;
+      if (tile != NULL) {
+        for (; copied < ty1 && copied % TILE < filled; ++copied) {
+          memcpy(out + (copied - y0) * w + (tx0 - x0), tile + (copied % TILE) * TILE + tx0 % TILE, tx1 - tx0);
+        }
+      }
+      if (copied < ty1) fill_coarser(h, level, copied, ty1, tx0, tx1, x0, y0, w, out);
+    }
+  }
+  pthread_mutex_unlock(&h->lock);
+}
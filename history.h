@@ -0,0 +1,53 @@
+#ifndef HISTORY_H_
+#define HISTORY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitrow.h"
+
+/* Tiles are HISTORY_TILE x HISTORY_TILE texels; level L has one texel per
+ * 2^L x 2^L cells of the spacetime diagram. */
+#define HISTORY_TILE 64
+#define HISTORY_LEVELS 24
+
+/* The spacetime diagram of a 1D automaton as a multi-resolution pyramid of
+ * tiles, like a mipmap. Level 0 holds the cells themselves in bit-packed
+ * tiles of 64 generations by 64 cells, compressed; every coarser level holds
+ * the density of live cells (0 to 255) of 2x2 texels of the level below.
+ * All levels are built as the generations come in. Tiles are grouped in
+ * bands of 64 texel rows, and once the pyramid is over its memory budget
+ * the oldest bands of the finest level go first, so long runs keep their
+ * recent past in detail and the rest at coarser resolutions.
+ *
+ * One thread appends generations while another reads: appending a row only
+ * takes the lock when a band is added or dropped, reading takes it for the
+ * whole read. */
+typedef struct History History;
+
+/* A history of a tape of width cells using about budget bytes. */
+History *history_new(size_t width, size_t budget);
+void history_free(History *h);
+
+/* Writer side: forget everything, and add the next generation. */
+void history_clear(History *h);
+void history_append(History *h, const BitRow *row);
+
+/* The number of generations appended so far. */
+uint64_t history_generations(History *h);
+
+/* Width in texels of the given level. */
+size_t history_level_width(const History *h, unsigned level);
+
+/* Fill out, w x rows texels row by row, with the densities of the region of
+ * level starting at texel x0,y0. Where the level was already dropped the
+ * nearest coarser level that still has the region fills in, and anything
+ * not known (not written yet or outside the diagram) reads as 0. Level 0
+ * is complete 64 generations at a time, coarser levels row by row. */
+void history_read(History *h, unsigned level, int64_t x0, int64_t y0, size_t w, size_t rows, uint8_t *out);
+
+/* Bytes held by all the stored tiles. */
+size_t history_memory(History *h);
+
+#endif // HISTORY_H_
@@ -0,0 +1,408 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lifegrid.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define LIFE_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/* The neighbourhood of a word of cells, as nine aligned rows: the row above,
+ * the row itself and the row below, each also shifted west and east. */
+enum { NB_UW, NB_U, NB_UE, NB_W, NB_C, NB_E, NB_DW, NB_D, NB_DE, COUNT_NB };
+
+typedef void (*LifeRowFn)(uint64_t *out, const uint64_t *const nb[COUNT_NB], size_t n);
+
+static void life_row_scalar(uint64_t *out, const uint64_t *const nb[COUNT_NB], size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = lifegrid_word(nb[NB_UW][i], nb[NB_U][i], nb[NB_UE][i],
+                           nb[NB_W][i], nb[NB_C][i], nb[NB_E][i],
+                           nb[NB_DW][i], nb[NB_D][i], nb[NB_DE][i]);
+  }
+}
+
+#ifdef LIFE_HAVE_X86_SIMD
+
+__attribute__((target("avx2")))
+static void life_row_avx2(uint64_t *out, const uint64_t *const nb[COUNT_NB], size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+#define LD(k) _mm256_loadu_si256((const __m256i *)(nb[k] + i))
+    __m256i uw = LD(NB_UW), u = LD(NB_U), ue = LD(NB_UE);
+    __m256i w = LD(NB_W), c = LD(NB_C), e = LD(NB_E);
+    __m256i dw = LD(NB_DW), d = LD(NB_D), de = LD(NB_DE);
+#undef LD
+    __m256i t0 = _mm256_xor_si256(uw, u), s0 = _mm256_xor_si256(t0, ue);
+    __m256i c0 = _mm256_or_si256(_mm256_and_si256(uw, u), _mm256_and_si256(t0, ue));
+    __m256i t1 = _mm256_xor_si256(w, e), s1 = _mm256_xor_si256(t1, dw);
+    __m256i c1 = _mm256_or_si256(_mm256_and_si256(w, e), _mm256_and_si256(t1, dw));
+    __m256i s2 = _mm256_xor_si256(d, de), c2 = _mm256_and_si256(d, de);
+    __m256i t3 = _mm256_xor_si256(s0, s1), ones = _mm256_xor_si256(t3, s2);
+    __m256i c3 = _mm256_or_si256(_mm256_and_si256(s0, s1), _mm256_and_si256(t3, s2));
+    __m256i t4 = _mm256_xor_si256(c0, c1), u4 = _mm256_xor_si256(t4, c2);
+    __m256i c4 = _mm256_or_si256(_mm256_and_si256(c0, c1), _mm256_and_si256(t4, c2));
+    __m256i twos = _mm256_xor_si256(u4, c3), c5 = _mm256_and_si256(u4, c3);
+    __m256i alive = _mm256_andnot_si256(_mm256_or_si256(c4, c5),
+                                        _mm256_and_si256(twos, _mm256_or_si256(ones, c)));
+    _mm256_storeu_si256((__m256i *)(out + i), alive);
+  }
+  for (; i < n; ++i) {
+    out[i] = lifegrid_word(nb[NB_UW][i], nb[NB_U][i], nb[NB_UE][i],
+                           nb[NB_W][i], nb[NB_C][i], nb[NB_E][i],
+                           nb[NB_DW][i], nb[NB_D][i], nb[NB_DE][i]);
+  }
+}
+
+/* With AVX-512 every full adder is two ternary logic instructions:
+ * 0x96 is the three-way XOR and 0xE8 the majority function. */
+__attribute__((target("avx512f")))
+static void life_row_avx512(uint64_t *out, const uint64_t *const nb[COUNT_NB], size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+#define LD(k) _mm512_loadu_si512((const void *)(nb[k] + i))
+    __m512i uw = LD(NB_UW), u = LD(NB_U), ue = LD(NB_UE);
+    __m512i w = LD(NB_W), c = LD(NB_C), e = LD(NB_E);
+    __m512i dw = LD(NB_DW), d = LD(NB_D), de = LD(NB_DE);
+#undef LD
+    __m512i s0 = _mm512_ternarylogic_epi64(uw, u, ue, 0x96);
+    __m512i c0 = _mm512_ternarylogic_epi64(uw, u, ue, 0xE8);
+    __m512i s1 = _mm512_ternarylogic_epi64(w, e, dw, 0x96);
+    __m512i c1 = _mm512_ternarylogic_epi64(w, e, dw, 0xE8);
+    __m512i s2 = _mm512_xor_si512(d, de), c2 = _mm512_and_si512(d, de);
+    __m512i ones = _mm512_ternarylogic_epi64(s0, s1, s2, 0x96);
+    __m512i c3 = _mm512_ternarylogic_epi64(s0, s1, s2, 0xE8);
+    __m512i u4 = _mm512_ternarylogic_epi64(c0, c1, c2, 0x96);
+    __m512i c4 = _mm512_ternarylogic_epi64(c0, c1, c2, 0xE8);
+    __m512i twos = _mm512_xor_si512(u4, c3), c5 = _mm512_and_si512(u4, c3);
+    __m512i alive = _mm512_andnot_si512(_mm512_or_si512(c4, c5),
+                                        _mm512_and_si512(twos, _mm512_or_si512(ones, c)));
+    _mm512_storeu_si512((void *)(out + i), alive);
+  }
+  for (; i < n; ++i) {
+    out[i] = lifegrid_word(nb[NB_UW][i], nb[NB_U][i], nb[NB_UE][i],
+                           nb[NB_W][i], nb[NB_C][i], nb[NB_E][i],
+                           nb[NB_DW][i], nb[NB_D][i], nb[NB_DE][i]);
+  }
+}
+
+#endif // LIFE_HAVE_X86_SIMD
+
+/* Any outer totalistic rule needs the whole neighbour count, not just
+ * whether it is 2 or 3, so the adder tree of lifegrid_word goes on to the
+ * fours and eights bit-planes. The next state is then the OR of one term
+ * per count the rule uses, and with constant masks the terms of the other
+ * counts fold away, which makes a dedicated kernel out of every rule. */
+static inline __attribute__((always_inline)) uint64_t rule_word(unsigned birth, unsigned survive,
+                                                                const uint64_t *const nb[COUNT_NB], size_t i) {
+  uint64_t uw = nb[NB_UW][i], u = nb[NB_U][i], ue = nb[NB_UE][i];
+  uint64_t w = nb[NB_W][i], c = nb[NB_C][i], e = nb[NB_E][i];
+  uint64_t dw = nb[NB_DW][i], d = nb[NB_D][i], de = nb[NB_DE][i];
+  uint64_t t0 = uw ^ u, s0 = t0 ^ ue, c0 = (uw & u) | (t0 & ue);
+  uint64_t t1 = w ^ e, s1 = t1 ^ dw, c1 = (w & e) | (t1 & dw);
+  uint64_t s2 = d ^ de, c2 = d & de;
+  uint64_t t3 = s0 ^ s1, ones = t3 ^ s2, c3 = (s0 & s1) | (t3 & s2);
+  uint64_t t4 = c0 ^ c1, u4 = t4 ^ c2, c4 = (c0 & c1) | (t4 & c2);
+  uint64_t twos = u4 ^ c3, c5 = u4 & c3;
+  uint64_t fours = c4 ^ c5, eights = c4 & c5;
+
+  uint64_t out = 0;
+#define COUNT_TERM(k)                                                             \
+  if ((birth | survive) >> (k) & 1) {                                             \
+    uint64_t eq = ((k) & 1 ? ones : ~ones) & ((k) & 2 ? twos : ~twos) &           \
+                  ((k) & 4 ? fours : ~fours) & ((k) & 8 ? eights : ~eights);      \
+    out |= eq & ((birth >> (k) & 1 ? ~c : 0) | (survive >> (k) & 1 ? c : 0));     \
+  }
+  COUNT_TERM(0) COUNT_TERM(1) COUNT_TERM(2) COUNT_TERM(3) COUNT_TERM(4)
+  COUNT_TERM(5) COUNT_TERM(6) COUNT_TERM(7) COUNT_TERM(8)
+#undef COUNT_TERM
+  return out;
+}
+
+/* Rules with a kernel of their own: name, birth and survive masks. */
+#define N(k) (1u << (k))
+#define LIFE_RULES(X)                                                             \
+  X(highlife, N(3) | N(6), N(2) | N(3))                                           \
+  X(seeds, N(2), 0)                                                               \
+  X(day_and_night, N(3) | N(6) | N(7) | N(8), N(3) | N(4) | N(6) | N(7) | N(8))   \
+  X(life_without_death, N(3), 0x1ff)                                              \
+  X(maze, N(3), N(1) | N(2) | N(3) | N(4) | N(5))                                 \
+  X(replicator, N(1) | N(3) | N(5) | N(7), N(1) | N(3) | N(5) | N(7))             \
+  X(two_by_two, N(3) | N(6), N(1) | N(2) | N(5))                                  \
+  X(diamoeba, N(3) | N(5) | N(6) | N(7) | N(8), N(5) | N(6) | N(7) | N(8))        \
+  X(morley, N(3) | N(6) | N(8), N(2) | N(4) | N(5))                               \
+  X(anneal, N(4) | N(6) | N(7) | N(8), N(3) | N(5) | N(6) | N(7) | N(8))
+
+#define LIFE_RULE_KERNEL(name, birth, survive)                                    \
+  static void life_row_##name(uint64_t *out, const uint64_t *const nb[COUNT_NB], size_t n) { \
+    for (size_t i = 0; i < n; ++i) out[i] = rule_word(birth, survive, nb, i);     \
+  }
+#define LIFE_RULE_ENTRY(name, birth, survive) {{birth, survive}, life_row_##name},
+
+LIFE_RULES(LIFE_RULE_KERNEL)
+
+static const struct {
+  LifeRule rule;
+  LifeRowFn row_fn;
+} rule_kernels[] = {LIFE_RULES(LIFE_RULE_ENTRY)};
+
+#undef N
+
+static LifeRule current_rule = {LIFE_RULE_CONWAY_BIRTH, LIFE_RULE_CONWAY_SURVIVE};
+
+static void life_row_generic(uint64_t *out, const uint64_t *const nb[COUNT_NB], size_t n) {
+  unsigned birth = current_rule.birth, survive = current_rule.survive;
+  for (size_t i = 0; i < n; ++i) out[i] = rule_word(birth, survive, nb, i);
+}
+
+static LifeKernel current_kernel = LIFE_KERNEL_AUTO;
+static LifeRowFn kernel_row_fn = NULL; // the B3/S23 kernel
+static LifeRowFn current_row_fn = NULL;
+
+static void select_row_fn(void) {
+  LifeRule conway = {LIFE_RULE_CONWAY_BIRTH, LIFE_RULE_CONWAY_SURVIVE};
+  if (liferule_equal(current_rule, conway)) {
+    current_row_fn = kernel_row_fn;
+    return;
+  }
+  current_row_fn = life_row_generic;
+  for (size_t i = 0; i < sizeof(rule_kernels) / sizeof(rule_kernels[0]); ++i) {
+    if (liferule_equal(current_rule, rule_kernels[i].rule)) current_row_fn = rule_kernels[i].row_fn;
+  }
+}
+
+static bool kernel_supported(LifeKernel kernel) {
+  switch (kernel) {
+  case LIFE_KERNEL_SCALAR: return true;
+#ifdef LIFE_HAVE_X86_SIMD
+  case LIFE_KERNEL_AVX2: return __builtin_cpu_supports("avx2");
+  case LIFE_KERNEL_AVX512: return __builtin_cpu_supports("avx512f");
+#endif
+  default: return false;
+  }
+}
+
+bool lifegrid_use_kernel(LifeKernel kernel) {
+  if (kernel == LIFE_KERNEL_AUTO) {
+    kernel = LIFE_KERNEL_SCALAR;
+    if (kernel_supported(LIFE_KERNEL_AVX2)) kernel = LIFE_KERNEL_AVX2;
+    if (kernel_supported(LIFE_KERNEL_AVX512)) kernel = LIFE_KERNEL_AVX512;
+  }
+  if (!kernel_supported(kernel)) return false;
+
+  switch (kernel) {
+#ifdef LIFE_HAVE_X86_SIMD
+  case LIFE_KERNEL_AVX2: kernel_row_fn = life_row_avx2; break;
+  case LIFE_KERNEL_AVX512: kernel_row_fn = life_row_avx512; break;
+#endif
+  default: kernel_row_fn = life_row_scalar; break;
+  }
+  current_kernel = kernel;
+  select_row_fn();
+  return true;
+}
+
+LifeKernel lifegrid_current_kernel(void) {
+  if (current_row_fn == NULL) lifegrid_use_kernel(LIFE_KERNEL_AUTO);
+  return current_kernel;
+}
+
+void lifegrid_use_rule(LifeRule rule) {
+  current_rule = rule;
+  if (kernel_row_fn == NULL) lifegrid_use_kernel(LIFE_KERNEL_AUTO);
+  else select_row_fn();
+}
+
+LifeRule lifegrid_current_rule(void) {
+  return current_rule;
+}
+
+const char *lifegrid_kernel_name(LifeKernel kernel) {
+  switch (kernel) {
+  case LIFE_KERNEL_AUTO: return "auto";
+  case LIFE_KERNEL_SCALAR: return "scalar";
+  case LIFE_KERNEL_AVX2: return "avx2";
+  case LIFE_KERNEL_AVX512: return "avx512";
+  default: return "unknown";
+  }
+}
+
+bool lifegrid_init(LifeGrid *g, size_t width, size_t height) {
+  assert(width > 0 && height > 0);
+  g->width = width;
+  g->height = height;
+  g->stride = (width + 63) / 64;
+  g->owned = true;
+  g->cells = calloc(g->stride * height, sizeof(uint64_t));
+  g->scratch = malloc(lifegrid_scratch_words(g) * sizeof(uint64_t));
+  if (g->cells == NULL || g->scratch == NULL) {
+    lifegrid_free(g);
+    return false;
+  }
+  return true;
+}
+
+void lifegrid_free(LifeGrid *g) {
+  if (g->owned) {
+    free(g->cells);
+    free(g->scratch);
+  }
+  g->cells = NULL;
+  g->scratch = NULL;
+}
+
+size_t lifegrid_arena_size(size_t width, size_t height) {
+  size_t stride = (width + 63) / 64;
+  return arena_round(stride * height * sizeof(uint64_t)) + arena_round(6 * stride * sizeof(uint64_t));
+}
+
+bool lifegrid_init_arena(LifeGrid *g, size_t width, size_t height, Arena *arena) {
+  assert(width > 0 && height > 0);
+  g->width = width;
+  g->height = height;
+  g->stride = (width + 63) / 64;
+  g->owned = false;
+  g->cells = arena_alloc(arena, g->stride * height * sizeof(uint64_t));
+  g->scratch = arena_alloc(arena, lifegrid_scratch_words(g) * sizeof(uint64_t));
+  if (g->cells == NULL || g->scratch == NULL) return false;
+  lifegrid_clear(g);
+  return true;
+}
+
+void lifegrid_clear(LifeGrid *g) {
+  memset(g->cells, 0, g->stride * g->height * sizeof(uint64_t));
+}
+
+void lifegrid_copy(LifeGrid *dst, const LifeGrid *src) {
+  assert(dst->width == src->width && dst->height == src->height);
+  memcpy(dst->cells, src->cells, src->stride * src->height * sizeof(uint64_t));
+}
+
+bool lifegrid_equal(const LifeGrid *a, const LifeGrid *b) {
+  if (a->width != b->width || a->height != b->height) return false;
+  return memcmp(a->cells, b->cells, a->stride * a->height * sizeof(uint64_t)) == 0;
+}
+
+size_t lifegrid_popcount(const LifeGrid *g) {
+  size_t count = 0;
+  for (size_t i = 0; i < g->stride * g->height; ++i) {
+    count += __builtin_popcountll(g->cells[i]);
+  }
+  return count;
+}
+
+size_t lifegrid_scratch_words(const LifeGrid *g) {
+  return 6 * g->stride;
+}
+
+/* dst[x] = src[x-1], the west neighbour of every cell, wrapping around. */
+static void shift_from_west(uint64_t *dst, const uint64_t *src, size_t width, size_t stride) {
+  size_t last = stride - 1;
+  uint64_t carry = (src[(width - 1) / 64] >> ((width - 1) % 64)) & 1;
+  for (size_t k = 0; k < stride; ++k) {
+    uint64_t word = src[k];
+    dst[k] = (word << 1) | carry;
+    carry = word >> 63;
+  }
+  if (width % 64) dst[last] &= ((uint64_t)1 << (width % 64)) - 1;
+}
+
+/* dst[x] = src[x+1], the east neighbour of every cell, wrapping around. */
+static void shift_from_east(uint64_t *dst, const uint64_t *src, size_t width, size_t stride) {
+  size_t last = stride - 1;
+  for (size_t k = 0; k < last; ++k) {
+    dst[k] = (src[k] >> 1) | (src[k + 1] << 63);
+  }
+  dst[last] = (src[last] >> 1) | ((src[0] & 1) << ((width - 1) % 64));
+}
+
+void lifegrid_step_rows(const LifeGrid *old, LifeGrid *next, size_t y0, size_t y1, uint64_t *scratch) {
+  assert(old->width == next->width && old->height == next->height);
+  assert(y0 <= y1 && y1 <= old->height);
+  if (current_row_fn == NULL) lifegrid_use_kernel(LIFE_KERNEL_AUTO);
+  if (y0 == y1) return;
+
+  size_t w = old->width, h = old->height, stride = old->stride;
+  uint64_t tail = w % 64 ? ((uint64_t)1 << (w % 64)) - 1 : ~(uint64_t)0;
+
+  // Three slots of west/east shifted rows, rotated as we walk down the band
+  uint64_t *west[3], *east[3];
+  for (int i = 0; i < 3; ++i) {
+    west[i] = scratch + (2 * i) * stride;
+    east[i] = scratch + (2 * i + 1) * stride;
+  }
+
+  size_t up = (y0 + h - 1) % h;
+  shift_from_west(west[0], lifegrid_row(old, up), w, stride);
+  shift_from_east(east[0], lifegrid_row(old, up), w, stride);
+  shift_from_west(west[1], lifegrid_row(old, y0), w, stride);
+  shift_from_east(east[1], lifegrid_row(old, y0), w, stride);
+
+  for (size_t y = y0; y < y1; ++y) {
+    size_t down = (y + 1) % h;
+    const uint64_t *row_u = lifegrid_row(old, (y + h - 1) % h);
+    const uint64_t *row_c = lifegrid_row(old, y);
+    const uint64_t *row_d = lifegrid_row(old, down);
+    shift_from_west(west[2], row_d, w, stride);
+    shift_from_east(east[2], row_d, w, stride);
+
+    const uint64_t *nb[COUNT_NB] = {
+      [NB_UW] = west[0], [NB_U] = row_u, [NB_UE] = east[0],
+      [NB_W] = west[1], [NB_C] = row_c, [NB_E] = east[1],
+      [NB_DW] = west[2], [NB_D] = row_d, [NB_DE] = east[2],
+    };
+    current_row_fn(lifegrid_row(next, y), nb, stride);
+    // Rules with B0 bring the padding past width to life
+    lifegrid_row(next, y)[stride - 1] &= tail;
+
+    uint64_t *tw = west[0], *te = east[0];
+    west[0] = west[1]; east[0] = east[1];
+    west[1] = west[2]; east[1] = east[2];
+    west[2] = tw; east[2] = te;
+  }
+}
+
+void lifegrid_step(const LifeGrid *old, LifeGrid *next) {
+  lifegrid_step_rows(old, next, 0, old->height, next->scratch);
+}
+
+bool lifeboard_init(LifeBoard *b, size_t width, size_t height) {
+  b->current = 0;
+  if (!arena_init(&b->arena, 2 * lifegrid_arena_size(width, height))) return false;
+  if (!lifegrid_init_arena(&b->grids[0], width, height, &b->arena) ||
+      !lifegrid_init_arena(&b->grids[1], width, height, &b->arena)) {
+    arena_free(&b->arena);
+    return false;
+  }
+  return true;
+}
+
+bool lifeboard_init_cells(LifeBoard *b, size_t width, size_t height, uint64_t *cells) {
+  LifeGrid *g = &b->grids[0];
+  b->current = 0;
+  g->width = width;
+  g->height = height;
+  g->stride = (width + 63) / 64;
+  g->cells = cells;
+  g->owned = false;
+  size_t scratch = lifegrid_scratch_words(g) * sizeof(uint64_t);
+  if (!arena_init(&b->arena, lifegrid_arena_size(width, height) + arena_round(scratch))) return false;
+  g->scratch = arena_alloc(&b->arena, scratch);
+  if (g->scratch == NULL || !lifegrid_init_arena(&b->grids[1], width, height, &b->arena)) {
+    arena_free(&b->arena);
+    return false;
+  }
+  return true;
+}
+
+void lifeboard_free(LifeBoard *b) {
+  arena_free(&b->arena);
+  b->grids[0].cells = b->grids[1].cells = NULL;
+  b->grids[0].scratch = b->grids[1].scratch = NULL;
+}
+
+void lifeboard_step(LifeBoard *b) {
+  lifegrid_step(lifeboard_current(b), lifeboard_next(b));
+  lifeboard_swap(b);
+}
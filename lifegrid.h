@@ -0,0 +1,131 @@
+#ifndef LIFEGRID_H_
+#define LIFEGRID_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "rule.h"
+
+/* A Game of Life torus packed 64 cells per word. Every row starts on a word
+ * boundary, cell x of row y is bit x%64 of cells[y*stride + x/64] and the
+ * padding bits past width are always kept at zero. */
+typedef struct {
+  size_t width;
+  size_t height;
+  size_t stride;
+  uint64_t *cells;
+  uint64_t *scratch;
+  bool owned; // freed by lifegrid_free, unlike cells in an arena or borrowed
+} LifeGrid;
+
+/* The two generations of a board, allocated together from one arena.
+ * Stepping writes the next grid and then swaps which one is current. */
+typedef struct {
+  Arena arena;
+  LifeGrid grids[2];
+  int current;
+} LifeBoard;
+
+typedef enum {
+  LIFE_KERNEL_AUTO = 0,
+  LIFE_KERNEL_SCALAR,
+  LIFE_KERNEL_AVX2,
+  LIFE_KERNEL_AVX512,
+  COUNT_LIFE_KERNELS,
+} LifeKernel;
+
+static inline uint64_t *lifegrid_row(const LifeGrid *g, size_t y) {
+  return g->cells + y * g->stride;
+}
+
+static inline bool lifegrid_get(const LifeGrid *g, size_t x, size_t y) {
+  return (lifegrid_row(g, y)[x / 64] >> (x % 64)) & 1;
+}
+
+static inline void lifegrid_set(LifeGrid *g, size_t x, size_t y, bool alive) {
+  uint64_t bit = (uint64_t)1 << (x % 64);
+  if (alive) lifegrid_row(g, y)[x / 64] |= bit;
+  else lifegrid_row(g, y)[x / 64] &= ~bit;
+}
+
+/* Add up the eight neighbour bit-planes with a tree of bit-sliced adders.
+ * Only the ones and twos bits of the count are kept, a carry into the fours
+ * means four or more neighbours and the cell dies. B3/S23 is then
+ * twos AND NOT fours AND (ones OR alive). */
+static inline uint64_t lifegrid_word(uint64_t uw, uint64_t u, uint64_t ue,
+                                     uint64_t w, uint64_t c, uint64_t e,
+                                     uint64_t dw, uint64_t d, uint64_t de) {
+  uint64_t t0 = uw ^ u, s0 = t0 ^ ue, c0 = (uw & u) | (t0 & ue);
+  uint64_t t1 = w ^ e, s1 = t1 ^ dw, c1 = (w & e) | (t1 & dw);
+  uint64_t s2 = d ^ de, c2 = d & de;
+  uint64_t t3 = s0 ^ s1, ones = t3 ^ s2, c3 = (s0 & s1) | (t3 & s2);
+  uint64_t t4 = c0 ^ c1, u4 = t4 ^ c2, c4 = (c0 & c1) | (t4 & c2);
+  uint64_t twos = u4 ^ c3, c5 = u4 & c3;
+  return twos & ~(c4 | c5) & (ones | c);
+}
+
+bool lifegrid_init(LifeGrid *g, size_t width, size_t height);
+void lifegrid_free(LifeGrid *g);
+
+/* Bytes of arena taken by a grid of the given size. */
+size_t lifegrid_arena_size(size_t width, size_t height);
+
+/* Like lifegrid_init, with the memory taken from the arena. */
+bool lifegrid_init_arena(LifeGrid *g, size_t width, size_t height, Arena *arena);
+
+void lifegrid_clear(LifeGrid *g);
+void lifegrid_copy(LifeGrid *dst, const LifeGrid *src);
+bool lifegrid_equal(const LifeGrid *a, const LifeGrid *b);
+size_t lifegrid_popcount(const LifeGrid *g);
+
+/* Select the SIMD kernel used by the steppers. LIFE_KERNEL_AUTO picks the
+ * widest one the CPU supports. Returns false if the kernel is not available
+ * on this CPU or in this build, in which case the selection is unchanged. */
+bool lifegrid_use_kernel(LifeKernel kernel);
+LifeKernel lifegrid_current_kernel(void);
+const char *lifegrid_kernel_name(LifeKernel kernel);
+
+/* Select the rule the steppers compute, B3/S23 until set otherwise. B3/S23
+ * runs on the SIMD kernels above, a list of common rules has a kernel of
+ * its own each, generated at build time, and any other rule goes through a
+ * generic kernel that reads the rule once per row. Neither adds a branch or
+ * a lookup per cell. */
+void lifegrid_use_rule(LifeRule rule);
+LifeRule lifegrid_current_rule(void);
+
+/* Number of scratch words lifegrid_step_rows needs for a grid. */
+size_t lifegrid_scratch_words(const LifeGrid *g);
+
+/* Compute rows [y0,y1) of the next generation of old into next,
+ * reading the neighbouring rows with torus wrapping. */
+void lifegrid_step_rows(const LifeGrid *old, LifeGrid *next, size_t y0, size_t y1, uint64_t *scratch);
+
+/* Compute the whole next generation of old into next. */
+void lifegrid_step(const LifeGrid *old, LifeGrid *next);
+
+bool lifeboard_init(LifeBoard *b, size_t width, size_t height);
+
+/* Like lifeboard_init, with the current generation already in cells, such
+ * as the cells of a mapped checkpoint, used in place instead of copied. The
+ * board does not own them and they must outlive it. */
+bool lifeboard_init_cells(LifeBoard *b, size_t width, size_t height, uint64_t *cells);
+void lifeboard_free(LifeBoard *b);
+
+static inline LifeGrid *lifeboard_current(LifeBoard *b) {
+  return &b->grids[b->current];
+}
+
+static inline LifeGrid *lifeboard_next(LifeBoard *b) {
+  return &b->grids[!b->current];
+}
+
+static inline void lifeboard_swap(LifeBoard *b) {
+  b->current = !b->current;
+}
+
+/* Step the board one generation on the calling thread. */
+void lifeboard_step(LifeBoard *b);
+
+#endif // LIFEGRID_H_
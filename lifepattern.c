@@ -0,0 +1,331 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lifepattern.h"
+
+/* A pattern can not be larger than this many cells on a side. */
+#define MAX_SIDE ((size_t)1 << 31)
+
+static bool pattern_alloc(LifePattern *p, size_t width, size_t height, const char *name) {
+  p->width = width;
+  p->height = height;
+  p->stride = (width + 63) / 64;
+  p->cells = calloc(p->stride * height > 0 ? p->stride * height : 1, sizeof(uint64_t));
+  if (p->cells == NULL) {
+    fprintf(stderr, "ERROR: could not allocate the %zux%zu cells of %s\n", width, height, name);
+    return false;
+  }
+  return true;
+}
+
+void lifepattern_free(LifePattern *p) {
+  free(p->cells);
+  p->cells = NULL;
+}
+
+/* Bring the n cells of a row from x on to life, whole words at a time. */
+static void set_run(uint64_t *row, size_t x, size_t n) {
+  while (n > 0) {
+    size_t bit = x % 64, k = 64 - bit < n ? 64 - bit : n;
+    uint64_t mask = k == 64 ? ~(uint64_t)0 : (((uint64_t)1 << k) - 1) << bit;
+    row[x / 64] |= mask;
+    x += k;
+    n -= k;
+  }
+}
+
+static bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/* Skip the rest of the line, the newline included. */
+static const char *next_line(const char *s, const char *end) {
+  const char *nl = memchr(s, '\n', end - s);
+  return nl == NULL ? end : nl + 1;
+}
+
+static const char *skip_blanks(const char *s, const char *end) {
+  while (s < end && (*s == ' ' || *s == '\t')) s++;
+  return s;
+}
+
+/* Parse "key = number" at s, returning what follows or NULL. */
+static const char *header_number(const char *s, const char *end, char key, size_t *value) {
+  s = skip_blanks(s, end);
+  if (s == end || *s != key) return NULL;
+  s = skip_blanks(s + 1, end);
+  if (s == end || *s != '=') return NULL;
+  s = skip_blanks(s + 1, end);
+  if (s == end || *s < '0' || *s > '9') return NULL;
+  *value = 0;
+  for (; s < end && *s >= '0' && *s <= '9'; ++s) {
+    *value = *value * 10 + (*s - '0');
+    if (*value > MAX_SIDE) return NULL;
+  }
+  return s;
+}
+
+/* The header is "x = m, y = n" and optionally ", rule = B3/S23"; the rule
+ * may end in ":..." for a bounded plane, which does not matter here. */
+static const char *parse_rle_header(LifePattern *p, const char *s, const char *end, size_t *width,
+                                    size_t *height) {
+  if ((s = header_number(s, end, 'x', width)) == NULL) return NULL;
+  s = skip_blanks(s, end);
+  if (s == end || *s != ',' || (s = header_number(s + 1, end, 'y', height)) == NULL) return NULL;
+  s = skip_blanks(s, end);
+  if (s < end && *s == ',') {
+    s = skip_blanks(s + 1, end);
+    if (end - s < 4 || strncmp(s, "rule", 4) != 0) return NULL;
+    s = skip_blanks(s + 4, end);
+    if (s == end || *s != '=') return NULL;
+    s = skip_blanks(s + 1, end);
+    char rule[64];
+    size_t n = 0;
+    while (s < end && !is_space(*s) && *s != ':' && n + 1 < sizeof(rule)) rule[n++] = *s++;
+    rule[n] = '\0';
+    if (!liferule_parse(rule, &p->rule)) return NULL;
+    p->has_rule = true;
+  }
+  return next_line(s, end);
+}
+
+static bool parse_rle(LifePattern *p, const char *s, const char *end, const char *name) {
+  size_t width, height;
+  if ((s = parse_rle_header(p, s, end, &width, &height)) == NULL) {
+    fprintf(stderr, "ERROR: %s: invalid RLE header\n", name);
+    return false;
+  }
+  if (!pattern_alloc(p, width, height, name)) return false;
+
+  // Runs are a count, 1 if left out, and a tag: b for dead cells, $ for
+  // the end of a row, ! for the end of the pattern and anything else for
+  // live cells, o in two-state rules
+  size_t x = 0, y = 0, count = 0;
+  for (; s < end && *s != '!'; ++s) {
+    char c = *s;
+    if (c >= '0' && c <= '9') {
+      count = count * 10 + (c - '0');
+      if (count > MAX_SIDE) break;
+      continue;
+    }
+    if (is_space(c)) continue;
+    size_t n = count > 0 ? count : 1;
+    count = 0;
+    if (c == '$') {
+      y += n;
+      x = 0;
+    } else if (c == 'b' || c == '.') {
+      x += n;
+    } else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+      if (y >= height || x > width || n > width - x) {
+        fprintf(stderr, "ERROR: %s: cells outside of its %zux%zu header\n", name, width, height);
+        lifepattern_free(p);
+        return false;
+      }
+      set_run(p->cells + y * p->stride, x, n);
+      x += n;
+    } else {
+      fprintf(stderr, "ERROR: %s: unexpected '%c' in RLE data\n", name, c);
+      lifepattern_free(p);
+      return false;
+    }
+  }
+  if (s == end || count > MAX_SIDE) {
+    fprintf(stderr, "ERROR: %s: RLE data does not end with '!'\n", name);
+    lifepattern_free(p);
+    return false;
+  }
+  return true;
+}
+
+/* The length of a plaintext line without its line ending. */
+static size_t line_length(const char *s, const char *end) {
+  const char *e = memchr(s, '\n', end - s);
+  if (e == NULL) e = end;
+  while (e > s && e[-1] == '\r') e--;
+  return e - s;
+}
+
+/* Lines starting with ! are comments, every other line is a row: . or
+ * space for a dead cell and O or * for a live one. */
+static bool parse_plaintext(LifePattern *p, const char *begin, const char *end, const char *name) {
+  size_t width = 0, height = 0;
+  for (const char *s = begin; s < end; s = next_line(s, end)) {
+    if (*s == '!') continue;
+    size_t n = line_length(s, end);
+    if (n > width) width = n;
+    height++;
+  }
+  if (width > MAX_SIDE || height > MAX_SIDE) {
+    fprintf(stderr, "ERROR: %s is too large a pattern\n", name);
+    return false;
+  }
+  if (!pattern_alloc(p, width, height, name)) return false;
+
+  size_t y = 0;
+  for (const char *s = begin; s < end; s = next_line(s, end)) {
+    if (*s == '!') continue;
+    size_t n = line_length(s, end);
+    uint64_t *row = p->cells + y++ * p->stride;
+    for (size_t x = 0; x < n; x += 64) {
+      uint64_t word = 0;
+      size_t k = n - x < 64 ? n - x : 64;
+      for (size_t i = 0; i < k; ++i) {
+        char c = s[x + i];
+        if (c == 'O' || c == '*') {
+          word |= (uint64_t)1 << i;
+        } else if (c != '.' && c != ' ') {
+          fprintf(stderr, "ERROR: %s: unexpected '%c' in row %zu\n", name, c, y);
+          lifepattern_free(p);
+          return false;
+        }
+      }
+      row[x / 64] = word;
+    }
+  }
+  return true;
+}
+
+bool lifepattern_parse(LifePattern *p, const char *text, size_t size, const char *name) {
+  memset(p, 0, sizeof(*p));
+  const char *s = text, *end = text + size;
+  while (s < end && (*s == '#' || *s == '\n' || *s == '\r')) s = next_line(s, end);
+  const char *h = skip_blanks(s, end);
+  if (h < end && *h == 'x' && (h = skip_blanks(h + 1, end)) < end && *h == '=') {
+    return parse_rle(p, s, end, name);
+  }
+  return parse_plaintext(p, text, end, name);
+}
+
+bool lifepattern_load(LifePattern *p, const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "ERROR: could not open %s: %s\n", path, strerror(errno));
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    fprintf(stderr, "ERROR: %s is empty or unreadable\n", path);
+    close(fd);
+    return false;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "ERROR: could not map %s: %s\n", path, strerror(errno));
+    return false;
+  }
+#ifdef POSIX_MADV_SEQUENTIAL
+  posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+#endif
+  bool ok = lifepattern_parse(p, map, st.st_size, path);
+  munmap(map, st.st_size);
+  return ok;
+}
+
+bool lifepattern_parse_orientation(const char *name, int *orientation) {
+  static const struct {
+    const char *name;
+    int orientation;
+  } names[] = {
+    {"none", 0},
+    {"rot90", LIFE_ORIENT_TRANSPOSE | LIFE_ORIENT_FLIP_X},
+    {"rot180", LIFE_ORIENT_FLIP_X | LIFE_ORIENT_FLIP_Y},
+    {"rot270", LIFE_ORIENT_TRANSPOSE | LIFE_ORIENT_FLIP_Y},
+    {"flipx", LIFE_ORIENT_FLIP_X},
+    {"flipy", LIFE_ORIENT_FLIP_Y},
+    {"transpose", LIFE_ORIENT_TRANSPOSE},
+    {"antitranspose", LIFE_ORIENT_TRANSPOSE | LIFE_ORIENT_FLIP_X | LIFE_ORIENT_FLIP_Y},
+  };
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+    if (strcmp(name, names[i].name) == 0) {
+      *orientation = names[i].orientation;
+      return true;
+    }
+  }
+  fprintf(stderr, "ERROR: unknown orientation '%s', expected none, rot90, rot180, rot270, flipx, flipy, transpose"
+                  " or antitranspose\n", name);
+  return false;
+}
+
+/* A copy of the pattern turned and flipped, made by visiting only its live
+ * cells. */
+static bool reorient(const LifePattern *src, int orientation, LifePattern *dst) {
+  bool t = orientation & LIFE_ORIENT_TRANSPOSE;
+  memset(dst, 0, sizeof(*dst));
+  if (!pattern_alloc(dst, t ? src->height : src->width, t ? src->width : src->height, "the reoriented pattern")) {
+    return false;
+  }
+  for (size_t y = 0; y < src->height; ++y) {
+    const uint64_t *row = src->cells + y * src->stride;
+    for (size_t w = 0; w < src->stride; ++w) {
+      for (uint64_t bits = row[w]; bits != 0; bits &= bits - 1) {
+        size_t x = w * 64 + __builtin_ctzll(bits);
+        size_t nx = t ? y : x, ny = t ? x : y;
+        if (orientation & LIFE_ORIENT_FLIP_X) nx = dst->width - 1 - nx;
+        if (orientation & LIFE_ORIENT_FLIP_Y) ny = dst->height - 1 - ny;
+        dst->cells[ny * dst->stride + nx / 64] |= (uint64_t)1 << (nx % 64);
+      }
+    }
+  }
+  return true;
+}
+
+/* The k <= 64 bits of row from bit x on. */
+static uint64_t get_bits(const uint64_t *row, size_t x, size_t k) {
+  size_t bit = x % 64;
+  uint64_t v = row[x / 64] >> bit;
+  if (bit + k > 64) v |= row[x / 64 + 1] << (64 - bit);
+  return k == 64 ? v : v & (((uint64_t)1 << k) - 1);
+}
+
+/* OR k <= 64 bits into row from bit x on. */
+static void or_bits(uint64_t *row, size_t x, uint64_t v, size_t k) {
+  size_t bit = x % 64;
+  row[x / 64] |= v << bit;
+  if (bit + k > 64) row[x / 64 + 1] |= v >> (64 - bit);
+}
+
+static size_t wrap(int64_t v, size_t n) {
+  int64_t r = v % (int64_t)n;
+  return r < 0 ? (size_t)(r + (int64_t)n) : (size_t)r;
+}
+
+bool lifepattern_place(const LifePattern *p, LifeGrid *grid, int64_t x, int64_t y, int orientation) {
+  // Flipping the rows needs no copy, everything else does
+  LifePattern turned;
+  bool flip_y = orientation == LIFE_ORIENT_FLIP_Y;
+  if (orientation != 0 && !flip_y) {
+    if (!reorient(p, orientation, &turned)) return false;
+    p = &turned;
+  }
+
+  // Every row goes over in pieces of up to 64 cells that neither cross the
+  // right edge of the torus nor are longer than a word
+  size_t x0 = wrap(x, grid->width);
+  for (size_t r = 0; r < p->height; ++r) {
+    const uint64_t *src = p->cells + (flip_y ? p->height - 1 - r : r) * p->stride;
+    uint64_t *dst = lifegrid_row(grid, wrap(y + (int64_t)r, grid->height));
+    size_t d = x0;
+    for (size_t s = 0; s < p->width;) {
+      size_t k = p->width - s;
+      if (k > grid->width - d) k = grid->width - d;
+      if (k > 64) k = 64;
+      uint64_t bits = get_bits(src, s, k);
+      if (bits != 0) or_bits(dst, d, bits, k);
+      s += k;
+      d += k;
+      if (d == grid->width) d = 0;
+    }
+  }
+
+  if (p == &turned) lifepattern_free(&turned);
+  return true;
+}
@@ -0,0 +1,55 @@
+#ifndef LIFEPATTERN_H_
+#define LIFEPATTERN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lifegrid.h"
+#include "rule.h"
+
+/* A Life pattern read from the RLE or plaintext (.cells) format, its cells
+ * packed like the rows of a LifeGrid: cell x of row y is bit x%64 of
+ * cells[y*stride + x/64]. RLE runs are written a word at a time, plaintext
+ * rows are gathered in words before they are stored, so no cell costs a
+ * call of its own. */
+typedef struct {
+  size_t width;
+  size_t height;
+  size_t stride;
+  uint64_t *cells;
+  bool has_rule; // the RLE header named one
+  LifeRule rule;
+} LifePattern;
+
+/* The 8 ways to lay a pattern on the board. The transpose, if any, comes
+ * first, then the flips, so LIFE_ORIENT_TRANSPOSE | LIFE_ORIENT_FLIP_X
+ * turns the pattern a quarter clockwise. */
+enum {
+  LIFE_ORIENT_TRANSPOSE = 1,
+  LIFE_ORIENT_FLIP_X = 2,
+  LIFE_ORIENT_FLIP_Y = 4,
+};
+
+/* Parse size bytes of text, RLE if the first line that is not a comment is
+ * an "x = ..." header and plaintext otherwise. name is for the messages.
+ * Prints the reason and returns false on failure. */
+bool lifepattern_parse(LifePattern *p, const char *text, size_t size, const char *name);
+
+/* Parse a pattern file, mapped into memory instead of read. */
+bool lifepattern_load(LifePattern *p, const char *path);
+
+void lifepattern_free(LifePattern *p);
+
+/* Parse an orientation: none, rot90, rot180, rot270 (clockwise), flipx,
+ * flipy, transpose or antitranspose. */
+bool lifepattern_parse_orientation(const char *name, int *orientation);
+
+/* Bring the live cells of the pattern, laid out the way orientation says,
+ * to life on the grid with the top left corner of the result at x,y. The
+ * pattern wraps around the torus like everything else; cells it has dead
+ * are left alone. Returns false if the reoriented pattern could not be
+ * allocated. */
+bool lifepattern_place(const LifePattern *p, LifeGrid *grid, int64_t x, int64_t y, int orientation);
+
+#endif // LIFEPATTERN_H_
@@ -0,0 +1,312 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lifeplane.h"
+
+#define CHUNKS_PER_SLAB 64
+
+/* Cell x,y of a chunk is bit x of rows[buffer][y]. The two buffers hold the
+ * current and the next generation, the plane tells which one is current. */
+typedef struct Chunk {
+  int64_t cx, cy;
+  size_t index;
+  struct Chunk *next_free;
+  uint64_t rows[2][LIFECHUNK_SIZE];
+} Chunk;
+
+typedef struct Slab {
+  struct Slab *next;
+  Chunk chunks[CHUNKS_PER_SLAB];
+} Slab;
+
+struct LifePlane {
+  int current;
+
+  // Every chunk in use, for iteration
+  Chunk **chunks;
+  size_t count;
+  size_t capacity;
+
+  // Open addressing with linear probing, NULL marks an empty slot
+  Chunk **table;
+  size_t table_mask;
+
+  Slab *slabs;
+  size_t slab_count;
+  Chunk *free_chunks;
+
+  uint64_t generation;
+  uint64_t population;
+};
+
+static const uint64_t zero_rows[LIFECHUNK_SIZE];
+
+static int64_t floor_div(int64_t v) {
+  return v >= 0 ? v / LIFECHUNK_SIZE : -((-v + LIFECHUNK_SIZE - 1) / LIFECHUNK_SIZE);
+}
+
+static size_t chunk_hash(int64_t cx, int64_t cy) {
+  uint64_t h = (uint64_t)cx * 0x9E3779B97F4A7C15ULL ^ (uint64_t)cy;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return (size_t)h;
+}
+
+static Chunk *find_chunk(const LifePlane *p, int64_t cx, int64_t cy) {
+  for (size_t i = chunk_hash(cx, cy) & p->table_mask; p->table[i] != NULL; i = (i + 1) & p->table_mask) {
+    if (p->table[i]->cx == cx && p->table[i]->cy == cy) return p->table[i];
+  }
+  return NULL;
+}
+
+static void table_put(Chunk **table, size_t mask, Chunk *c) {
+  size_t i = chunk_hash(c->cx, c->cy) & mask;
+  while (table[i] != NULL) i = (i + 1) & mask;
+  table[i] = c;
+}
+
+static void table_grow(LifePlane *p) {
+  size_t size = 2 * (p->table_mask + 1);
+  Chunk **table = calloc(size, sizeof(Chunk *));
+  if (table == NULL) abort();
+  for (size_t i = 0; i < p->count; ++i) table_put(table, size - 1, p->chunks[i]);
+  free(p->table);
+  p->table = table;
+  p->table_mask = size - 1;
+}
+
+/* Backward shift deletion, so the probe sequences stay intact without tombstones. */
+static void table_remove(LifePlane *p, const Chunk *c) {
+  size_t mask = p->table_mask;
+  size_t i = chunk_hash(c->cx, c->cy) & mask;
+  while (p->table[i] != c) i = (i + 1) & mask;
+  p->table[i] = NULL;
+  for (size_t j = (i + 1) & mask; p->table[j] != NULL; j = (j + 1) & mask) {
+    size_t home = chunk_hash(p->table[j]->cx, p->table[j]->cy) & mask;
+    bool stays = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+    if (!stays) {
+      p->table[i] = p->table[j];
+      p->table[j] = NULL;
+      i = j;
+    }
+  }
+}
+
+static Chunk *alloc_chunk(LifePlane *p) {
+  if (p->free_chunks == NULL) {
+    Slab *slab = malloc(sizeof(Slab));
+    if (slab == NULL) abort();
+    slab->next = p->slabs;
+    p->slabs = slab;
+    p->slab_count++;
+    for (size_t i = 0; i < CHUNKS_PER_SLAB; ++i) {
+      slab->chunks[i].next_free = p->free_chunks;
+      p->free_chunks = &slab->chunks[i];
+    }
+  }
+  Chunk *c = p->free_chunks;
+  p->free_chunks = c->next_free;
+  return c;
+}
+
+static Chunk *get_chunk(LifePlane *p, int64_t cx, int64_t cy) {
+  Chunk *c = find_chunk(p, cx, cy);
+  if (c != NULL) return c;
+
+  if ((p->count + 1) * 2 > p->table_mask + 1) table_grow(p);
+  if (p->count == p->capacity) {
+    p->capacity = p->capacity ? 2 * p->capacity : 64;
+    p->chunks = realloc(p->chunks, p->capacity * sizeof(Chunk *));
+    if (p->chunks == NULL) abort();
+  }
+  c = alloc_chunk(p);
+  c->cx = cx;
+  c->cy = cy;
+  c->index = p->count;
+  memset(c->rows, 0, sizeof(c->rows));
+  p->chunks[p->count++] = c;
+  table_put(p->table, p->table_mask, c);
+  return c;
+}
+
+static void free_chunk(LifePlane *p, Chunk *c) {
+  table_remove(p, c);
+  Chunk *last = p->chunks[--p->count];
+  p->chunks[c->index] = last;
+  last->index = c->index;
+  c->next_free = p->free_chunks;
+  p->free_chunks = c;
+}
+
+LifePlane *lifeplane_new(void) {
+  LifePlane *p = calloc(1, sizeof(*p));
+  if (p == NULL) return NULL;
+  p->table = calloc(64, sizeof(Chunk *));
+  if (p->table == NULL) {
+    free(p);
+    return NULL;
+  }
+  p->table_mask = 64 - 1;
+  return p;
+}
+
+void lifeplane_free(LifePlane *p) {
+  if (p == NULL) return;
+  while (p->slabs != NULL) {
+    Slab *next = p->slabs->next;
+    free(p->slabs);
+    p->slabs = next;
+  }
+  free(p->chunks);
+  free(p->table);
+  free(p);
+}
+
+void lifeplane_set(LifePlane *p, int64_t x, int64_t y, bool alive) {
+  int64_t cx = floor_div(x), cy = floor_div(y);
+  Chunk *c = alive ? get_chunk(p, cx, cy) : find_chunk(p, cx, cy);
+  if (c == NULL) return;
+  uint64_t *row = &c->rows[p->current][y - cy * LIFECHUNK_SIZE];
+  uint64_t bit = (uint64_t)1 << (x - cx * LIFECHUNK_SIZE);
+  if (alive && !(*row & bit)) p->population++;
+  if (!alive && (*row & bit)) p->population--;
+  if (alive) *row |= bit;
+  else *row &= ~bit;
+}
+
+bool lifeplane_get(const LifePlane *p, int64_t x, int64_t y) {
+  int64_t cx = floor_div(x), cy = floor_div(y);
+  const Chunk *c = find_chunk(p, cx, cy);
+  if (c == NULL) return false;
+  return (c->rows[p->current][y - cy * LIFECHUNK_SIZE] >> (x - cx * LIFECHUNK_SIZE)) & 1;
+}
+
+void lifeplane_load(LifePlane *p, const LifeGrid *grid, int64_t x, int64_t y) {
+  for (size_t gy = 0; gy < grid->height; ++gy) {
+    const uint64_t *row = lifegrid_row(grid, gy);
+    for (size_t k = 0; k < grid->stride; ++k) {
+      for (uint64_t word = row[k]; word != 0; word &= word - 1) {
+        size_t gx = k * 64 + __builtin_ctzll(word);
+        lifeplane_set(p, x + (int64_t)gx, y + (int64_t)gy, true);
+      }
+    }
+  }
+}
+
+void lifeplane_read(const LifePlane *p, int64_t x, int64_t y, LifeGrid *out) {
+  lifegrid_clear(out);
+  int64_t x1 = x + (int64_t)out->width, y1 = y + (int64_t)out->height;
+  for (size_t i = 0; i < p->count; ++i) {
+    const Chunk *c = p->chunks[i];
+    int64_t ox = c->cx * LIFECHUNK_SIZE, oy = c->cy * LIFECHUNK_SIZE;
+    if (ox >= x1 || oy >= y1 || ox + LIFECHUNK_SIZE <= x || oy + LIFECHUNK_SIZE <= y) continue;
+    for (int r = 0; r < LIFECHUNK_SIZE; ++r) {
+      int64_t gy = oy + r;
+      if (gy < y || gy >= y1) continue;
+      for (uint64_t word = c->rows[p->current][r]; word != 0; word &= word - 1) {
+        int64_t gx = ox + __builtin_ctzll(word);
+        if (gx >= x && gx < x1) lifegrid_set(out, (size_t)(gx - x), (size_t)(gy - y), true);
+      }
+    }
+  }
+}
+
+static const uint64_t *chunk_rows(const LifePlane *p, int64_t cx, int64_t cy) {
+  const Chunk *c = find_chunk(p, cx, cy);
+  return c ? c->rows[p->current] : zero_rows;
+}
+
+/* Step one chunk into its next buffer. Rows -1 and 64 come from the chunks
+ * above and below, the bits that cross the west and east edges from the
+ * chunks on the sides, missing chunks being dead. */
+static void step_chunk(LifePlane *p, Chunk *c) {
+  enum { N = LIFECHUNK_SIZE };
+  int64_t cx = c->cx, cy = c->cy;
+  const uint64_t *own = c->rows[p->current];
+  const uint64_t *n = chunk_rows(p, cx, cy - 1), *s = chunk_rows(p, cx, cy + 1);
+  const uint64_t *w = chunk_rows(p, cx - 1, cy), *e = chunk_rows(p, cx + 1, cy);
+  const uint64_t *nw = chunk_rows(p, cx - 1, cy - 1), *ne = chunk_rows(p, cx + 1, cy - 1);
+  const uint64_t *sw = chunk_rows(p, cx - 1, cy + 1), *se = chunk_rows(p, cx + 1, cy + 1);
+
+  uint64_t cw[N + 2], cc[N + 2], ce[N + 2];
+  for (int y = -1; y <= N; ++y) {
+    uint64_t left, mid, right;
+    if (y < 0) {
+      left = nw[N - 1]; mid = n[N - 1]; right = ne[N - 1];
+    } else if (y == N) {
+      left = sw[0]; mid = s[0]; right = se[0];
+    } else {
+      left = w[y]; mid = own[y]; right = e[y];
+    }
+    cw[y + 1] = (mid << 1) | (left >> 63);
+    cc[y + 1] = mid;
+    ce[y + 1] = (mid >> 1) | (right << 63);
+  }
+
+  uint64_t *next = c->rows[!p->current];
+  for (int y = 0; y < N; ++y) {
+    next[y] = lifegrid_word(cw[y], cc[y], ce[y], cw[y + 1], cc[y + 1], ce[y + 1],
+                            cw[y + 2], cc[y + 2], ce[y + 2]);
+  }
+}
+
+void lifeplane_step(LifePlane *p) {
+  enum { N = LIFECHUNK_SIZE };
+
+  // Births reach one cell past a chunk, so give every live edge a neighbour to grow into
+  size_t count = p->count;
+  for (size_t i = 0; i < count; ++i) {
+    Chunk *c = p->chunks[i];
+    const uint64_t *r = c->rows[p->current];
+    uint64_t west = 0, east = 0;
+    for (int y = 0; y < N; ++y) {
+      west |= r[y] & 1;
+      east |= r[y] >> 63;
+    }
+    int64_t cx = c->cx, cy = c->cy;
+    if (r[0]) get_chunk(p, cx, cy - 1);
+    if (r[N - 1]) get_chunk(p, cx, cy + 1);
+    if (west) get_chunk(p, cx - 1, cy);
+    if (east) get_chunk(p, cx + 1, cy);
+    if (r[0] & 1) get_chunk(p, cx - 1, cy - 1);
+    if (r[0] >> 63) get_chunk(p, cx + 1, cy - 1);
+    if (r[N - 1] & 1) get_chunk(p, cx - 1, cy + 1);
+    if (r[N - 1] >> 63) get_chunk(p, cx + 1, cy + 1);
+  }
+
+  for (size_t i = 0; i < p->count; ++i) step_chunk(p, p->chunks[i]);
+
+  // Give the chunks that died back to the pool, walking backwards so the
+  // swap with the last chunk only ever moves a chunk already looked at
+  uint64_t population = 0;
+  for (size_t i = p->count; i-- > 0;) {
+    Chunk *c = p->chunks[i];
+    uint64_t alive = 0;
+    for (int y = 0; y < N; ++y) alive += __builtin_popcountll(c->rows[!p->current][y]);
+    if (alive == 0) free_chunk(p, c);
+    population += alive;
+  }
+
+  p->population = population;
+  p->current = !p->current;
+  p->generation++;
+}
+
+uint64_t lifeplane_generation(const LifePlane *p) {
+  return p->generation;
+}
+
+uint64_t lifeplane_population(const LifePlane *p) {
+  return p->population;
+}
+
+size_t lifeplane_chunk_count(const LifePlane *p) {
+  return p->count;
+}
+
+size_t lifeplane_memory(const LifePlane *p) {
+  return p->slab_count * sizeof(Slab) + (p->table_mask + 1) * sizeof(Chunk *) +
+         p->capacity * sizeof(Chunk *);
+}
@@ -0,0 +1,40 @@
+#ifndef LIFEPLANE_H_
+#define LIFEPLANE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lifegrid.h"
+
+#define LIFECHUNK_SIZE 64
+
+/* Life on the unbounded plane. Live regions are stored as 64x64 chunks in a
+ * hash map keyed by chunk coordinates; chunks come from a pool, are created
+ * next to live edges where births can happen and go back to the pool as soon
+ * as they are empty, so memory follows the live area of the pattern rather
+ * than its bounding box. */
+typedef struct LifePlane LifePlane;
+
+LifePlane *lifeplane_new(void);
+void lifeplane_free(LifePlane *plane);
+
+void lifeplane_set(LifePlane *plane, int64_t x, int64_t y, bool alive);
+bool lifeplane_get(const LifePlane *plane, int64_t x, int64_t y);
+
+/* Set every live cell of grid at the offset x,y of the plane. */
+void lifeplane_load(LifePlane *plane, const LifeGrid *grid, int64_t x, int64_t y);
+
+/* Copy the region of the plane starting at x,y with the size of out into out. */
+void lifeplane_read(const LifePlane *plane, int64_t x, int64_t y, LifeGrid *out);
+
+void lifeplane_step(LifePlane *plane);
+
+uint64_t lifeplane_generation(const LifePlane *plane);
+uint64_t lifeplane_population(const LifePlane *plane);
+size_t lifeplane_chunk_count(const LifePlane *plane);
+
+/* Bytes held by the chunk pool and the hash map. */
+size_t lifeplane_memory(const LifePlane *plane);
+
+#endif // LIFEPLANE_H_
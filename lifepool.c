@@ -0,0 +1,178 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "lifepool.h"
+
+/* pthread_barrier_t is optional in POSIX and missing on macOS. */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  size_t count;
+  size_t waiting;
+  uint64_t phase;
+} Barrier;
+
+typedef struct {
+  LifePool *pool;
+  pthread_t thread;
+  size_t y0, y1;
+  uint64_t *scratch;
+} Worker;
+
+struct LifePool {
+  LifeBoard *board;
+
+  size_t threads;
+  size_t started;
+  Worker *workers;
+  Barrier barrier;
+
+  pthread_mutex_t lock;
+  pthread_cond_t job_posted;
+  uint64_t job;
+  size_t generations;
+  bool quit;
+};
+
+static void barrier_init(Barrier *b, size_t count) {
+  pthread_mutex_init(&b->lock, NULL);
+  pthread_cond_init(&b->cond, NULL);
+  b->count = count;
+  b->waiting = 0;
+  b->phase = 0;
+}
+
+static void barrier_destroy(Barrier *b) {
+  pthread_mutex_destroy(&b->lock);
+  pthread_cond_destroy(&b->cond);
+}
+
+static void barrier_wait(Barrier *b) {
+  pthread_mutex_lock(&b->lock);
+  uint64_t phase = b->phase;
+  if (++b->waiting == b->count) {
+    b->waiting = 0;
+    b->phase++;
+    pthread_cond_broadcast(&b->cond);
+  } else {
+    while (phase == b->phase) pthread_cond_wait(&b->cond, &b->lock);
+  }
+  pthread_mutex_unlock(&b->lock);
+}
+
+/* Step the band of a worker n times. Every worker swaps its view of the two
+ * grids in lockstep, so no shared state changes inside the loop. */
+static void run_band(Worker *w, int current, size_t n) {
+  LifePool *pool = w->pool;
+  for (size_t g = 0; g < n; ++g) {
+    LifeGrid *grids = pool->board->grids;
+    lifegrid_step_rows(&grids[current], &grids[!current], w->y0, w->y1, w->scratch);
+    current = !current;
+    if (pool->threads > 1) barrier_wait(&pool->barrier);
+  }
+}
+
+static void *worker_main(void *arg) {
+  Worker *w = arg;
+  LifePool *pool = w->pool;
+  uint64_t seen = 0;
+  for (;;) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->job == seen && !pool->quit) pthread_cond_wait(&pool->job_posted, &pool->lock);
+    if (pool->quit) {
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    seen = pool->job;
+    int current = pool->board->current;
+    size_t n = pool->generations;
+    pthread_mutex_unlock(&pool->lock);
+
+    run_band(w, current, n);
+  }
+}
+
+LifePool *lifepool_new(LifeBoard *board, size_t threads) {
+  const LifeGrid *a = lifeboard_current(board);
+  if (threads == 0) threads = 1;
+  if (threads > a->height) threads = a->height;
+
+  LifePool *pool = calloc(1, sizeof(*pool));
+  if (pool == NULL) return NULL;
+  pool->workers = calloc(threads, sizeof(Worker));
+  if (pool->workers == NULL) {
+    free(pool);
+    return NULL;
+  }
+  // Pick the SIMD kernel before any worker can race on the lazy selection
+  lifegrid_current_kernel();
+  pool->board = board;
+  pool->threads = threads;
+  barrier_init(&pool->barrier, threads);
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->job_posted, NULL);
+
+  // Bands differ by at most one row
+  size_t y = 0;
+  for (size_t i = 0; i < threads; ++i) {
+    Worker *w = &pool->workers[i];
+    size_t rows = a->height / threads + (i < a->height % threads);
+    w->pool = pool;
+    w->y0 = y;
+    w->y1 = y + rows;
+    y += rows;
+    w->scratch = malloc(lifegrid_scratch_words(a) * sizeof(uint64_t));
+    if (w->scratch == NULL) {
+      lifepool_free(pool);
+      return NULL;
+    }
+  }
+
+  // Worker 0 is the calling thread
+  pool->started = 1;
+  for (size_t i = 1; i < threads; ++i) {
+    if (pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i]) != 0) {
+      lifepool_free(pool);
+      return NULL;
+    }
+    pool->started++;
+  }
+  return pool;
+}
+
+void lifepool_free(LifePool *pool) {
+  if (pool == NULL) return;
+  pthread_mutex_lock(&pool->lock);
+  pool->quit = true;
+  pthread_cond_broadcast(&pool->job_posted);
+  pthread_mutex_unlock(&pool->lock);
+  for (size_t i = 1; i < pool->started; ++i) pthread_join(pool->workers[i].thread, NULL);
+  for (size_t i = 0; i < pool->threads; ++i) free(pool->workers[i].scratch);
+
+  barrier_destroy(&pool->barrier);
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->job_posted);
+  free(pool->workers);
+  free(pool);
+}
+
+void lifepool_step(LifePool *pool, size_t n) {
+  if (n == 0) return;
+  if (pool->threads > 1) {
+    pthread_mutex_lock(&pool->lock);
+    pool->generations = n;
+    pool->job++;
+    pthread_cond_broadcast(&pool->job_posted);
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  // The barrier after the last generation means every band is done
+  run_band(&pool->workers[0], pool->board->current, n);
+  pool->board->current = (pool->board->current + n) % 2;
+}
+
+size_t lifepool_threads(const LifePool *pool) {
+  return pool->threads;
+}
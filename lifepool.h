@@ -0,0 +1,26 @@
+#ifndef LIFEPOOL_H_
+#define LIFEPOOL_H_
+
+#include <stddef.h>
+
+#include "lifegrid.h"
+
+/* A persistent pool of threads stepping a LifeBoard in parallel. The grid is
+ * split in horizontal bands, one per thread, and the calling thread works on
+ * the first band itself. After every generation the threads meet at a
+ * barrier, so the ghost rows each band reads from its neighbours in the old
+ * generation are complete before anyone moves on. */
+typedef struct LifePool LifePool;
+
+/* Create a pool of threads workers (the caller included) stepping the
+ * board. Returns NULL if the threads could not be started. */
+LifePool *lifepool_new(LifeBoard *board, size_t threads);
+void lifepool_free(LifePool *pool);
+
+/* Advance the board by n generations, the result is bit for bit the same
+ * as calling lifeboard_step n times. */
+void lifepool_step(LifePool *pool, size_t n);
+
+size_t lifepool_threads(const LifePool *pool);
+
+#endif // LIFEPOOL_H_
@@ -0,0 +1,385 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lifeshards.h"
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CACHE_LINE 64
+
+/* The futex words of one worker, on a cache line of their own so that
+ * posting to one neighbour does not disturb the others. Counters are kept
+ * mod 2^32, the size of a futex. */
+typedef struct {
+  uint32_t ready; // the strip is pinned and touched
+  uint32_t halo;  // generations whose edge rows are in the mailbox
+  uint32_t done;  // generations computed, posted at the end of every job
+  char pad[CACHE_LINE - 3 * sizeof(uint32_t)];
+} Slot;
+
+typedef struct {
+  uint32_t command; // bumped for every job
+  uint32_t quit;
+  uint64_t target;  // the generation the job runs to
+  char pad[CACHE_LINE - 2 * sizeof(uint32_t) - sizeof(uint64_t)];
+  Slot slots[];
+} Control;
+
+/* Rows [y0, y0+rows) of the board. The shared memory of a strip starts
+ * with its mailbox, the first and the last row posted for each parity of
+ * the generation, followed by two grids of rows+2 rows: the strip between
+ * a ghost row for the row above it and one for the row below. */
+typedef struct {
+  size_t y0;
+  size_t rows;
+  uint64_t *mailbox; // [parity][first, last][stride]
+  LifeGrid grids[2];
+  void *map;
+  size_t bytes;
+} Strip;
+
+struct LifeShards {
+  size_t procs;
+  size_t stride;
+  Control *control;
+  size_t control_bytes;
+  Strip *strips;
+  pid_t *pids;
+  size_t started;
+  bool broken; // a worker died, the others may be stuck waiting for its rows
+  uint64_t generation;
+};
+
+static void futex_wait(uint32_t *word, uint32_t value, const struct timespec *timeout) {
+  syscall(SYS_futex, word, FUTEX_WAIT, value, timeout, NULL, 0);
+}
+
+static void futex_wake(uint32_t *word) {
+  syscall(SYS_futex, word, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+
+static uint32_t load(uint32_t *word) {
+  return __atomic_load_n(word, __ATOMIC_ACQUIRE);
+}
+
+static void post(uint32_t *word, uint32_t value) {
+  __atomic_store_n(word, value, __ATOMIC_RELEASE);
+  futex_wake(word);
+}
+
+/* Block until the counter reaches want. */
+static void wait_for(uint32_t *word, uint32_t want) {
+  uint32_t v;
+  while ((int32_t)((v = load(word)) - want) < 0) futex_wait(word, v, NULL);
+}
+
+/* Map a fresh POSIX shared memory object of the given size. Its name goes
+ * away right after: the mapping lives on in the workers forked later, and
+ * nothing is left in /dev/shm whatever happens to them. */
+static void *shared_map(size_t bytes, size_t index) {
+  char name[64];
+  snprintf(name, sizeof(name), "/game_of_life.%ld.%zu", (long)getpid(), index);
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) return NULL;
+  shm_unlink(name);
+  void *map = NULL;
+  if (ftruncate(fd, (off_t)bytes) == 0) {
+    map = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) map = NULL;
+  }
+  close(fd);
+  return map;
+}
+
+static int numa_nodes(void) {
+  int nodes = 0;
+  char path[64];
+  for (;; ++nodes) {
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", nodes);
+    if (access(path, F_OK) != 0) return nodes;
+  }
+}
+
+/* Pin the calling process to the CPUs of a NUMA node, listed by sysfs as
+ * ranges like "0-7,16-23". Where there is no such list it stays put. */
+static void pin_to_node(int node) {
+  char path[64];
+  snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+  FILE *f = fopen(path, "r");
+  if (f == NULL) return;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  int first, last, c;
+  while (fscanf(f, "%d", &first) == 1) {
+    last = first;
+    if ((c = fgetc(f)) == '-') {
+      if (fscanf(f, "%d", &last) != 1) break;
+      c = fgetc(f);
+    }
+    for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu) CPU_SET(cpu, &set);
+    if (c != ',') break;
+  }
+  fclose(f);
+  if (CPU_COUNT(&set) > 0) sched_setaffinity(0, sizeof(set), &set);
+}
+
+/* One generation of strip i: post its edge rows, fetch the rows of the
+ * strips above and below into the ghost rows and step the strip. The
+ * mailbox of a parity is only reused two generations later, by which time
+ * both neighbours have read it, since they posted the generation in between
+ * after reading this one. */
+static void step_strip(LifeShards *s, size_t i, uint64_t generation, uint64_t *scratch) {
+  size_t up = (i + s->procs - 1) % s->procs, down = (i + 1) % s->procs;
+  Strip *strip = &s->strips[i], *above = &s->strips[up], *below = &s->strips[down];
+  Slot *slots = s->control->slots;
+  size_t stride = s->stride, row_bytes = stride * sizeof(uint64_t);
+  int parity = generation % 2;
+  LifeGrid *cur = &strip->grids[parity], *next = &strip->grids[!parity];
+
+  uint64_t *box = strip->mailbox + 2 * parity * stride;
+  memcpy(box, lifegrid_row(cur, 1), row_bytes);
+  memcpy(box + stride, lifegrid_row(cur, strip->rows), row_bytes);
+  post(&slots[i].halo, (uint32_t)(generation + 1));
+
+  wait_for(&slots[up].halo, (uint32_t)(generation + 1));
+  memcpy(lifegrid_row(cur, 0), above->mailbox + (2 * parity + 1) * stride, row_bytes);
+  wait_for(&slots[down].halo, (uint32_t)(generation + 1));
+  memcpy(lifegrid_row(cur, strip->rows + 1), below->mailbox + 2 * parity * stride, row_bytes);
+
+  lifegrid_step_rows(cur, next, 1, strip->rows + 1, scratch);
+}
+
+static void worker_main(LifeShards *s, size_t i) {
+  Control *control = s->control;
+  Strip *strip = &s->strips[i];
+  // Go down with the coordinator, whatever it dies of
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+  // The first touch places the pages of the strip on the node it runs on
+  int nodes = numa_nodes();
+  if (nodes > 1) pin_to_node((int)(i % (size_t)nodes));
+  memset(strip->map, 0, strip->bytes);
+  uint64_t *scratch = malloc(lifegrid_scratch_words(&strip->grids[0]) * sizeof(uint64_t));
+  if (scratch == NULL) _exit(1);
+  post(&control->slots[i].ready, 1);
+
+  uint64_t generation = 0;
+  uint32_t seen = 0;
+  for (;;) {
+    uint32_t command;
+    while ((command = load(&control->command)) == seen) futex_wait(&control->command, command, NULL);
+    seen = command;
+    if (load(&control->quit)) _exit(0);
+    for (uint64_t target = control->target; generation < target; ++generation) {
+      step_strip(s, i, generation, scratch);
+    }
+    post(&control->slots[i].done, (uint32_t)generation);
+  }
+}
+
+/* A worker found dead is reaped here and its pid cleared, so that it is
+ * neither killed nor waited for again. */
+static bool workers_alive(LifeShards *s) {
+  for (size_t i = 0; i < s->started; ++i) {
+    if (s->pids[i] > 0 && waitpid(s->pids[i], NULL, WNOHANG) != 0) {
+      s->pids[i] = 0;
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Wait for the given counter of every worker to reach want, checking now
+ * and then that none of them died on the way. */
+static bool wait_workers(LifeShards *s, size_t offset, uint32_t want) {
+  struct timespec timeout = {0, 100 * 1000 * 1000};
+  for (size_t i = 0; i < s->procs; ++i) {
+    uint32_t *word = (uint32_t *)((char *)&s->control->slots[i] + offset);
+    uint32_t v;
+    while ((v = load(word)) != want) {
+      futex_wait(word, v, &timeout);
+      if (!workers_alive(s)) return false;
+    }
+  }
+  return true;
+}
+
+LifeShards *lifeshards_new(const LifeGrid *initial, size_t procs) {
+  if (procs == 0) procs = 1;
+  if (procs > initial->height) procs = initial->height;
+
+  LifeShards *s = calloc(1, sizeof(*s));
+  if (s == NULL) goto fail;
+  s->procs = procs;
+  s->stride = initial->stride;
+  s->strips = calloc(procs, sizeof(Strip));
+  s->pids = calloc(procs, sizeof(pid_t));
+  s->control_bytes = sizeof(Control) + procs * sizeof(Slot);
+  s->control = shared_map(s->control_bytes, procs);
+  if (s->strips == NULL || s->pids == NULL || s->control == NULL) goto fail;
+
+  // Strips differ by at most one row
+  size_t y = 0;
+  for (size_t i = 0; i < procs; ++i) {
+    Strip *strip = &s->strips[i];
+    strip->y0 = y;
+    strip->rows = initial->height / procs + (i < initial->height % procs);
+    y += strip->rows;
+    strip->bytes = (4 + 2 * (strip->rows + 2)) * s->stride * sizeof(uint64_t);
+    strip->map = shared_map(strip->bytes, i);
+    if (strip->map == NULL) goto fail;
+    strip->mailbox = strip->map;
+    for (int k = 0; k < 2; ++k) {
+      LifeGrid *g = &strip->grids[k];
+      g->width = initial->width;
+      g->height = strip->rows + 2;
+      g->stride = s->stride;
+      g->cells = strip->mailbox + 4 * s->stride + k * g->height * s->stride;
+    }
+  }
+
+  // Pick the SIMD kernel once, the workers inherit it with the rule
+  lifegrid_current_kernel();
+  fflush(NULL);
+  for (size_t i = 0; i < procs; ++i) {
+    pid_t pid = fork();
+    if (pid < 0) goto fail;
+    if (pid == 0) worker_main(s, i);
+    s->pids[i] = pid;
+    s->started++;
+  }
+  if (!wait_workers(s, offsetof(Slot, ready), 1)) {
+    s->broken = true;
+    goto fail;
+  }
+
+  for (size_t i = 0; i < procs; ++i) {
+    Strip *strip = &s->strips[i];
+    memcpy(lifegrid_row(&strip->grids[0], 1), lifegrid_row(initial, strip->y0),
+           strip->rows * s->stride * sizeof(uint64_t));
+  }
+  return s;
+
+fail:
+  fprintf(stderr, "ERROR: could not start %zu worker processes\n", procs);
+  lifeshards_free(s);
+  return NULL;
+}
+
+void lifeshards_free(LifeShards *s) {
+  if (s == NULL) return;
+  if (s->started > 0) {
+    // Workers waiting for the rows of a dead one never see quit, they are
+    // killed instead
+    __atomic_store_n(&s->control->quit, 1, __ATOMIC_RELEASE);
+    post(&s->control->command, s->control->command + 1);
+    for (size_t i = 0; s->broken && i < s->started; ++i) {
+      if (s->pids[i] > 0) kill(s->pids[i], SIGKILL);
+    }
+    for (size_t i = 0; i < s->started; ++i) {
+      if (s->pids[i] > 0) waitpid(s->pids[i], NULL, 0);
+    }
+  }
+  for (size_t i = 0; s->strips != NULL && i < s->procs; ++i) {
+    if (s->strips[i].map != NULL) munmap(s->strips[i].map, s->strips[i].bytes);
+  }
+  if (s->control != NULL) munmap(s->control, s->control_bytes);
+  free(s->strips);
+  free(s->pids);
+  free(s);
+}
+
+bool lifeshards_step(LifeShards *s, uint64_t n) {
+  if (n == 0) return true;
+  s->generation += n;
+  s->control->target = s->generation;
+  post(&s->control->command, s->control->command + 1);
+  if (!wait_workers(s, offsetof(Slot, done), (uint32_t)s->generation)) {
+    s->broken = true;
+    fprintf(stderr, "ERROR: a worker process died\n");
+    return false;
+  }
+  return true;
+}
+
+void lifeshards_gather(const LifeShards *s, LifeGrid *out) {
+  int parity = s->generation % 2;
+  for (size_t i = 0; i < s->procs; ++i) {
+    const Strip *strip = &s->strips[i];
+    memcpy(lifegrid_row(out, strip->y0), lifegrid_row(&strip->grids[parity], 1),
+           strip->rows * s->stride * sizeof(uint64_t));
+  }
+}
+
+size_t lifeshards_popcount(const LifeShards *s) {
+  int parity = s->generation % 2;
+  size_t count = 0;
+  for (size_t i = 0; i < s->procs; ++i) {
+    const Strip *strip = &s->strips[i];
+    const uint64_t *cells = lifegrid_row(&strip->grids[parity], 1);
+    for (size_t w = 0; w < strip->rows * s->stride; ++w) count += __builtin_popcountll(cells[w]);
+  }
+  return count;
+}
+
+uint64_t lifeshards_generation(const LifeShards *s) {
+  return s->generation;
+}
+
+size_t lifeshards_procs(const LifeShards *s) {
+  return s->procs;
+}
+
+#else
+
+LifeShards *lifeshards_new(const LifeGrid *initial, size_t procs) {
+  (void)initial;
+  (void)procs;
+  fprintf(stderr, "ERROR: worker processes need Linux futexes\n");
+  return NULL;
+}
+
+void lifeshards_free(LifeShards *s) {
+  (void)s;
+}
+
+bool lifeshards_step(LifeShards *s, uint64_t n) {
+  (void)s;
+  (void)n;
+  return false;
+}
+
+void lifeshards_gather(const LifeShards *s, LifeGrid *out) {
+  (void)s;
+  (void)out;
+}
+
+size_t lifeshards_popcount(const LifeShards *s) {
+  (void)s;
+  return 0;
+}
+
+uint64_t lifeshards_generation(const LifeShards *s) {
+  (void)s;
+  return 0;
+}
+
+size_t lifeshards_procs(const LifeShards *s) {
+  (void)s;
+  return 0;
+}
+
+#endif // __linux__
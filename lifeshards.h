@@ -0,0 +1,45 @@
+#ifndef LIFESHARDS_H_
+#define LIFESHARDS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lifegrid.h"
+
+/* A torus split in horizontal strips over worker processes, for boards too
+ * big for one process or one memory controller. Every strip lives in a POSIX
+ * shared memory object of its own, touched first by its worker after the
+ * worker pinned itself to the CPUs of a NUMA node, so the strip ends up in
+ * that node's memory. Each generation the workers post their first and last
+ * rows to mailboxes in their strip and wait on futexes for the rows of the
+ * strips above and below; no lock is shared by all of them. The process
+ * that creates the shards is the coordinator: it hands out the generations
+ * to run and reads the strips back whenever it wants a snapshot.
+ *
+ * Only available on Linux, elsewhere lifeshards_new fails. */
+typedef struct LifeShards LifeShards;
+
+/* Fork procs workers, one strip each, starting from the cells of initial.
+ * The workers step with the rule and kernel selected when this is called.
+ * Prints the reason and returns NULL on failure. */
+LifeShards *lifeshards_new(const LifeGrid *initial, size_t procs);
+
+/* Stop the workers and release the strips. After a worker died the others
+ * are killed, as they may be waiting for it. */
+void lifeshards_free(LifeShards *s);
+
+/* Advance the board by n generations, the result is bit for bit the same as
+ * lifeboard_step n times. Returns false if a worker died. */
+bool lifeshards_step(LifeShards *s, uint64_t n);
+
+/* Copy the current generation into out, a grid of the board size. */
+void lifeshards_gather(const LifeShards *s, LifeGrid *out);
+
+/* The live cells of the current generation, counted in place. */
+size_t lifeshards_popcount(const LifeShards *s);
+
+uint64_t lifeshards_generation(const LifeShards *s);
+size_t lifeshards_procs(const LifeShards *s);
+
+#endif // LIFESHARDS_H_
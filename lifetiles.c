@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lifetiles.h"
+
+bool lifetiles_init(LifeTiles *t, LifeBoard *board) {
+  const LifeGrid *a = lifeboard_current(board);
+  memset(t, 0, sizeof(*t));
+  t->board = board;
+  t->tiles_x = a->stride;
+  t->tiles_y = (a->height + LIFETILE_SIZE - 1) / LIFETILE_SIZE;
+  size_t count = t->tiles_x * t->tiles_y;
+  t->changed = malloc(count * sizeof(size_t));
+  t->active = malloc(count * sizeof(size_t));
+  t->is_active = calloc(count, 1);
+  if (t->changed == NULL || t->active == NULL || t->is_active == NULL) {
+    lifetiles_free(t);
+    return false;
+  }
+  lifetiles_touch_all(t);
+  return true;
+}
+
+void lifetiles_free(LifeTiles *t) {
+  free(t->changed);
+  free(t->active);
+  free(t->is_active);
+  t->changed = NULL;
+  t->active = NULL;
+  t->is_active = NULL;
+}
+
+void lifetiles_touch_all(LifeTiles *t) {
+  t->changed_count = t->tiles_x * t->tiles_y;
+  for (size_t i = 0; i < t->changed_count; ++i) t->changed[i] = i;
+}
+
+/* The west and east neighbours of word k of a row, wrapping around the torus. */
+static uint64_t west_word(const uint64_t *row, size_t k, size_t width, size_t stride) {
+  uint64_t carry = k > 0 ? row[k - 1] >> 63 : (row[(width - 1) / 64] >> ((width - 1) % 64)) & 1;
+  uint64_t word = (row[k] << 1) | carry;
+  if (k == stride - 1 && width % 64) word &= ((uint64_t)1 << (width % 64)) - 1;
+  return word;
+}
+
+static uint64_t east_word(const uint64_t *row, size_t k, size_t width, size_t stride) {
+  if (k < stride - 1) return (row[k] >> 1) | (row[k + 1] << 63);
+  return (row[k] >> 1) | ((row[0] & 1) << ((width - 1) % 64));
+}
+
+/* Step one tile from old into next, returning whether any cell changed. */
+static bool step_tile(const LifeGrid *old, LifeGrid *next, size_t tx, size_t ty) {
+  size_t w = old->width, h = old->height, stride = old->stride, k = tx;
+  size_t y0 = ty * LIFETILE_SIZE;
+  size_t y1 = y0 + LIFETILE_SIZE < h ? y0 + LIFETILE_SIZE : h;
+
+  const uint64_t *row = lifegrid_row(old, (y0 + h - 1) % h);
+  uint64_t uw = west_word(row, k, w, stride), u = row[k], ue = east_word(row, k, w, stride);
+  row = lifegrid_row(old, y0);
+  uint64_t cw = west_word(row, k, w, stride), c = row[k], ce = east_word(row, k, w, stride);
+
+  uint64_t diff = 0;
+  for (size_t y = y0; y < y1; ++y) {
+    row = lifegrid_row(old, (y + 1) % h);
+    uint64_t dw = west_word(row, k, w, stride), d = row[k], de = east_word(row, k, w, stride);
+    uint64_t alive = lifegrid_word(uw, u, ue, cw, c, ce, dw, d, de);
+    diff |= alive ^ c;
+    lifegrid_row(next, y)[k] = alive;
+    uw = cw; u = c; ue = ce;
+    cw = dw; c = d; ce = de;
+  }
+  return diff != 0;
+}
+
+/* The active tiles are found by spreading every changed tile to its
+ * neighbours, and the tiles that change again become the next changed list,
+ * so the cost of a generation follows the activity and not the board size. */
+void lifetiles_step(LifeTiles *t) {
+  const LifeGrid *old = lifeboard_current(t->board);
+  LifeGrid *next = lifeboard_next(t->board);
+  size_t nx = t->tiles_x, ny = t->tiles_y;
+
+  t->active_count = 0;
+  for (size_t i = 0; i < t->changed_count; ++i) {
+    size_t tx = t->changed[i] % nx, ty = t->changed[i] / nx;
+    for (int dy = -1; dy <= 1; ++dy) {
+      for (int dx = -1; dx <= 1; ++dx) {
+        size_t n = (ty + ny + dy) % ny * nx + (tx + nx + dx) % nx;
+        if (!t->is_active[n]) {
+          t->is_active[n] = 1;
+          t->active[t->active_count++] = n;
+        }
+      }
+    }
+  }
+
+  // A tile that is not active holds the same cells in both grids, so it can be left alone
+  t->changed_count = 0;
+  for (size_t i = 0; i < t->active_count; ++i) {
+    size_t n = t->active[i];
+    t->is_active[n] = 0;
+    if (step_tile(old, next, n % nx, n / nx)) t->changed[t->changed_count++] = n;
+  }
+
+  lifeboard_swap(t->board);
+  t->generation++;
+}
+
+size_t lifetiles_active(const LifeTiles *t) {
+  return t->active_count;
+}
+
+size_t lifetiles_count(const LifeTiles *t) {
+  return t->tiles_x * t->tiles_y;
+}
@@ -0,0 +1,42 @@
+#ifndef LIFETILES_H_
+#define LIFETILES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lifegrid.h"
+
+#define LIFETILE_SIZE 64
+
+/* A LifeBoard stepper that only recomputes the 64x64 tiles that can change.
+ * A tile is active when it or one of its eight neighbours changed in the
+ * last generation; every other tile is known to be the same in both grids
+ * and is skipped. A tile is one word wide, so tile (tx,ty) is word tx of
+ * rows ty*64 to ty*64+63. */
+typedef struct {
+  LifeBoard *board;
+  size_t tiles_x;
+  size_t tiles_y;
+  size_t *changed;
+  size_t changed_count;
+  size_t *active;
+  size_t active_count;
+  uint8_t *is_active;
+  uint64_t generation;
+} LifeTiles;
+
+/* Track the board. Every tile starts out active. */
+bool lifetiles_init(LifeTiles *t, LifeBoard *board);
+void lifetiles_free(LifeTiles *t);
+
+/* Mark every tile active, needed after the board is edited directly. */
+void lifetiles_touch_all(LifeTiles *t);
+
+void lifetiles_step(LifeTiles *t);
+
+/* Number of tiles recomputed by the last step. */
+size_t lifetiles_active(const LifeTiles *t);
+size_t lifetiles_count(const LifeTiles *t);
+
+#endif // LIFETILES_H_
@@ -0,0 +1,191 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "perfstats.h"
+
+/* Bucket b < 8 holds the duration b, above that every power of two 2^e is
+ * split in 8 buckets by the three bits after its top one. */
+static size_t bucket_of(uint64_t ns) {
+  if (ns > UINT32_MAX) ns = UINT32_MAX;
+  if (ns < 8) return (size_t)ns;
+  int e = 63 - __builtin_clzll(ns);
+  return 8 + (size_t)(e - 3) * 8 + ((ns >> (e - 3)) & 7);
+}
+
+/* The middle of the durations that fall into a bucket. */
+static uint64_t bucket_value(size_t b) {
+  if (b < 8) return b;
+  int e = (int)(b - 8) / 8 + 3;
+  uint64_t width = (uint64_t)1 << (e - 3);
+  return (8 + (b - 8) % 8) * width + width / 2;
+}
+
+/* The duration q of the way through the samples, never above the maximum,
+ * which is known exactly. */
+static uint64_t percentile(const uint64_t *counts, uint64_t total, uint64_t max, double q) {
+  uint64_t rank = (uint64_t)(q * total + 0.999999), seen = 0;
+  if (rank == 0) rank = 1;
+  for (size_t b = 0; b < PERFSTATS_BUCKETS; ++b) {
+    seen += counts[b];
+    if (seen >= rank) return bucket_value(b) < max ? bucket_value(b) : max;
+  }
+  return max;
+}
+
+static PerfSummary summarize(const uint64_t *counts, uint64_t max) {
+  PerfSummary s = {0};
+  for (size_t b = 0; b < PERFSTATS_BUCKETS; ++b) s.count += counts[b];
+  if (s.count == 0) return s;
+  s.p50 = percentile(counts, s.count, max, 0.50);
+  s.p99 = percentile(counts, s.count, max, 0.99);
+  s.max = max;
+  return s;
+}
+
+uint64_t perfstats_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+PerfStats *perfstats_new(const char *const *names, size_t phases, const char *csv_path) {
+  if (phases > PERFSTATS_MAX_PHASES) {
+    fprintf(stderr, "ERROR: at most %d timed phases\n", PERFSTATS_MAX_PHASES);
+    return NULL;
+  }
+  PerfStats *p = calloc(1, sizeof(*p));
+  if (p == NULL) {
+    fprintf(stderr, "ERROR: could not allocate the timing rings\n");
+    return NULL;
+  }
+  p->phases = phases;
+  for (size_t i = 0; i < phases; ++i) p->names[i] = names[i];
+  if (csv_path != NULL) {
+    if ((p->csv = fopen(csv_path, "w")) == NULL) {
+      fprintf(stderr, "ERROR: could not open %s: %s\n", csv_path, strerror(errno));
+      free(p);
+      return NULL;
+    }
+    fprintf(p->csv, "second,generations_per_second");
+    for (size_t i = 0; i < phases; ++i) {
+      fprintf(p->csv, ",%s_count,%s_p50_us,%s_p99_us,%s_max_us", names[i], names[i], names[i], names[i]);
+    }
+    fprintf(p->csv, "\n");
+  }
+  p->start_ns = p->second_ns = perfstats_now();
+  return p;
+}
+
+void perfstats_record(PerfStats *p, size_t phase, uint64_t ns) {
+  PerfPhase *ph = &p->phase[phase];
+  uint64_t tail = ph->tail;
+  if (tail - __atomic_load_n(&ph->head, __ATOMIC_ACQUIRE) == PERFSTATS_RING) {
+    __atomic_fetch_add(&ph->dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  ph->ring[tail & (PERFSTATS_RING - 1)] = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+  __atomic_store_n(&ph->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+void perfstats_add_generations(PerfStats *p, uint64_t n) {
+  __atomic_fetch_add(&p->generations, n, __ATOMIC_RELAXED);
+}
+
+static void drain(PerfPhase *ph) {
+  uint64_t head = ph->head, tail = __atomic_load_n(&ph->tail, __ATOMIC_ACQUIRE);
+  for (; head < tail; ++head) {
+    uint32_t ns = ph->ring[head & (PERFSTATS_RING - 1)];
+    size_t b = bucket_of(ns);
+    ph->second[b]++;
+    ph->total[b]++;
+    if (ns > ph->second_max) ph->second_max = ns;
+    if (ns > ph->total_max) ph->total_max = ns;
+  }
+  __atomic_store_n(&ph->head, head, __ATOMIC_RELEASE);
+}
+
+static void write_csv_value(FILE *f, uint64_t ns) {
+  fprintf(f, ",%.3f", ns / 1e3);
+}
+
+/* Sum up the samples and generations since the last second ended. */
+static void close_second(PerfStats *p, uint64_t now) {
+  uint64_t generations = __atomic_load_n(&p->generations, __ATOMIC_RELAXED);
+  double elapsed = (now - p->second_ns) / 1e9;
+  p->last_rate = elapsed > 0 ? (generations - p->second_generations) / elapsed : 0;
+  p->second_generations = generations;
+  p->second_ns = now;
+  p->seconds++;
+  for (size_t i = 0; i < p->phases; ++i) {
+    PerfPhase *ph = &p->phase[i];
+    p->last[i] = summarize(ph->second, ph->second_max);
+    memset(ph->second, 0, sizeof(ph->second));
+    ph->second_max = 0;
+  }
+  if (p->csv != NULL) {
+    fprintf(p->csv, "%" PRIu64 ",%.1f", p->seconds, p->last_rate);
+    for (size_t i = 0; i < p->phases; ++i) {
+      fprintf(p->csv, ",%" PRIu64, p->last[i].count);
+      write_csv_value(p->csv, p->last[i].p50);
+      write_csv_value(p->csv, p->last[i].p99);
+      write_csv_value(p->csv, p->last[i].max);
+    }
+    fprintf(p->csv, "\n");
+  }
+}
+
+bool perfstats_poll(PerfStats *p) {
+  for (size_t i = 0; i < p->phases; ++i) drain(&p->phase[i]);
+  uint64_t now = perfstats_now();
+  if (now - p->second_ns < 1000000000) return false;
+  close_second(p, now);
+  return true;
+}
+
+PerfSummary perfstats_total(const PerfStats *p, size_t phase) {
+  return summarize(p->phase[phase].total, p->phase[phase].total_max);
+}
+
+void perfstats_format(char *buf, size_t size, uint64_t ns) {
+  if (ns < 1000) snprintf(buf, size, "%" PRIu64 "ns", ns);
+  else if (ns < 1000000) snprintf(buf, size, "%.1fus", ns / 1e3);
+  else if (ns < 1000000000) snprintf(buf, size, "%.2fms", ns / 1e6);
+  else snprintf(buf, size, "%.2fs", ns / 1e9);
+}
+
+void perfstats_report(const PerfStats *p, FILE *out) {
+  for (size_t i = 0; i < p->phases; ++i) {
+    PerfSummary s = perfstats_total(p, i);
+    fprintf(out, "%s: %" PRIu64 " samples", p->names[i], s.count);
+    char p50[16], p99[16], max[16];
+    perfstats_format(p50, sizeof(p50), s.p50);
+    perfstats_format(p99, sizeof(p99), s.p99);
+    perfstats_format(max, sizeof(max), s.max);
+    if (s.count > 0) fprintf(out, ", p50 %s, p99 %s, max %s", p50, p99, max);
+    uint64_t dropped = __atomic_load_n(&p->phase[i].dropped, __ATOMIC_RELAXED);
+    if (dropped > 0) fprintf(out, ", %" PRIu64 " dropped", dropped);
+    fprintf(out, "\n");
+  }
+  double elapsed = (perfstats_now() - p->start_ns) / 1e9;
+  uint64_t generations = __atomic_load_n(&p->generations, __ATOMIC_RELAXED);
+  fprintf(out, "%.0f generations per second\n", elapsed > 0 ? generations / elapsed : 0);
+}
+
+bool perfstats_finish(PerfStats *p) {
+  bool ok = true;
+  if (p->csv != NULL) {
+    for (size_t i = 0; i < p->phases; ++i) drain(&p->phase[i]);
+    uint64_t now = perfstats_now();
+    if (now > p->second_ns) close_second(p, now);
+    if (ferror(p->csv) | (fclose(p->csv) != 0)) {
+      fprintf(stderr, "ERROR: could not write the timings: %s\n", strerror(errno));
+      ok = false;
+    }
+  }
+  free(p);
+  return ok;
+}
@@ -0,0 +1,84 @@
+#ifndef PERFSTATS_H_
+#define PERFSTATS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define PERFSTATS_MAX_PHASES 4
+
+/* Samples a phase can have waiting between two polls, a power of two. */
+#define PERFSTATS_RING (1 << 16)
+
+/* Durations go to histograms with 8 buckets per power of two, which puts a
+ * percentile within 6% of the true one. Durations are in nanoseconds and
+ * saturate at about 4 seconds. */
+#define PERFSTATS_BUCKETS 240
+
+typedef struct {
+  uint64_t count;
+  uint64_t p50, p99, max; // nanoseconds
+} PerfSummary;
+
+/* Durations of one phase. The thread that times the phase is the only one
+ * that pushes to its ring, the thread that polls is the only one that pops,
+ * so recording a sample is a store and a release without locks, and a full
+ * ring drops the sample instead of waiting. */
+typedef struct {
+  uint32_t ring[PERFSTATS_RING];
+  char pad0[64];
+  uint64_t head; // next sample to pop, written by the poller
+  char pad1[64];
+  uint64_t tail; // next sample to push, written by the timed thread
+  uint64_t dropped;
+  char pad2[64];
+  uint64_t second[PERFSTATS_BUCKETS];
+  uint64_t total[PERFSTATS_BUCKETS];
+  uint64_t second_max, total_max;
+} PerfPhase;
+
+/* Timings of the phases of a loop, summed up second by second: the p50,
+ * p99 and maximum of every phase and the generations per second. Every
+ * second also goes to a CSV file if there is one. */
+typedef struct {
+  size_t phases;
+  const char *names[PERFSTATS_MAX_PHASES];
+  uint64_t generations; // added to atomically from any thread
+  uint64_t start_ns, second_ns, second_generations;
+  uint64_t seconds;
+  PerfSummary last[PERFSTATS_MAX_PHASES]; // of the last whole second
+  double last_rate;
+  FILE *csv;
+  PerfPhase phase[PERFSTATS_MAX_PHASES];
+} PerfStats;
+
+/* Stats for the phases called names, written to csv_path, if not NULL,
+ * every second. Prints the reason and returns NULL on failure. */
+PerfStats *perfstats_new(const char *const *names, size_t phases, const char *csv_path);
+
+/* Write out the second in progress, close the CSV file and free the stats.
+ * Returns false if writing the file failed, after printing the reason. */
+bool perfstats_finish(PerfStats *p);
+
+/* A monotonic timestamp in nanoseconds. */
+uint64_t perfstats_now(void);
+
+/* Timed thread side: one duration of a phase and the generations done. */
+void perfstats_record(PerfStats *p, size_t phase, uint64_t ns);
+void perfstats_add_generations(PerfStats *p, uint64_t n);
+
+/* Poller side: take the waiting samples and, once a second is over, sum it
+ * up in last and last_rate. Returns true when a new second is summed up. */
+bool perfstats_poll(PerfStats *p);
+
+/* The whole run so far. */
+PerfSummary perfstats_total(const PerfStats *p, size_t phase);
+
+/* Print the whole run, one line per phase and the generations per second. */
+void perfstats_report(const PerfStats *p, FILE *out);
+
+/* Format a duration with a unit that fits it, "850ns", "12.3us", "4.56ms". */
+void perfstats_format(char *buf, size_t size, uint64_t ns);
+
+#endif // PERFSTATS_H_
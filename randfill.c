@@ -0,0 +1,130 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "randfill.h"
+
+typedef struct {
+  uint64_t s[4];
+} Xoshiro;
+
+static uint64_t splitmix64(uint64_t *x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t xoshiro_next(Xoshiro *g) {
+  uint64_t *s = g->s;
+  uint64_t result = rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+  return result;
+}
+
+/* The stream of a block: SplitMix64 started from the seed and the block
+ * number mixed together, never all zero. */
+static void xoshiro_seed(Xoshiro *g, uint64_t seed, uint64_t block) {
+  uint64_t x = seed ^ (block * 0xd1342543de82ef95);
+  x = splitmix64(&x);
+  for (int i = 0; i < 4; ++i) g->s[i] = splitmix64(&x);
+}
+
+typedef struct {
+  uint64_t *cells;
+  size_t width, height, stride, words; // words of cells in a row
+  uint64_t seed;
+  uint32_t p; // the density in units of 2^-RANDFILL_DENSITY_BITS
+  uint64_t first, last; // blocks
+} Fill;
+
+static inline uint64_t draw_word(Xoshiro *g, uint32_t p) {
+  if (p == 0) return 0;
+  if (p >> RANDFILL_DENSITY_BITS) return ~(uint64_t)0;
+  uint64_t w = 0;
+  for (int j = __builtin_ctz(p); j < RANDFILL_DENSITY_BITS; ++j) {
+    uint64_t r = xoshiro_next(g);
+    w = (p >> j) & 1 ? w | r : w & r;
+  }
+  return w;
+}
+
+static void *fill_blocks(void *arg) {
+  const Fill *f = arg;
+  uint64_t total = (uint64_t)f->words * f->height;
+  uint64_t tail = f->width % 64 ? ((uint64_t)1 << (f->width % 64)) - 1 : ~(uint64_t)0;
+  for (uint64_t b = f->first; b < f->last; ++b) {
+    Xoshiro g;
+    xoshiro_seed(&g, f->seed, b);
+    uint64_t i = b * RANDFILL_BLOCK_WORDS, end = i + RANDFILL_BLOCK_WORDS < total ? i + RANDFILL_BLOCK_WORDS : total;
+    size_t y = i / f->words, w = i % f->words;
+    uint64_t *row = f->cells + y * f->stride;
+    for (; i < end; ++i) {
+      uint64_t v = draw_word(&g, f->p);
+      row[w] = w + 1 == f->words ? v & tail : v;
+      if (++w == f->words) {
+        w = 0;
+        row += f->stride;
+      }
+    }
+  }
+  return NULL;
+}
+
+void randfill(uint64_t *cells, size_t width, size_t height, size_t stride, uint64_t seed, double density,
+              size_t threads) {
+  Fill whole = {cells, width, height, stride, (width + 63) / 64, seed, 0, 0, 0};
+  if (whole.words == 0 || height == 0) return;
+  double scaled = density * (1 << RANDFILL_DENSITY_BITS) + 0.5;
+  whole.p = scaled <= 0 ? 0 : scaled >= (1 << RANDFILL_DENSITY_BITS) ? 1 << RANDFILL_DENSITY_BITS : (uint32_t)scaled;
+  uint64_t blocks = ((uint64_t)whole.words * height + RANDFILL_BLOCK_WORDS - 1) / RANDFILL_BLOCK_WORDS;
+
+  if (threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? (size_t)cpus : 1;
+  }
+  if (threads > blocks) threads = blocks;
+  Fill parts[threads];
+  pthread_t ids[threads];
+  bool started[threads];
+  for (size_t t = 0; t < threads; ++t) {
+    parts[t] = whole;
+    parts[t].first = blocks * t / threads;
+    parts[t].last = blocks * (t + 1) / threads;
+    // A part whose thread could not start is filled by the caller instead
+    started[t] = t > 0 && pthread_create(&ids[t], NULL, fill_blocks, &parts[t]) == 0;
+  }
+  for (size_t t = 0; t < threads; ++t) {
+    if (!started[t]) fill_blocks(&parts[t]);
+  }
+  for (size_t t = 0; t < threads; ++t) {
+    if (started[t]) pthread_join(ids[t], NULL);
+  }
+}
+
+bool randfill_parse_seed(const char *text, uint64_t *seed) {
+  char *end;
+  errno = 0;
+  unsigned long long n = strtoull(text, &end, 10);
+  // strtoull takes a sign and leading spaces, a seed is digits only
+  if (*text < '0' || *text > '9' || *end != '\0' || errno == ERANGE) {
+    fprintf(stderr, "ERROR: invalid seed '%s', expected a number from 0 to 2^64-1\n", text);
+    return false;
+  }
+  *seed = n;
+  return true;
+}
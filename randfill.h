@@ -0,0 +1,34 @@
+#ifndef RANDFILL_H_
+#define RANDFILL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The words of a board, counted in row order without the padding words of
+ * the stride, are cut in blocks of this many, each of them drawn from a
+ * random stream of its own. */
+#define RANDFILL_BLOCK_WORDS 4096
+
+/* Densities are rounded to a multiple of 2^-RANDFILL_DENSITY_BITS. */
+#define RANDFILL_DENSITY_BITS 16
+
+/* Fill height rows of width cells, stride words apart and packed like a
+ * BitRow, with cells alive at the given density, leaving the padding bits
+ * past width dead. Every block of words has an xoshiro256** stream seeded
+ * from the seed and the block number by SplitMix64, and the threads, one
+ * per CPU if threads is 0, split the blocks between them, so a seed gives
+ * the same cells bit for bit whatever the number of threads.
+ *
+ * A word of 64 cells takes one draw at density 1/2. Other densities go
+ * through the bits of the density from the lowest one up, ORing in a new
+ * draw for a one and ANDing for a zero, so every cell ends up alive with
+ * exactly the rounded density and no cell is drawn on its own. */
+void randfill(uint64_t *cells, size_t width, size_t height, size_t stride, uint64_t seed, double density,
+              size_t threads);
+
+/* Parse a seed, a decimal number from 0 to 2^64-1. Prints the reason to
+ * stderr on failure. */
+bool randfill_parse_seed(const char *text, uint64_t *seed);
+
+#endif // RANDFILL_H_
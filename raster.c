@@ -0,0 +1,344 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "raster.h"
+
+/* A band is rasterized into about this many bytes of scanlines. */
+#define BAND_BYTES (32 << 20)
+
+/* The most a stored deflate block holds. */
+#define STORED_BLOCK 65535
+
+/* The largest width and height a PNG may have. */
+#define PNG_MAX_SIDE 0x7fffffff
+
+/* Pixels are indices into the palette: bit 0 is the cell, bit 1 the grid.
+ * The colors are those of the board view, the grid blended over them. */
+enum { DEAD, ALIVE, GRID };
+static const uint8_t palette[4][3] = {
+  {26, 26, 26},    // the clear color
+  {186, 171, 255}, // COLOR_PINK_V4F
+  {33, 33, 33},    // the grid over the clear color
+  {146, 135, 194}, // the grid over a cell
+};
+
+struct RasterImage {
+  FILE *f;
+  bool png;
+  bool failed;
+  RasterStyle style;
+  size_t spacing; // cells from one grid line to the next, 0 without a grid
+  size_t cols, width;
+  uint64_t rows, height;
+  uint64_t row; // cell rows written to the file so far
+  size_t line_bytes; // of a scanline, with the filter byte of a PNG
+
+  // The band being filled, its rows stride words apart, and its scanlines
+  size_t stride;
+  uint64_t *band;
+  size_t band_cap, band_rows;
+  uint8_t *lines;
+
+  // The PNG image data is one zlib stream of stored blocks
+  uint64_t remaining;
+  uint32_t adler_a, adler_b;
+};
+
+static uint32_t crc_table[256];
+
+// The PNG pixels of 8 cells at one pixel a cell without a grid, the first
+// cell in the high bits of the first byte
+static uint8_t spread_table[256][2];
+
+static void tables_init(void) {
+  for (uint32_t n = 0; n < 256; ++n) {
+    uint32_t c = n;
+    for (int k = 0; k < 8; ++k) c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+    crc_table[n] = c;
+    spread_table[n][0] = spread_table[n][1] = 0;
+    for (int k = 0; k < 8; ++k) spread_table[n][k / 4] |= ((n >> k) & 1) << (6 - 2 * (k % 4));
+  }
+}
+
+static uint32_t crc_update(uint32_t crc, const uint8_t *p, size_t n) {
+  for (size_t i = 0; i < n; ++i) crc = crc_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+/* Sums are only reduced every 5552 bytes, the most that cannot overflow. */
+static void adler_update(RasterImage *img, const uint8_t *p, size_t n) {
+  uint32_t a = img->adler_a, b = img->adler_b;
+  while (n > 0) {
+    size_t k = n < 5552 ? n : 5552;
+    for (size_t i = 0; i < k; ++i) {
+      a += p[i];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+    p += k;
+    n -= k;
+  }
+  img->adler_a = a;
+  img->adler_b = b;
+}
+
+static void put_be32(uint8_t *p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+/* Write a PNG chunk whose data is head followed by data. */
+static void write_chunk(RasterImage *img, const char *type, const uint8_t *head, size_t head_len,
+                        const uint8_t *data, size_t len) {
+  uint8_t buf[8];
+  put_be32(buf, (uint32_t)(head_len + len));
+  memcpy(buf + 4, type, 4);
+  uint32_t crc = crc_update(0xffffffff, buf + 4, 4);
+  crc = crc_update(crc, head, head_len);
+  crc = crc_update(crc, data, len);
+  fwrite(buf, 1, 8, img->f);
+  fwrite(head, 1, head_len, img->f);
+  if (len > 0) fwrite(data, 1, len, img->f);
+  put_be32(buf, crc ^ 0xffffffff);
+  fwrite(buf, 1, 4, img->f);
+}
+
+/* Add bytes of image data to the zlib stream, as stored blocks in IDAT
+ * chunks of their own; the block with the last byte of the image is final. */
+static void png_data(RasterImage *img, const uint8_t *p, size_t n) {
+  adler_update(img, p, n);
+  while (n > 0) {
+    size_t len = n < STORED_BLOCK ? n : STORED_BLOCK;
+    img->remaining -= len;
+    uint8_t head[5] = {img->remaining == 0, len & 0xff, len >> 8, ~len & 0xff, (~len >> 8) & 0xff};
+    write_chunk(img, "IDAT", head, sizeof(head), p, len);
+    p += len;
+    n -= len;
+  }
+}
+
+static bool png_start(RasterImage *img) {
+  static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  uint8_t ihdr[13];
+  put_be32(ihdr, (uint32_t)img->width);
+  put_be32(ihdr + 4, (uint32_t)img->height);
+  ihdr[8] = 2;  // bits per pixel
+  ihdr[9] = 3;  // palette
+  ihdr[10] = 0; // deflate
+  ihdr[11] = 0; // adaptive filters, every line uses none
+  ihdr[12] = 0; // not interlaced
+  static const uint8_t zlib_header[2] = {0x78, 0x01}; // deflate, 32K window, no dictionary
+  fwrite(signature, 1, sizeof(signature), img->f);
+  write_chunk(img, "IHDR", ihdr, sizeof(ihdr), NULL, 0);
+  write_chunk(img, "PLTE", &palette[0][0], sizeof(palette), NULL, 0);
+  write_chunk(img, "IDAT", zlib_header, sizeof(zlib_header), NULL, 0);
+  img->remaining = img->height * img->line_bytes;
+  img->adler_a = 1;
+  img->adler_b = 0;
+  return !ferror(img->f);
+}
+
+static void png_end(RasterImage *img) {
+  uint8_t adler[4];
+  put_be32(adler, (img->adler_b << 16) | img->adler_a);
+  write_chunk(img, "IDAT", adler, sizeof(adler), NULL, 0);
+  write_chunk(img, "IEND", NULL, 0, NULL, 0);
+}
+
+/* Encode one scanline of pixels through a row of cells, a horizontal grid
+ * line if hline. */
+static void encode_line(const RasterImage *img, const uint64_t *cells, bool hline, uint8_t *out) {
+  size_t scale = img->style.scale;
+  if (img->png) {
+    memset(out, 0, img->line_bytes);
+    out++; // the filter byte
+  }
+  size_t x = 0, px = 0;
+  if (img->png && scale == 1 && img->spacing == 0) {
+    for (; x + 8 <= img->cols; x += 8, px += 8) {
+      memcpy(out + px / 4, spread_table[(cells[x / 64] >> (x % 64)) & 0xff], 2);
+    }
+  }
+  for (; x < img->cols; ++x) {
+    int cell = (cells[x / 64] >> (x % 64)) & 1;
+    bool vline = img->spacing > 0 && x % img->spacing == 0;
+    for (size_t i = 0; i < scale; ++i, ++px) {
+      int c = cell | (hline || (vline && i == 0) ? GRID : DEAD);
+      if (img->png) out[px >> 2] |= c << (6 - 2 * (px & 3));
+      else memcpy(out + 3 * px, palette[c], 3);
+    }
+  }
+}
+
+typedef struct {
+  RasterImage *img;
+  size_t first, last; // rows of the band
+} Strip;
+
+/* Every row of cells is at most two distinct scanlines, the first one with
+ * the grid line, copied over the rest of the cell's height. */
+static void *rasterize_strip(void *arg) {
+  Strip *s = arg;
+  RasterImage *img = s->img;
+  size_t scale = img->style.scale, lb = img->line_bytes;
+  for (size_t y = s->first; y < s->last; ++y) {
+    const uint64_t *cells = img->band + y * img->stride;
+    uint8_t *out = img->lines + y * scale * lb;
+    bool hline = img->spacing > 0 && (img->row + y) % img->spacing == 0;
+    encode_line(img, cells, hline, out);
+    if (scale < 2) continue;
+    if (hline) encode_line(img, cells, false, out + lb);
+    else memcpy(out + lb, out, lb);
+    for (size_t i = 2; i < scale; ++i) memcpy(out + i * lb, out + lb, lb);
+  }
+  return NULL;
+}
+
+/* Rasterize the band, strip by strip, the calling thread taking the first
+ * strip, and write it out. */
+static bool flush_band(RasterImage *img) {
+  size_t rows = img->band_rows;
+  if (rows == 0 || img->failed) return !img->failed;
+  size_t threads = img->style.threads < rows ? img->style.threads : rows;
+  Strip strips[threads];
+  pthread_t ids[threads];
+  bool started[threads];
+  for (size_t t = 0; t < threads; ++t) {
+    strips[t] = (Strip){img, rows * t / threads, rows * (t + 1) / threads};
+    // A strip whose thread could not start is done by the caller instead
+    started[t] = t > 0 && pthread_create(&ids[t], NULL, rasterize_strip, &strips[t]) == 0;
+  }
+  for (size_t t = 0; t < threads; ++t) {
+    if (!started[t]) rasterize_strip(&strips[t]);
+  }
+  for (size_t t = 0; t < threads; ++t) {
+    if (started[t]) pthread_join(ids[t], NULL);
+  }
+
+  size_t bytes = rows * img->style.scale * img->line_bytes;
+  if (img->png) png_data(img, img->lines, bytes);
+  else fwrite(img->lines, 1, bytes, img->f);
+  img->row += rows;
+  img->band_rows = 0;
+  if (ferror(img->f)) {
+    fprintf(stderr, "ERROR: could not write the image: %s\n", strerror(errno));
+    img->failed = true;
+  }
+  return !img->failed;
+}
+
+static void raster_free(RasterImage *img) {
+  if (img->f != NULL) fclose(img->f);
+  free(img->band);
+  free(img->lines);
+  free(img);
+}
+
+static bool ends_with(const char *s, const char *suffix) {
+  size_t n = strlen(s), k = strlen(suffix);
+  return n >= k && strcmp(s + n - k, suffix) == 0;
+}
+
+RasterImage *raster_new(const char *path, size_t cols, uint64_t rows, const RasterStyle *style) {
+  RasterImage *img = calloc(1, sizeof(*img));
+  if (img == NULL) {
+    fprintf(stderr, "ERROR: could not allocate the image\n");
+    return NULL;
+  }
+  img->png = !ends_with(path, ".ppm");
+  img->style = *style;
+  if (img->style.scale == 0) img->style.scale = 1;
+  if (img->style.threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    img->style.threads = cpus > 0 ? (size_t)cpus : 1;
+  }
+  size_t scale = img->style.scale;
+  if (style->grid && scale > 2) img->spacing = scale < 4 ? 5 : 1;
+  img->cols = cols;
+  img->rows = rows;
+  img->width = cols * scale;
+  img->height = rows * scale;
+  if (cols == 0 || rows == 0 || img->width / scale != cols || img->height / scale != rows ||
+      (img->png && (img->width > PNG_MAX_SIDE || img->height > PNG_MAX_SIDE))) {
+    fprintf(stderr, "ERROR: can not make an image of %zux%" PRIu64 " cells at %zu pixels a cell\n", cols, rows, scale);
+    free(img);
+    return NULL;
+  }
+  img->line_bytes = img->png ? 1 + (img->width + 3) / 4 : img->width * 3;
+
+  img->stride = (cols + 63) / 64;
+  size_t cell_bytes = scale * img->line_bytes;
+  img->band_cap = BAND_BYTES / cell_bytes > 0 ? BAND_BYTES / cell_bytes : 1;
+  if (img->band_cap > rows) img->band_cap = rows;
+  img->band = malloc(img->band_cap * img->stride * sizeof(uint64_t));
+  img->lines = malloc(img->band_cap * cell_bytes);
+  if (img->band == NULL || img->lines == NULL) {
+    fprintf(stderr, "ERROR: could not allocate a band of %zu rows of %zu pixels\n", img->band_cap * scale, img->width);
+    raster_free(img);
+    return NULL;
+  }
+
+  if ((img->f = fopen(path, "wb")) == NULL) {
+    fprintf(stderr, "ERROR: could not open %s: %s\n", path, strerror(errno));
+    raster_free(img);
+    return NULL;
+  }
+  bool ok;
+  if (img->png) {
+    tables_init();
+    ok = png_start(img);
+  } else {
+    ok = fprintf(img->f, "P6\n%zu %" PRIu64 "\n255\n", img->width, img->height) > 0;
+  }
+  if (!ok) {
+    fprintf(stderr, "ERROR: could not write %s: %s\n", path, strerror(errno));
+    raster_free(img);
+    return NULL;
+  }
+  return img;
+}
+
+bool raster_add_rows(RasterImage *img, const uint64_t *cells, size_t stride, size_t n) {
+  for (size_t i = 0; i < n && !img->failed; ++i) {
+    if (img->row + img->band_rows >= img->rows) {
+      fprintf(stderr, "ERROR: the image only has room for %" PRIu64 " rows\n", img->rows);
+      img->failed = true;
+      break;
+    }
+    memcpy(img->band + img->band_rows * img->stride, cells + i * stride, img->stride * sizeof(uint64_t));
+    if (++img->band_rows == img->band_cap) flush_band(img);
+  }
+  return !img->failed;
+}
+
+bool raster_finish(RasterImage *img) {
+  while (!img->failed && img->row + img->band_rows < img->rows) {
+    memset(img->band + img->band_rows * img->stride, 0, img->stride * sizeof(uint64_t));
+    if (++img->band_rows == img->band_cap) flush_band(img);
+  }
+  bool ok = flush_band(img);
+  if (ok && img->png) png_end(img);
+  ok = ok && !ferror(img->f);
+  if (fclose(img->f) != 0) ok = false;
+  img->f = NULL;
+  if (!ok && !img->failed) fprintf(stderr, "ERROR: could not write the image: %s\n", strerror(errno));
+  raster_free(img);
+  return ok;
+}
+
+bool raster_write(const char *path, const uint64_t *cells, size_t stride, size_t cols, size_t rows,
+                  const RasterStyle *style) {
+  RasterImage *img = raster_new(path, cols, rows, style);
+  if (img == NULL) return false;
+  raster_add_rows(img, cells, stride, rows);
+  return raster_finish(img);
+}
@@ -0,0 +1,45 @@
+#ifndef RASTER_H_
+#define RASTER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* How cells become pixels. Every cell is scale x scale pixels, alive cells
+ * in the pink of the board view on its dark background, and with grid on
+ * the first row and column of pixels of a cell are grid lines, of every
+ * fifth cell only when cells are smaller than 4 pixels and not at all when
+ * they are smaller than 3, as the board view draws them. */
+typedef struct {
+  size_t scale;
+  bool grid;
+  size_t threads; // 0 for one per CPU
+} RasterStyle;
+
+/* An image of rows of cells, rasterized without a GPU and streamed to disk
+ * as the rows come in. Rows are collected in bands; a full band is split in
+ * strips rasterized by threads of their own straight into the encoded
+ * scanlines, which then go to the file in one piece. Images whose path ends
+ * in .ppm are binary PPM in full color, all others PNG with a 2 bit palette
+ * and uncompressed deflate, so a pixel costs a quarter of a byte and nothing
+ * but the rasterizing takes time. */
+typedef struct RasterImage RasterImage;
+
+/* Start an image of rows rows of cols cells at path. Prints the reason and
+ * returns NULL on failure. */
+RasterImage *raster_new(const char *path, size_t cols, uint64_t rows, const RasterStyle *style);
+
+/* Add the next n rows of cells, stride words apart, laid out like a BitRow.
+ * Fails once writing the file has failed or if there are more rows than
+ * the image was started with. */
+bool raster_add_rows(RasterImage *img, const uint64_t *cells, size_t stride, size_t n);
+
+/* Fill the rows that never came with dead cells, complete the file and
+ * close it. Returns false if anything went wrong, after printing why. */
+bool raster_finish(RasterImage *img);
+
+/* Write a whole grid of cells as one image, rows stride words apart. */
+bool raster_write(const char *path, const uint64_t *cells, size_t stride, size_t cols, size_t rows,
+                  const RasterStyle *style);
+
+#endif // RASTER_H_
@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rowqueue.h"
+
+bool rowqueue_init(RowQueue *q, size_t capacity, size_t width) {
+  memset(q, 0, sizeof(*q));
+  q->capacity = 1;
+  while (q->capacity < capacity) q->capacity *= 2;
+  q->words = bitrow_words(width);
+  q->bits = calloc(q->capacity * (q->words ? q->words : 1), sizeof(uint64_t));
+  q->generations = calloc(q->capacity, sizeof(uint64_t));
+  q->restarts = calloc(q->capacity, sizeof(bool));
+  if (q->bits == NULL || q->generations == NULL || q->restarts == NULL) {
+    rowqueue_free(q);
+    return false;
+  }
+  return true;
+}
+
+void rowqueue_free(RowQueue *q) {
+  free(q->bits);
+  free(q->generations);
+  free(q->restarts);
+  q->bits = NULL;
+  q->generations = NULL;
+  q->restarts = NULL;
+}
+
+/* The acquire loads pair with the release stores of the other side: once an
+ * index is seen to move, the rows it covers are completely written (by the
+ * producer) or completely read (by the consumer). */
+
+size_t rowqueue_space(const RowQueue *q) {
+  return q->capacity - (q->tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE));
+}
+
+bool rowqueue_push(RowQueue *q, const BitRow *row, uint64_t generation, bool restart) {
+  size_t tail = q->tail;
+  if (tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == q->capacity) return false;
+  size_t slot = tail & (q->capacity - 1);
+  memcpy(q->bits + slot * q->words, row->bits, q->words * sizeof(uint64_t));
+  q->generations[slot] = generation;
+  q->restarts[slot] = restart;
+  __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+size_t rowqueue_count(const RowQueue *q) {
+  return __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) - q->head;
+}
+
+const uint64_t *rowqueue_row(const RowQueue *q, size_t i, uint64_t *generation, bool *restart) {
+  size_t slot = (q->head + i) & (q->capacity - 1);
+  *generation = q->generations[slot];
+  *restart = q->restarts[slot];
+  return q->bits + slot * q->words;
+}
+
+void rowqueue_pop(RowQueue *q, size_t n) {
+  __atomic_store_n(&q->head, q->head + n, __ATOMIC_RELEASE);
+}
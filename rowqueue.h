@@ -0,0 +1,44 @@
+#ifndef ROWQUEUE_H_
+#define ROWQUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "bitrow.h"
+
+/* A lock-free queue of bit-packed rows between exactly one producer thread
+ * and one consumer thread. Each side only writes its own index, so pushing
+ * and popping is a copy plus one release store, without locks. Every row
+ * carries its generation and a restart flag, which tells the consumer that
+ * the rows before it were dropped and the history starts over at this row. */
+typedef struct {
+  size_t capacity; // a power of two
+  size_t words;
+  uint64_t *bits;
+  uint64_t *generations;
+  bool *restarts;
+  // The producer's and the consumer's index, on cache lines of their own
+  char pad0[64];
+  size_t head; // next row to pop, written by the consumer
+  char pad1[64];
+  size_t tail; // next row to push, written by the producer
+  char pad2[64];
+} RowQueue;
+
+/* Room for at least capacity rows of width cells. */
+bool rowqueue_init(RowQueue *q, size_t capacity, size_t width);
+void rowqueue_free(RowQueue *q);
+
+/* Producer side: the number of rows that can be pushed right now, and push
+ * one row, which returns false without waiting if the queue is full. */
+size_t rowqueue_space(const RowQueue *q);
+bool rowqueue_push(RowQueue *q, const BitRow *row, uint64_t generation, bool restart);
+
+/* Consumer side: the number of rows waiting, the bits, generation and
+ * restart flag of the i-th oldest of them, and drop the n oldest. */
+size_t rowqueue_count(const RowQueue *q);
+const uint64_t *rowqueue_row(const RowQueue *q, size_t i, uint64_t *generation, bool *restart);
+void rowqueue_pop(RowQueue *q, size_t n);
+
+#endif // ROWQUEUE_H_
@@ -0,0 +1,76 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rule.h"
+
+/* Read the digits of one half of a rule into a mask of neighbour counts. */
+static const char *parse_counts(const char *s, uint16_t *mask) {
+  *mask = 0;
+  for (; *s >= '0' && *s <= '8'; ++s) {
+    uint16_t bit = 1u << (*s - '0');
+    if (*mask & bit) return NULL;
+    *mask |= bit;
+  }
+  return s;
+}
+
+bool liferule_parse(const char *text, LifeRule *rule) {
+  LifeRule r = {0, 0};
+  const char *s = text;
+  bool ok = true;
+
+  if (isdigit((unsigned char)*s) || *s == '/') {
+    // survive/birth
+    s = parse_counts(s, &r.survive);
+    ok = s != NULL && *s++ == '/' && (s = parse_counts(s, &r.birth)) != NULL && *s == '\0';
+  } else {
+    bool seen_birth = false, seen_survive = false;
+    while (ok && *s != '\0') {
+      char c = toupper((unsigned char)*s++);
+      if (c == 'B' && !seen_birth) {
+        seen_birth = true;
+        s = parse_counts(s, &r.birth);
+      } else if (c == 'S' && !seen_survive) {
+        seen_survive = true;
+        s = parse_counts(s, &r.survive);
+      } else {
+        ok = false;
+      }
+      if (s == NULL) ok = false;
+      else if (*s == '/' && s[1] != '\0') s++;
+    }
+    ok = ok && seen_birth && seen_survive;
+  }
+
+  if (!ok) {
+    fprintf(stderr, "ERROR: invalid rule '%s', expected B/S notation like B3/S23\n", text);
+    return false;
+  }
+  *rule = r;
+  return true;
+}
+
+void liferule_format(LifeRule rule, char *out) {
+  *out++ = 'B';
+  for (int n = 0; n <= 8; ++n) {
+    if (rule.birth >> n & 1) *out++ = '0' + n;
+  }
+  *out++ = '/';
+  *out++ = 'S';
+  for (int n = 0; n <= 8; ++n) {
+    if (rule.survive >> n & 1) *out++ = '0' + n;
+  }
+  *out = '\0';
+}
+
+bool wolfram_parse(const char *text, uint8_t *rule) {
+  char *end;
+  long n = strtol(text, &end, 10);
+  if (*text == '\0' || *end != '\0' || n < 0 || n > 255) {
+    fprintf(stderr, "ERROR: invalid rule '%s', expected a Wolfram number from 0 to 255\n", text);
+    return false;
+  }
+  *rule = (uint8_t)n;
+  return true;
+}
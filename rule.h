@@ -0,0 +1,40 @@
+#ifndef RULE_H_
+#define RULE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* An outer totalistic rule on the Moore neighbourhood, like Life: a dead
+ * cell with n live neighbours is born if bit n of birth is set, and a live
+ * one survives if bit n of survive is. */
+typedef struct {
+  uint16_t birth;
+  uint16_t survive;
+} LifeRule;
+
+#define LIFE_RULE_CONWAY_BIRTH (1u << 3)
+#define LIFE_RULE_CONWAY_SURVIVE (1u << 2 | 1u << 3)
+
+/* Longest rule liferule_format writes, "B012345678/S012345678". */
+#define LIFE_RULE_TEXT_MAX 22
+
+static inline bool liferule_equal(LifeRule a, LifeRule b) {
+  return a.birth == b.birth && a.survive == b.survive;
+}
+
+/* Parse B/S notation, "B3/S23" for Life: B and the neighbour counts that
+ * give birth, S and the counts that survive, in either order and either
+ * case. The classic survive/birth form without letters, "23/3", is accepted
+ * as well. Prints the reason to stderr on failure. */
+bool liferule_parse(const char *text, LifeRule *rule);
+
+/* Write the rule in B/S notation into out, which has room for
+ * LIFE_RULE_TEXT_MAX bytes. */
+void liferule_format(LifeRule rule, char *out);
+
+/* Parse the Wolfram number of an elementary 1D rule, 0 to 255. Prints the
+ * reason to stderr on failure. */
+bool wolfram_parse(const char *text, uint8_t *rule);
+
+#endif // RULE_H_
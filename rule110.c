@@ -1,82 +1,575 @@
+#include <inttypes.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <time.h>
 
 #include <assert.h>
 
+#include "bitrow.h"
+#include "checkpoint.h"
+#include "config.h"
+#include "cycle.h"
+#include "ensemble.h"
+#include "ethertape.h"
+#include "perfstats.h"
+#include "randfill.h"
+#include "raster.h"
+#include "rule.h"
+#include "spacetime.h"
+#include "termview.h"
+
 #define ROW_SIZE 60
 #define LENGHT_SIZE 100
 
-char cell_image[2] = {
-  [0] = ' ',
-  [1] = '*'
-};
+/* Rows go out with one write each, or two per line in half block mode. */
+TermView term;
 
-typedef enum {
-  O = 0,
-  I = 1
-}Cell;
+/* The kernel of the elementary rule the tape runs, Rule 110 by default. */
+RowStepFn rule_step = bitrow_rule110;
 
-Cell patterns[8] = {
-  [0b000] = O,
-  [0b001] = I,
-  [0b010] = I,
-  [0b011] = I,
-  [0b100] = O,
-  [0b101] = I,
-  [0b110] = I,
-  [0b111] = O,
-};
+/* Every generation goes to the spacetime file and to the image of the
+ * spacetime diagram, if there are any. */
+SpacetimeWriter *spacetime = NULL;
+RasterImage *image = NULL;
 
-typedef struct {
-  Cell cells[ROW_SIZE];
-}Row;
+/* Timings of a batch run with --stats: the time of a generation, averaged
+ * over slices of STATS_SLICE of them as a row steps faster than the clock
+ * is read, and the time of a checkpoint. */
+#define STATS_SLICE 64
+enum { STATS_STEP, STATS_CHECKPOINT };
+const char *const stats_phases[] = {"step", "checkpoint"};
+PerfStats *stats = NULL;
 
-Row next_row(Row prev) {
-  Row next = {};
+/* The share of live cells in a random row, --density. */
+double density = 0.5;
 
-  for (int i = 1; i<ROW_SIZE-1; ++i) {
-    int pattern_index = prev.cells[i-1]<<2 | prev.cells[i]<<1 | prev.cells[i+1];
-    next.cells[i] = patterns[pattern_index];
+/* Compute the next row. The tape has fixed borders, so the first and last
+ * cells are pinned to dead whatever their neighbourhood is. */
+void next_row(const BitRow *prev, BitRow *next) {
+  rule_step(prev, next);
+  if (next->width > 0) {
+    bitrow_set(next, 0, false);
+    bitrow_set(next, next->width - 1, false);
   }
-
-  return next;
 }
  
-void print_row(Row row) {
-  putc('|', stdout);
-  for (int i=0; i< ROW_SIZE; ++i) {
-    putc(cell_image[row.cells[i]], stdout);
+void print_row(const BitRow *row) {
+  if (!termview_row(&term, row->bits, row->width)) {
+    fprintf(stderr, "ERROR: could not write to the terminal\n");
+    exit(1);
   }
-  putc('|', stdout);
-  putc('\n', stdout);
 }
 
-void line(void) {
-  for (int j=0; j<ROW_SIZE + 2; j++) { 
+void line(size_t width) {
+  for (size_t j=0; j<width + 2; j++) { 
     putc('-',stdout);
   }
   putc('\n',stdout);
 }
 
-Row random_row(void) {
-  Row result = {};
+/* The same seed gives the same row, however many threads fill it. */
+void random_row(BitRow *row, uint64_t seed) {
+  randfill(row->bits, row->width, 1, row->words, seed, density, 0);
+}
+
+/* Advance the tape by n generations, RULE110_LUT_STEPS at a time through
+ * the lookup table and the rest one by one. */
+void skip_rows(Tape *tape, const Rule110Lut *lut, size_t n) {
+  for (; n >= RULE110_LUT_STEPS; n -= RULE110_LUT_STEPS) {
+    rule110_lut_step(lut, tape_current(tape), tape_next(tape), next_row);
+    tape_swap(tape);
+  }
+  for (; n > 0; --n) {
+    next_row(tape_current(tape), tape_next(tape));
+    tape_swap(tape);
+  }
+}
+
+void record_row(const BitRow *row) {
+  if (spacetime != NULL && !spacetime_writer_append(spacetime, row->bits)) exit(1);
+  if (image != NULL && !raster_add_rows(image, row->bits, row->words, 1)) exit(1);
+}
+
+/* Advance the tape by up to n generations one at a time, feeding every one
+ * to the cycle detector, if any, and to the spacetime file and the image,
+ * and stop early once the run is periodic. Returns the number of generations done. */
+size_t watch_rows(Tape *tape, CycleDetector *cycle, size_t n) {
+  size_t done = 0;
+  while (done < n && (cycle == NULL || cycle->period == 0)) {
+    next_row(tape_current(tape), tape_next(tape));
+    tape_swap(tape);
+    done++;
+    record_row(tape_current(tape));
+    if (cycle != NULL) cycle_step(cycle, tape_next(tape)->bits, tape_current(tape)->bits);
+  }
+  return done;
+}
+
+/* Advance a batch run by up to n generations, like watch_rows if anything
+ * has to see every generation and like skip_rows otherwise, timing slices
+ * of them when timings are on. Returns the number of generations done. */
+size_t batch_rows(Tape *tape, const Rule110Lut *lut, CycleDetector *cycle, size_t n) {
+  bool watch = cycle != NULL || spacetime != NULL || image != NULL;
+  size_t done = 0;
+  while (done < n) {
+    size_t slice = n - done;
+    if (stats != NULL && slice > STATS_SLICE) slice = STATS_SLICE;
+    uint64_t start = stats != NULL ? perfstats_now() : 0;
+    size_t did = slice;
+    if (watch) did = watch_rows(tape, cycle, slice);
+    else skip_rows(tape, lut, slice);
+    if (stats != NULL && did > 0) {
+      perfstats_record(stats, STATS_STEP, (perfstats_now() - start) / did);
+      perfstats_add_generations(stats, did);
+      perfstats_poll(stats);
+    }
+    done += did;
+    if (did < slice) break;
+  }
+  return done;
+}
+
+/* Step the cells of a row of the width in ctx, for cycle_transient. */
+void step_cells(void *ctx, const uint64_t *prev, uint64_t *next) {
+  size_t width = *(const size_t *)ctx;
+  BitRow p = {width, bitrow_words(width), (uint64_t *)prev, false};
+  BitRow n = {width, bitrow_words(width), next, false};
+  next_row(&p, &n);
+}
+
+/* Work out the transient of a run found to be periodic and print both. */
+void report_cycle(const CycleDetector *cycle, size_t width) {
+  uint64_t transient;
+  if (!cycle_transient(cycle, step_cells, &width, &transient)) {
+    fprintf(stderr, "ERROR: could not allocate the rows to find the transient\n");
+    exit(1);
+  }
+  printf("cycle: transient %" PRIu64 " (from generation %" PRIu64 "), period %" PRIu64 "\n",
+         transient, cycle->start + transient, cycle->period);
+}
+
+/* Parse a positive size argument. */
+size_t parse_size(const char *arg) {
+  char *end;
+  long long value = strtoll(arg, &end, 10);
+  if (*end != '\0' || value <= 0) {
+    fprintf(stderr, "ERROR: invalid size '%s'\n", arg);
+    exit(1);
+  }
+  return (size_t)value;
+}
+
+/* Parse a density, the share of live cells from 0 to 1. */
+double parse_density(const char *arg) {
+  char *end;
+  double value = strtod(arg, &end);
+  if (*end != '\0' || end == arg || !(value >= 0 && value <= 1)) {
+    fprintf(stderr, "ERROR: invalid density '%s', it must be between 0 and 1\n", arg);
+    exit(1);
+  }
+  return value;
+}
+
+/* Save the current row of the tape to path. */
+bool save_checkpoint(const char *path, const BitRow *row, uint8_t rule, uint64_t generation, uint64_t seed) {
+  CheckpointHeader h = {0};
+  h.rule = rule;
+  h.width = row->width;
+  h.height = 1;
+  h.stride = row->words;
+  h.generation = generation;
+  h.seed = seed;
+  uint64_t start = perfstats_now();
+  bool ok = checkpoint_write(path, &h, row->bits);
+  if (stats != NULL) perfstats_record(stats, STATS_CHECKPOINT, perfstats_now() - start);
+  return ok;
+}
+
+/* Print the generations of a spacetime file from from on, or from its
+ * first one, every every of them, as if the run happened again, or draw
+ * them to an image if there is an image_path. */
+int run_replay(const char *path, uint64_t from, size_t length, size_t every, const char *image_path,
+               const RasterStyle *style) {
+  Spacetime st;
+  BitRow row;
+  if (!spacetime_open(&st, path)) return 1;
+  if (!bitrow_init(&row, st.header->width)) {
+    fprintf(stderr, "ERROR: could not allocate a row of %" PRIu64 " cells\n", st.header->width);
+    return 1;
+  }
+  if (from < st.header->first) from = st.header->first;
+  if (image_path != NULL) {
+    uint64_t end = st.header->first + st.generations;
+    uint64_t n = from < end ? end - from : 0;
+    if (n > length) n = length;
+    RasterImage *img = raster_new(image_path, row.width, n > 0 ? (n + every - 1) / every : 1, style);
+    if (img == NULL) return 1;
+    for (uint64_t j = 0; j < n && spacetime_read(&st, from + j, row.bits); j += every) {
+      if (!raster_add_rows(img, row.bits, row.words, 1)) break;
+    }
+    bitrow_free(&row);
+    spacetime_close(&st);
+    return raster_finish(img) ? 0 : 1;
+  }
+  line(row.width);
+  for (size_t j = 0; j < length && spacetime_read(&st, from + j, row.bits); j += every) {
+    print_row(&row);
+  }
+  termview_finish(&term);
+  line(row.width);
+  printf("%" PRIu64 " generations from %" PRIu64 " in %" PRIu64 " blocks, %zu bytes\n", st.generations,
+         st.header->first, st.blocks, st.size);
+  bitrow_free(&row);
+  spacetime_close(&st);
+  termview_free(&term);
+  return 0;
+}
+
+/* Run runs tapes side by side for length generations, run i seeded with
+ * seed + i exactly like a single tape with --seed, and print what became of
+ * each: its population, density, the binary entropy of that density and
+ * the first generation its middle cell was alive. */
+int run_ensemble(size_t width, size_t length, size_t runs, uint64_t seed) {
+  Ensemble e;
+  uint32_t *counts = malloc(((runs + 63) / 64) * 64 * sizeof(uint32_t));
+  if (counts == NULL || !ensemble_init(&e, width, runs, width / 2)) {
+    fprintf(stderr, "ERROR: could not allocate %zu tapes of %zu cells\n", runs, width);
+    free(counts); // ensemble_init frees what it took itself
+    return 1;
+  }
+  BitRow row;
+  if (!bitrow_init(&row, width)) {
+    fprintf(stderr, "ERROR: could not allocate a row of %zu cells\n", width);
+    ensemble_free(&e);
+    free(counts);
+    return 1;
+  }
+  for (size_t run = 0; run < runs; ++run) {
+    random_row(&row, seed + run);
+    for (size_t x = 0; x < width; ++x) ensemble_set(&e, run, x, bitrow_get(&row, x));
+  }
+  bitrow_free(&row);
+  ensemble_start(&e);
+  ensemble_step(&e, length);
+  ensemble_populations(&e, counts);
+
+  double total = 0;
+  size_t hits = 0;
+  printf("%-20s %10s %8s %8s %10s\n", "seed", "population", "density", "entropy", "first_hit");
+  for (size_t run = 0; run < runs; ++run) {
+    double p = (double)counts[run] / width;
+    double entropy = p > 0 && p < 1 ? -p * log2(p) - (1 - p) * log2(1 - p) : 0;
+    printf("%-20" PRIu64 " %10" PRIu32 " %8.4f %8.4f ", seed + run, counts[run], p, entropy);
+    if (e.first_hit[run] == UINT64_MAX) {
+      printf("%10s\n", "-");
+    } else {
+      printf("%10" PRIu64 "\n", e.first_hit[run]);
+      hits++;
+    }
+    total += p;
+  }
+  printf("generation %" PRIu64 ", %zu runs, mean density %.4f, %zu probe hits\n",
+         e.generation, runs, total / runs, hits);
+  free(counts);
+  ensemble_free(&e);
+  return 0;
+}
+
+/* Run the tape without edges: the random cells sit on an endless background
+ * of dead cells or of ether, and only the cells from 0 to width are shown,
+ * while the rest is kept as far as the light cone reaches. */
+int run_unbounded(size_t width, size_t length, size_t every, bool batch, uint64_t seed, uint8_t rule, uint16_t background) {
+  BitRow row;
+  EtherTape t;
+  if (!bitrow_init(&row, width)) {
+    fprintf(stderr, "ERROR: could not allocate a row of %zu cells\n", width);
+    return 1;
+  }
+  random_row(&row, seed);
+  if (!ethertape_init(&t, rule, background, 0, &row)) {
+    fprintf(stderr, "ERROR: could not allocate the unbounded tape\n");
+    bitrow_free(&row);
+    return 1;
+  }
 
-  for (int i=0; i< ROW_SIZE; ++i) {
-    result.cells[i] = rand() % 2;
+  if (!batch) line(width);
+  for (size_t done = 0; done < length;) {
+    size_t n = batch ? length - done : every;
+    if (!batch) {
+      ethertape_read(&t, 0, &row);
+      print_row(&row);
+    }
+    for (size_t g = 0; g < n; ++g) {
+      if (!ethertape_step(&t)) {
+        fprintf(stderr, "ERROR: could not grow the unbounded tape\n");
+        ethertape_free(&t);
+        bitrow_free(&row);
+        termview_free(&term);
+        return 1;
+      }
+    }
+    done += n;
+  }
+  if (batch) {
+    printf("generation %" PRIu64 ", %" PRIu64 " literal cells in %zu segments, %zu KiB\n",
+           t.generation, ethertape_literal_cells(&t), t.count, ethertape_memory(&t) / 1024);
+  } else {
+    termview_finish(&term);
+    line(width);
   }
-  return result;
+  ethertape_free(&t);
+  bitrow_free(&row);
+  termview_free(&term);
+  return 0;
 }
 
-int main() {
-  srand(time(0));
-  Row first = random_row();
-  line();
-  for (int j=0; j<LENGHT_SIZE; j++) { 
-    print_row(first);
-    first = next_row(first);
+void usage(const char *program) {
+  fprintf(stderr, "Usage: %s [--config <file>] [--rule N] [--every N] [--seed N] [--density P] [--half-blocks] [--batch]\n"
+                  "          [--checkpoint <file> [--checkpoint-every N]] [--resume <file>] [--cycles]\n"
+                  "          [--spacetime <file>] [--stats <file>] [--image <file> [--scale N] [--grid] [--threads N]]\n"
+                  "          [--replay <file> [--from N]] [--ensemble N] [--unbounded [--ether]]\n"
+                  "          [width] [generations]\n", program);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  size_t width = ROW_SIZE;
+  size_t length = LENGHT_SIZE;
+  size_t every = 1;
+  uint64_t seed = time(0);
+  bool seed_given = false;
+  bool batch = false;
+  const char *checkpoint_path = NULL;
+  size_t checkpoint_every = 0;
+  const char *resume_path = NULL;
+  bool detect_cycles = false;
+  uint8_t rule = 110;
+  size_t ensemble = 0;
+  bool unbounded = false;
+  uint16_t background = 0;
+  const char *spacetime_path = NULL;
+  const char *stats_path = NULL;
+  const char *image_path = NULL;
+  RasterStyle style = {1, false, 0};
+  const char *replay_path = NULL;
+  uint64_t from = 0;
+
+  // Positional arguments override the config file, whatever their order
+  size_t sizes[2];
+  int positional = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+      Config cfg;
+      if (!config_load(&cfg, argv[++i])) return 1;
+      config_get_size(&cfg, "width", &width);
+      config_get_size(&cfg, "generations", &length);
+      config_get_size(&cfg, "every", &every);
+      const char *value = config_get(&cfg, "rule");
+      if (value != NULL && !wolfram_parse(value, &rule)) return 1;
+      config_free(&cfg);
+    } else if (strcmp(argv[i], "--rule") == 0 && i + 1 < argc) {
+      if (!wolfram_parse(argv[++i], &rule)) return 1;
+    } else if (strcmp(argv[i], "--every") == 0 && i + 1 < argc) {
+      every = parse_size(argv[++i]);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      if (!randfill_parse_seed(argv[++i], &seed)) return 1;
+      seed_given = true;
+    } else if (strcmp(argv[i], "--density") == 0 && i + 1 < argc) {
+      density = parse_density(argv[++i]);
+    } else if (strcmp(argv[i], "--half-blocks") == 0) {
+      term.half_blocks = true;
+    } else if (strcmp(argv[i], "--batch") == 0) {
+      batch = true;
+    } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+      checkpoint_path = argv[++i];
+    } else if (strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) {
+      checkpoint_every = parse_size(argv[++i]);
+    } else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+      resume_path = argv[++i];
+    } else if (strcmp(argv[i], "--cycles") == 0) {
+      detect_cycles = true;
+    } else if (strcmp(argv[i], "--ensemble") == 0 && i + 1 < argc) {
+      ensemble = parse_size(argv[++i]);
+    } else if (strcmp(argv[i], "--spacetime") == 0 && i + 1 < argc) {
+      spacetime_path = argv[++i];
+    } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+      stats_path = argv[++i];
+    } else if (strcmp(argv[i], "--image") == 0 && i + 1 < argc) {
+      image_path = argv[++i];
+    } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+      style.scale = parse_size(argv[++i]);
+    } else if (strcmp(argv[i], "--grid") == 0) {
+      style.grid = true;
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      style.threads = parse_size(argv[++i]);
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+      from = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--unbounded") == 0) {
+      unbounded = true;
+    } else if (strcmp(argv[i], "--ether") == 0) {
+      background = ETHERTAPE_RULE110_ETHER;
+    } else if (positional < 2 && argv[i][0] != '-') {
+      sizes[positional++] = parse_size(argv[i]);
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (positional > 0) width = sizes[0];
+  if (positional > 1) length = sizes[1];
+
+  if (replay_path != NULL) return run_replay(replay_path, from, length, every, image_path, &style);
+
+  // Without --seed the random tape comes from the clock, printed so the run
+  // can be had again; a resumed tape has the seed of its checkpoint
+  if (!seed_given && resume_path == NULL) printf("Seed: %" PRIu64 "\n", seed);
+
+  // Many seeds at once, headless, each one only summed up at the end
+  if (ensemble > 0) {
+    if (rule != 110 || checkpoint_path != NULL || resume_path != NULL || detect_cycles || spacetime_path != NULL ||
+        stats_path != NULL || image_path != NULL) {
+      fprintf(stderr, "ERROR: --ensemble runs Rule 110 from seeds, without checkpoints, cycles, spacetime, timings\n"
+                      "       or images\n");
+      return 1;
+    }
+    return run_ensemble(width, length, ensemble, seed);
+  }
+
+  // No edges: the tape grows where the cells need it
+  if (unbounded) {
+    if (checkpoint_path != NULL || resume_path != NULL || detect_cycles || spacetime_path != NULL || stats_path != NULL ||
+        image_path != NULL) {
+      fprintf(stderr, "ERROR: --unbounded runs without checkpoints, cycle detection, spacetime, timings or images\n");
+      return 1;
+    }
+    return run_unbounded(width, length, every, batch, seed, rule, background);
+  }
+
+  // A checkpoint brings its own width, rule, generation and seed, and its
+  // row is stepped where it is mapped
+  Checkpoint ck = {0};
+  uint64_t generation = 0;
+  if (resume_path != NULL) {
+    if (!checkpoint_open(&ck, resume_path)) return 1;
+    if (ck.header->rule > 255 || ck.header->height != 1) {
+      fprintf(stderr, "ERROR: %s is not an elementary automaton checkpoint\n", resume_path);
+      return 1;
+    }
+    width = ck.header->width;
+    rule = (uint8_t)ck.header->rule;
+    generation = ck.header->generation;
+    seed = ck.header->seed;
+  }
+  rule_step = bitrow_elementary(rule);
+
+  Tape tape;
+  if (resume_path != NULL ? !tape_init_bits(&tape, width, ck.cells) : !tape_init(&tape, width)) {
+    fprintf(stderr, "ERROR: could not allocate a row of %zu cells\n", width);
+    return 1;
+  }
+
+  // Only built when rows are skipped, it takes a moment to fill
+  static Rule110Lut lut;
+  if (every > 1 || batch) elementary_lut_init(&lut, rule);
+
+  if (resume_path == NULL) random_row(tape_current(&tape), seed);
+
+  if (spacetime_path != NULL) {
+    SpacetimeHeader h = {0};
+    h.rule = rule;
+    h.width = width;
+    h.first = generation;
+    h.seed = seed;
+    if ((spacetime = spacetime_writer_new(spacetime_path, &h)) == NULL) return 1;
+    record_row(tape_current(&tape));
   }
-  line();
+
+  // The diagram has a row for the first generation and every one after it,
+  // a run that turns out periodic leaves the rest of them dead
+  if (image_path != NULL) {
+    if (!batch) {
+      fprintf(stderr, "ERROR: --image draws batch runs\n");
+      return 1;
+    }
+    if ((image = raster_new(image_path, width, (uint64_t)length + 1, &style)) == NULL) return 1;
+    record_row(tape_current(&tape));
+  }
+
+  if (stats_path != NULL) {
+    if (!batch) {
+      fprintf(stderr, "ERROR: --stats times batch runs\n");
+      return 1;
+    }
+    if ((stats = perfstats_new(stats_phases, 2, stats_path)) == NULL) return 1;
+  }
+
+  // With its borders pinned the tape only has so many states, every run
+  // ends up in a cycle
+  CycleDetector cycle;
+  if (detect_cycles && !cycle_init(&cycle, tape_current(&tape)->bits, tape_current(&tape)->words, generation)) {
+    fprintf(stderr, "ERROR: could not allocate the cycle detector\n");
+    return 1;
+  }
+
+  // Headless: run all the generations at full speed, checkpointing on the
+  // way, and stop as soon as the run turns out to be periodic
+  if (batch) {
+    for (size_t done = 0; done < length;) {
+      size_t n = length - done;
+      if (checkpoint_every > 0 && n > checkpoint_every) n = checkpoint_every;
+      n = batch_rows(&tape, &lut, detect_cycles ? &cycle : NULL, n);
+      done += n;
+      generation += n;
+      if (checkpoint_path != NULL && !save_checkpoint(checkpoint_path, tape_current(&tape), rule, generation, seed)) return 1;
+      if (detect_cycles && cycle.period > 0) break;
+    }
+    if (detect_cycles && cycle.period > 0) report_cycle(&cycle, width);
+    printf("generation %" PRIu64 ", population %zu\n", generation, bitrow_popcount(tape_current(&tape)));
+    if (detect_cycles) cycle_free(&cycle);
+    if (spacetime != NULL && !spacetime_writer_finish(spacetime)) return 1;
+    if (image != NULL && !raster_finish(image)) return 1;
+    if (stats != NULL) {
+      perfstats_poll(stats);
+      perfstats_report(stats, stdout);
+      if (!perfstats_finish(stats)) return 1;
+    }
+    tape_free(&tape);
+    checkpoint_close(&ck);
+    return 0;
+  }
+
+  line(width);
+  for (size_t j=0; j<length; j += every) { 
+    print_row(tape_current(&tape));
+    if ((detect_cycles && cycle.period == 0) || spacetime != NULL) {
+      // The detector and the spacetime file see every generation, rows
+      // skipped included
+      size_t done = watch_rows(&tape, detect_cycles && cycle.period == 0 ? &cycle : NULL, every);
+      if (spacetime != NULL) done += watch_rows(&tape, NULL, every - done);
+      skip_rows(&tape, &lut, every - done);
+    } else if (every == 1) {
+      next_row(tape_current(&tape), tape_next(&tape));
+      tape_swap(&tape);
+    } else {
+      skip_rows(&tape, &lut, every);
+    }
+    generation += every;
+  }
+  termview_finish(&term);
+  line(width);
+  if (detect_cycles) {
+    if (cycle.period > 0) report_cycle(&cycle, width);
+    cycle_free(&cycle);
+  }
+  if (checkpoint_path != NULL && !save_checkpoint(checkpoint_path, tape_current(&tape), rule, generation, seed)) return 1;
+  if (spacetime != NULL && !spacetime_writer_finish(spacetime)) return 1;
+
+  termview_free(&term);
+  tape_free(&tape);
+  checkpoint_close(&ck);
   return 0;
 }
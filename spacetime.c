@@ -0,0 +1,396 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "spacetime.h"
+
+typedef char spacetime_header_is_64_bytes[sizeof(SpacetimeHeader) == 64 ? 1 : -1];
+
+/* Literal runs only end at this many zero bytes, shorter gaps cost less
+ * inside the literal than as a run of their own. */
+#define MIN_ZERO_RUN 3
+
+/* The deltas a block is tried with, on every DELTA_SAMPLE-th row. */
+static const uint32_t deltas[] = {1, 7};
+#define DELTA_SAMPLE 16
+
+struct SpacetimeWriter {
+  FILE *f;
+  char *path;
+  SpacetimeHeader header;
+  size_t row_bytes;
+
+  // Stepper side: the block being filled
+  uint64_t *blocks[2];
+  int filling;
+  size_t rows;
+
+  // Handed over under the lock: the block to write and how many rows it has
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  bool pending;
+  int pending_block;
+  size_t pending_rows;
+  bool quit;
+  bool failed;
+
+  // Writer thread side
+  uint8_t *delta;
+  uint8_t *code;
+  uint64_t *offsets;
+  uint64_t count;
+  uint64_t capacity;
+  uint64_t generations;
+  uint64_t offset;
+};
+
+static size_t put_varint(uint8_t *out, uint64_t v) {
+  size_t n = 0;
+  for (; v >= 0x80; v >>= 7) out[n++] = (uint8_t)(v | 0x80);
+  out[n++] = (uint8_t)v;
+  return n;
+}
+
+/* Read a varint of the code that ends at end, NULL if it is cut short. */
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint64_t *v) {
+  *v = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    uint8_t b = *p++;
+    *v |= (uint64_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) return p;
+  }
+  return NULL;
+}
+
+/* Run-length code n bytes into out, which has room for rle_bound(n). */
+static size_t rle_bound(size_t n) {
+  return n + n / 2 + 32;
+}
+
+static size_t rle_encode(const uint8_t *in, size_t n, uint8_t *out) {
+  size_t i = 0, o = 0;
+  while (i < n) {
+    size_t start = i;
+    while (i < n && in[i] == 0) i++;
+    size_t zeros = i - start, literal = i;
+    while (i < n) {
+      if (in[i] != 0) {
+        i++;
+        continue;
+      }
+      size_t gap = i;
+      while (gap < n && in[gap] == 0 && gap - i < MIN_ZERO_RUN) gap++;
+      if (gap - i >= MIN_ZERO_RUN || gap == n) break;
+      i = gap;
+    }
+    o += put_varint(out + o, zeros);
+    o += put_varint(out + o, i - literal);
+    memcpy(out + o, in + literal, i - literal);
+    o += i - literal;
+  }
+  return o;
+}
+
+/* The delta that leaves the fewest words that are not zero in a sample of
+ * the rows of the block. */
+static uint32_t pick_delta(const uint64_t *block, size_t rows, size_t words) {
+  uint32_t best = deltas[0];
+  uint64_t best_words = UINT64_MAX;
+  for (size_t d = 0; d < sizeof(deltas) / sizeof(deltas[0]); ++d) {
+    uint64_t count = 0;
+    for (size_t r = deltas[d]; r < rows; r += DELTA_SAMPLE) {
+      const uint64_t *row = block + r * words, *back = row - deltas[d] * words;
+      for (size_t i = 0; i < words; ++i) count += row[i] != back[i];
+    }
+    if (count < best_words) {
+      best = deltas[d];
+      best_words = count;
+    }
+  }
+  return best;
+}
+
+/* XOR every row of the block with the one delta generations before it,
+ * code it and write it. */
+static bool write_block(SpacetimeWriter *w, const uint64_t *block, size_t rows) {
+  size_t row_bytes = w->row_bytes, words = row_bytes / sizeof(uint64_t);
+  uint64_t *delta = (uint64_t *)w->delta;
+  SpacetimeBlock b = {0};
+  b.rows = (uint32_t)rows;
+  b.delta = pick_delta(block, rows, words);
+  size_t back = b.delta * words, head = back < rows * words ? back : rows * words;
+  memcpy(delta, block, head * sizeof(uint64_t));
+  for (size_t i = head; i < rows * words; ++i) delta[i] = block[i] ^ block[i - back];
+  b.bytes = rle_encode(w->delta, rows * row_bytes, w->code);
+
+  if (w->count == w->capacity) {
+    uint64_t capacity = w->capacity ? 2 * w->capacity : 64;
+    uint64_t *offsets = realloc(w->offsets, capacity * sizeof(uint64_t));
+    if (offsets == NULL) return false;
+    w->offsets = offsets;
+    w->capacity = capacity;
+  }
+  w->offsets[w->count++] = w->offset;
+  w->generations += rows;
+  w->offset += sizeof(b) + b.bytes;
+  return fwrite(&b, sizeof(b), 1, w->f) == 1 && fwrite(w->code, 1, b.bytes, w->f) == b.bytes;
+}
+
+static void *writer_main(void *arg) {
+  SpacetimeWriter *w = arg;
+  pthread_mutex_lock(&w->lock);
+  for (;;) {
+    while (!w->pending && !w->quit) pthread_cond_wait(&w->changed, &w->lock);
+    if (!w->pending) break;
+    const uint64_t *block = w->blocks[w->pending_block];
+    size_t rows = w->pending_rows;
+    pthread_mutex_unlock(&w->lock);
+
+    bool ok = write_block(w, block, rows);
+
+    pthread_mutex_lock(&w->lock);
+    if (!ok) w->failed = true;
+    w->pending = false;
+    pthread_cond_broadcast(&w->changed);
+  }
+  pthread_mutex_unlock(&w->lock);
+  return NULL;
+}
+
+/* Hand the block being filled to the writer thread, waiting only if it is
+ * still busy with the other one. */
+static bool hand_over(SpacetimeWriter *w) {
+  pthread_mutex_lock(&w->lock);
+  while (w->pending) pthread_cond_wait(&w->changed, &w->lock);
+  bool ok = !w->failed;
+  w->pending = true;
+  w->pending_block = w->filling;
+  w->pending_rows = w->rows;
+  pthread_cond_broadcast(&w->changed);
+  pthread_mutex_unlock(&w->lock);
+  w->filling = !w->filling;
+  w->rows = 0;
+  return ok;
+}
+
+static void writer_free(SpacetimeWriter *w) {
+  if (w->f != NULL) fclose(w->f);
+  free(w->path);
+  free(w->blocks[0]);
+  free(w->blocks[1]);
+  free(w->delta);
+  free(w->code);
+  free(w->offsets);
+  free(w);
+}
+
+SpacetimeWriter *spacetime_writer_new(const char *path, const SpacetimeHeader *header) {
+  SpacetimeWriter *w = calloc(1, sizeof(*w));
+  if (w == NULL) return NULL;
+  w->header = *header;
+  memcpy(w->header.magic, SPACETIME_MAGIC, sizeof(w->header.magic));
+  w->header.header_size = sizeof(SpacetimeHeader);
+  w->header.stride = (header->width + 63) / 64;
+  w->header.index = 0;
+  w->row_bytes = w->header.stride * sizeof(uint64_t);
+  size_t rows = w->row_bytes ? SPACETIME_BLOCK_BYTES / w->row_bytes : 1;
+  w->header.block_rows = rows > 1 ? (uint32_t)(rows < UINT32_MAX ? rows : UINT32_MAX) : 1;
+
+  size_t block_bytes = w->header.block_rows * w->row_bytes;
+  w->path = malloc(strlen(path) + 1);
+  w->blocks[0] = malloc(block_bytes);
+  w->blocks[1] = malloc(block_bytes);
+  w->delta = malloc(block_bytes);
+  w->code = malloc(rle_bound(block_bytes));
+  if (w->path == NULL || w->blocks[0] == NULL || w->blocks[1] == NULL || w->delta == NULL || w->code == NULL) {
+    fprintf(stderr, "ERROR: could not allocate the spacetime blocks\n");
+    writer_free(w);
+    return NULL;
+  }
+  strcpy(w->path, path);
+
+  w->f = fopen(path, "wb");
+  if (w->f == NULL || fwrite(&w->header, sizeof(w->header), 1, w->f) != 1) {
+    fprintf(stderr, "ERROR: could not write spacetime %s: %s\n", path, strerror(errno));
+    writer_free(w);
+    return NULL;
+  }
+  w->offset = sizeof(w->header);
+
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->changed, NULL);
+  if (pthread_create(&w->thread, NULL, writer_main, w) != 0) {
+    fprintf(stderr, "ERROR: could not start the spacetime writer thread\n");
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->changed);
+    writer_free(w);
+    return NULL;
+  }
+  return w;
+}
+
+bool spacetime_writer_append(SpacetimeWriter *w, const uint64_t *row) {
+  memcpy((uint8_t *)w->blocks[w->filling] + w->rows * w->row_bytes, row, w->row_bytes);
+  if (++w->rows < w->header.block_rows) return true;
+  if (hand_over(w)) return true;
+  fprintf(stderr, "ERROR: could not write spacetime %s\n", w->path);
+  return false;
+}
+
+bool spacetime_writer_finish(SpacetimeWriter *w) {
+  bool ok = w->rows == 0 || hand_over(w);
+  pthread_mutex_lock(&w->lock);
+  w->quit = true;
+  pthread_cond_broadcast(&w->changed);
+  pthread_mutex_unlock(&w->lock);
+  pthread_join(w->thread, NULL);
+  pthread_mutex_destroy(&w->lock);
+  pthread_cond_destroy(&w->changed);
+  ok = ok && !w->failed;
+
+  // The index goes last and the header learns where it is, so a file that
+  // has an index is complete
+  SpacetimeIndex index = {w->count, w->generations};
+  w->header.index = w->offset;
+  ok = ok && fwrite(&index, sizeof(index), 1, w->f) == 1 &&
+       fwrite(w->offsets, sizeof(uint64_t), w->count, w->f) == w->count &&
+       fseek(w->f, 0, SEEK_SET) == 0 && fwrite(&w->header, sizeof(w->header), 1, w->f) == 1 &&
+       fflush(w->f) == 0;
+  ok = fclose(w->f) == 0 && ok;
+  w->f = NULL;
+  if (!ok) fprintf(stderr, "ERROR: could not write spacetime %s: %s\n", w->path, strerror(errno));
+  writer_free(w);
+  return ok;
+}
+
+/* The block at offset, copied out as the records of the file sit at any
+ * byte. False if it does not fit in the file. */
+static bool get_block(const Spacetime *st, uint64_t offset, SpacetimeBlock *b) {
+  if (offset > st->size || st->size - offset < sizeof(*b)) return false;
+  memcpy(b, (const uint8_t *)st->map + offset, sizeof(*b));
+  return b->bytes <= st->size - offset - sizeof(*b) && b->rows > 0 && b->delta > 0 &&
+         b->delta <= SPACETIME_MAX_DELTA;
+}
+
+/* Find the blocks of a file without an index by walking them, up to the
+ * first one that is cut short. */
+static bool scan_blocks(Spacetime *st) {
+  uint64_t capacity = 64, offset = sizeof(SpacetimeHeader);
+  st->offsets = malloc(capacity * sizeof(uint64_t));
+  if (st->offsets == NULL) return false;
+  SpacetimeBlock b;
+  while (get_block(st, offset, &b)) {
+    if (st->blocks == capacity) {
+      capacity *= 2;
+      uint64_t *offsets = realloc(st->offsets, capacity * sizeof(uint64_t));
+      if (offsets == NULL) return false;
+      st->offsets = offsets;
+    }
+    st->offsets[st->blocks++] = offset;
+    st->generations += b.rows;
+    offset += sizeof(b) + b.bytes;
+  }
+  return true;
+}
+
+/* Copy the offsets out of the index at the end of a complete file. False if
+ * there is none or it does not fit in the file. */
+static bool read_index(Spacetime *st) {
+  const SpacetimeHeader *h = st->header;
+  SpacetimeIndex index;
+  if (h->index == 0 || h->index > st->size || st->size - h->index < sizeof(index)) return false;
+  memcpy(&index, (const uint8_t *)st->map + h->index, sizeof(index));
+  if (index.blocks > (st->size - h->index - sizeof(index)) / sizeof(uint64_t)) return false;
+  st->offsets = malloc((index.blocks ? index.blocks : 1) * sizeof(uint64_t));
+  if (st->offsets == NULL) return false;
+  memcpy(st->offsets, (const uint8_t *)st->map + h->index + sizeof(index), index.blocks * sizeof(uint64_t));
+  st->blocks = index.blocks;
+  st->generations = index.generations;
+  return true;
+}
+
+bool spacetime_open(Spacetime *st, const char *path) {
+  memset(st, 0, sizeof(*st));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "ERROR: could not open spacetime %s: %s\n", path, strerror(errno));
+    return false;
+  }
+  struct stat sb;
+  if (fstat(fd, &sb) != 0 || (size_t)sb.st_size < sizeof(SpacetimeHeader)) {
+    fprintf(stderr, "ERROR: %s is not a spacetime file\n", path);
+    close(fd);
+    return false;
+  }
+  st->size = sb.st_size;
+  st->map = mmap(NULL, st->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (st->map == MAP_FAILED) {
+    fprintf(stderr, "ERROR: could not map spacetime %s: %s\n", path, strerror(errno));
+    st->map = NULL;
+    return false;
+  }
+
+  const SpacetimeHeader *h = st->map;
+  if (memcmp(h->magic, SPACETIME_MAGIC, sizeof(h->magic)) != 0 || h->header_size != sizeof(*h) ||
+      h->stride != (h->width + 63) / 64 || h->block_rows == 0) {
+    fprintf(stderr, "ERROR: %s is not a spacetime file of this version and byte order\n", path);
+    spacetime_close(st);
+    return false;
+  }
+  st->header = h;
+  if (!read_index(st) && !scan_blocks(st)) {
+    fprintf(stderr, "ERROR: could not allocate the index of %s\n", path);
+    spacetime_close(st);
+    return false;
+  }
+  return true;
+}
+
+void spacetime_close(Spacetime *st) {
+  if (st->map != NULL) munmap(st->map, st->size);
+  free(st->offsets);
+  memset(st, 0, sizeof(*st));
+}
+
+bool spacetime_read(const Spacetime *st, uint64_t generation, uint64_t *row) {
+  const SpacetimeHeader *h = st->header;
+  if (generation < h->first || generation - h->first >= st->generations) return false;
+  uint64_t k = (generation - h->first) / h->block_rows;
+  size_t r = (generation - h->first) % h->block_rows;
+  SpacetimeBlock b;
+  if (k >= st->blocks || !get_block(st, st->offsets[k], &b) || r >= b.rows) return false;
+  const uint8_t *p = (const uint8_t *)st->map + st->offsets[k] + sizeof(b), *end = p + b.bytes;
+
+  // Every decoded byte is XORed into a ring of delta rows, where a row
+  // lands on the one delta generations before it, so the ring goes through
+  // the generations of the block until the one wanted is complete
+  size_t row_bytes = h->stride * sizeof(uint64_t), ring_bytes = b.delta * row_bytes;
+  uint8_t *ring = b.delta == 1 ? (uint8_t *)row : calloc(b.delta, row_bytes);
+  if (ring == NULL) return false;
+  if (b.delta == 1) memset(ring, 0, row_bytes);
+  uint64_t pos = 0, stop = (uint64_t)(r + 1) * row_bytes;
+  while (pos < stop) {
+    uint64_t zeros, literal;
+    if ((p = get_varint(p, end, &zeros)) == NULL || (p = get_varint(p, end, &literal)) == NULL ||
+        literal > (uint64_t)(end - p)) {
+      break;
+    }
+    pos += zeros;
+    for (uint64_t i = 0; i < literal && pos < stop; ++i, ++pos) ring[pos % ring_bytes] ^= p[i];
+    p += literal;
+  }
+  if (ring != (uint8_t *)row) {
+    memcpy(row, ring + (r % b.delta) * row_bytes, row_bytes);
+    free(ring);
+  }
+  return pos >= stop;
+}
@@ -0,0 +1,92 @@
+#ifndef SPACETIME_H_
+#define SPACETIME_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPACETIME_MAGIC "CATOMST2"
+
+/* About this many bytes of raw rows go into a block. */
+#define SPACETIME_BLOCK_BYTES (1 << 20)
+
+/* The most generations back a row may be XORed with. */
+#define SPACETIME_MAX_DELTA 16
+
+/* A spacetime file holds every generation of a 1D run. After this header
+ * come blocks of up to block_rows generations, each one a SpacetimeBlock
+ * followed by its code, and at the end an index of the blocks. Within a
+ * block every row is XORed with the one delta generations before it, the
+ * first delta rows with nothing, so a block decodes on its own, and the
+ * resulting bytes are run-length coded: a LEB128 count of zero bytes, a
+ * LEB128 count of literal bytes and the literal bytes, over and over. Rows
+ * are laid out as in a checkpoint, stride words in the byte order of the
+ * machine. Nothing in the file is aligned. */
+typedef struct {
+  char magic[8];
+  uint32_t header_size;
+  uint32_t rule;
+  uint64_t width;
+  uint64_t stride;
+  uint64_t first; // the generation of the first row
+  uint64_t seed;
+  uint32_t block_rows;
+  uint32_t reserved;
+  uint64_t index; // offset of the index, 0 until the file is complete
+} SpacetimeHeader;
+
+/* The writer picks the delta of every block: the previous row where the
+ * tape changes slowly, 7 generations back where it is mostly the period 7
+ * ether of Rule 110, which moves on every generation but comes back to the
+ * same cells. */
+typedef struct {
+  uint32_t rows;
+  uint32_t delta;
+  uint64_t bytes; // of code after this
+} SpacetimeBlock;
+
+/* The index is the number of blocks, the number of generations and the
+ * offset of every block. */
+typedef struct {
+  uint64_t blocks;
+  uint64_t generations;
+  uint64_t offsets[];
+} SpacetimeIndex;
+
+/* Rows go to a block in memory and every full block to a thread of its own,
+ * which codes and writes it while the next block fills up, so the stepper
+ * only copies rows. */
+typedef struct SpacetimeWriter SpacetimeWriter;
+
+/* Start a file at path for rows of the width, rule, first generation and
+ * seed in header. Prints the reason to stderr on failure. */
+SpacetimeWriter *spacetime_writer_new(const char *path, const SpacetimeHeader *header);
+
+/* Add the next generation. Fails once writing the file has failed. */
+bool spacetime_writer_append(SpacetimeWriter *w, const uint64_t *row);
+
+/* Write what is left and the index and close the file. Returns false if
+ * anything went wrong on the way, after printing the reason. */
+bool spacetime_writer_finish(SpacetimeWriter *w);
+
+/* A spacetime file mapped into memory. A file whose writer never finished
+ * has no index; its blocks are then found by walking them. */
+typedef struct {
+  void *map;
+  size_t size;
+  const SpacetimeHeader *header;
+  uint64_t *offsets; // copied from the index or found by walking the blocks
+  uint64_t blocks;
+  uint64_t generations;
+} Spacetime;
+
+/* Prints the reason to stderr on failure. */
+bool spacetime_open(Spacetime *st, const char *path);
+void spacetime_close(Spacetime *st);
+
+/* Decode the row of a generation into row, stride words. Only the rows of
+ * its block up to it are decoded. Returns false if the generation is not
+ * in the file or its block is corrupt. */
+bool spacetime_read(const Spacetime *st, uint64_t generation, uint64_t *row);
+
+#endif // SPACETIME_H_
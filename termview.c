@@ -0,0 +1,197 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "termview.h"
+
+/* Skipping over unchanged cells costs a cursor move of about 8 bytes, so
+ * gaps shorter than that are cheaper to send again. */
+#define TERMVIEW_MAX_GAP 8
+
+/* Glyphs indexed by the top cell plus twice the bottom cell. */
+static const char *glyphs[2][4] = {
+  {" ", "*"},
+  {" ", "▀", "▄", "█"},
+};
+
+static bool reserve(TermView *v, size_t extra) {
+  if (v->len + extra <= v->cap) return true;
+  size_t cap = v->cap ? v->cap : 4096;
+  while (cap < v->len + extra) cap *= 2;
+  char *buf = realloc(v->buf, cap);
+  if (buf == NULL) return false;
+  v->buf = buf;
+  v->cap = cap;
+  return true;
+}
+
+static void put(TermView *v, const char *s, size_t n) {
+  memcpy(v->buf + v->len, s, n);
+  v->len += n;
+}
+
+static void put_str(TermView *v, const char *s) {
+  put(v, s, strlen(s));
+}
+
+static void move_to(TermView *v, size_t row, size_t col) {
+  v->len += snprintf(v->buf + v->len, 32, "\x1b[%zu;%zuH", row, col);
+}
+
+/* Send the buffer in one write, after whatever stdio still holds, so lines
+ * printed with printf between frames come out in order. */
+static bool flush(TermView *v) {
+  fflush(stdout);
+  const char *p = v->buf;
+  size_t left = v->len;
+  while (left > 0) {
+    ssize_t n = write(STDOUT_FILENO, p, left);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    p += n;
+    left -= n;
+  }
+  v->len = 0;
+  return true;
+}
+
+static inline unsigned cell(const uint64_t *cells, size_t stride, size_t x, size_t y) {
+  return (cells[y * stride + x / 64] >> (x % 64)) & 1;
+}
+
+/* The glyph index of character x of text line y. */
+static inline uint8_t glyph_at(const TermView *v, const uint64_t *cells, size_t stride, size_t x, size_t y) {
+  if (!v->half_blocks) return cell(cells, stride, x, y);
+  unsigned top = cell(cells, stride, x, 2 * y);
+  unsigned bottom = 2 * y + 1 < v->height ? cell(cells, stride, x, 2 * y + 1) : 0;
+  return top | bottom << 1;
+}
+
+static size_t text_lines(const TermView *v) {
+  return v->half_blocks ? (v->height + 1) / 2 : v->height;
+}
+
+void termview_free(TermView *v) {
+  free(v->shown);
+  free(v->buf);
+  free(v->pending);
+  v->shown = NULL;
+  v->buf = NULL;
+  v->pending = NULL;
+  v->width = v->height = v->len = v->cap = 0;
+}
+
+void termview_invalidate(TermView *v) {
+  v->width = v->height = 0;
+}
+
+static void border(TermView *v) {
+  put_str(v, "|");
+  memset(v->buf + v->len, '-', v->width);
+  v->len += v->width;
+  put_str(v, "|\n");
+}
+
+bool termview_frame(TermView *v, const uint64_t *cells, size_t stride, size_t width, size_t height) {
+  bool full = v->width != width || v->height != height || v->shown == NULL;
+  if (full) {
+    v->width = width;
+    v->height = height;
+    free(v->shown);
+    v->shown = malloc(width * text_lines(v));
+    if (v->shown == NULL) {
+      termview_invalidate(v);
+      return false;
+    }
+  }
+
+  size_t lines = text_lines(v);
+  const char **glyph = glyphs[v->half_blocks];
+  // Glyphs are up to 3 bytes of UTF-8, a cursor move is under 32 bytes
+  size_t line_bytes = width * (3 + 32) + 64;
+
+  if (full) {
+    if (!reserve(v, 2 * line_bytes)) return false;
+    put_str(v, "\x1b[H\x1b[J");
+    border(v);
+    for (size_t y = 0; y < lines; ++y) {
+      if (!reserve(v, line_bytes)) return false;
+      put_str(v, "|");
+      for (size_t x = 0; x < width; ++x) {
+        uint8_t g = glyph_at(v, cells, stride, x, y);
+        v->shown[y * width + x] = g;
+        put_str(v, glyph[g]);
+      }
+      put_str(v, "|\n");
+    }
+    if (!reserve(v, line_bytes)) return false;
+    border(v);
+    return flush(v);
+  }
+
+  for (size_t y = 0; y < lines; ++y) {
+    if (!reserve(v, line_bytes)) return false;
+    uint8_t *shown = v->shown + y * width;
+    size_t cursor = SIZE_MAX; // column the terminal cursor is at on this line
+    for (size_t x = 0; x < width; ++x) {
+      uint8_t g = glyph_at(v, cells, stride, x, y);
+      if (g == shown[x]) continue;
+      if (cursor <= x && x - cursor <= TERMVIEW_MAX_GAP) {
+        for (; cursor < x; ++cursor) put_str(v, glyph[shown[cursor]]);
+      } else {
+        // The frame starts with the border on line 1 and column 1
+        move_to(v, y + 2, x + 2);
+      }
+      put_str(v, glyph[g]);
+      shown[x] = g;
+      cursor = x + 1;
+    }
+  }
+  if (!reserve(v, 64)) return false;
+  move_to(v, lines + 3, 1);
+  put_str(v, "\x1b[J");
+  return flush(v);
+}
+
+static bool print_line(TermView *v, const uint64_t *top, const uint64_t *bottom, size_t width) {
+  const char **glyph = glyphs[v->half_blocks];
+  if (!reserve(v, width * 3 + 3)) return false;
+  put_str(v, "|");
+  for (size_t x = 0; x < width; ++x) {
+    unsigned g = cell(top, 0, x, 0) | (bottom ? cell(bottom, 0, x, 0) << 1 : 0);
+    put_str(v, glyph[g]);
+  }
+  put_str(v, "|\n");
+  return flush(v);
+}
+
+bool termview_row(TermView *v, const uint64_t *bits, size_t width) {
+  if (!v->half_blocks) return print_line(v, bits, NULL, width);
+  if (v->has_pending) {
+    v->has_pending = false;
+    return print_line(v, v->pending, bits, width);
+  }
+
+  size_t words = (width + 63) / 64;
+  if (v->pending_words < words) {
+    uint64_t *pending = realloc(v->pending, words * sizeof(uint64_t));
+    if (pending == NULL) return false;
+    v->pending = pending;
+    v->pending_words = words;
+  }
+  memcpy(v->pending, bits, words * sizeof(uint64_t));
+  v->pending_width = width;
+  v->has_pending = true;
+  return true;
+}
+
+bool termview_finish(TermView *v) {
+  if (!v->has_pending) return true;
+  v->has_pending = false;
+  return print_line(v, v->pending, NULL, v->pending_width);
+}
@@ -0,0 +1,46 @@
+#ifndef TERMVIEW_H_
+#define TERMVIEW_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A terminal renderer for bit-packed cells, laid out as rows of stride words
+ * with cell x of a row in bit x%64 of word x/64 (a LifeGrid or a BitRow).
+ * Each frame is built into one reusable buffer and sent with a single write.
+ * The renderer remembers what is on screen and only sends cursor moves and
+ * the cells that changed since the last frame. In half block mode every
+ * character shows two cells stacked on top of each other. Zero-initialize
+ * it and set half_blocks before the first frame. */
+typedef struct {
+  bool half_blocks;
+  size_t width;
+  size_t height;
+  uint8_t *shown;
+  char *buf;
+  size_t len;
+  size_t cap;
+  uint64_t *pending;
+  size_t pending_words;
+  size_t pending_width;
+  bool has_pending;
+} TermView;
+
+void termview_free(TermView *v);
+
+/* Draw the cells as a frame with a border at the top of the screen and leave
+ * the cursor under it, with anything below the frame cleared. The first
+ * frame, and the first one after the size changes, clears the screen and is
+ * drawn in full. Returns false if the frame could not be written. */
+bool termview_frame(TermView *v, const uint64_t *cells, size_t stride, size_t width, size_t height);
+
+/* Forget what is on screen, so the next frame is drawn in full. */
+void termview_invalidate(TermView *v);
+
+/* Print a row of cells as a line of its own with a single write. In half
+ * block mode rows are paired up, every second call prints the line with both
+ * and termview_finish prints a row still waiting for its pair. */
+bool termview_row(TermView *v, const uint64_t *bits, size_t width);
+bool termview_finish(TermView *v);
+
+#endif // TERMVIEW_H_
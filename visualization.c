@@ -1,16 +1,25 @@
+#define _DEFAULT_SOURCE
 #include <assert.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <math.h>
 #include <time.h>
 
 #define GLFW_INCLUDE_GLEXT
 #include <GLFW/glfw3.h>
 
+#include "bitrow.h"
+#include "history.h"
+#include "perfstats.h"
+#include "randfill.h"
+#include "rowqueue.h"
+
 #define DEFAULT_SCREEN_WIDTH 1200
 #define DEFAULT_SCREEN_HEIGHT 800
 #define MANUAL_TIME_STEP 0.05
@@ -36,25 +45,19 @@ V2f v2f_scale(V2f a, float s) { return v2f(a.x * s, a.y * s); }
 #define COLS 120
 #define CELL_SIZE 8.0f
 
-typedef enum {
-    O = 0,
-    I = 1
-} Cell;
-
-// Rule 110 patterns
-Cell patterns[8] = {
-    [0b000] = O, [0b001] = I, [0b010] = I, [0b011] = I,
-    [0b100] = O, [0b101] = I, [0b110] = I, [0b111] = O,
-};
-
-typedef struct {
-    Cell cells[COLS];
-} Row;
+// Memory the whole history of the run may take, coarser levels take over
+// for the oldest generations once it is used up
+#define HISTORY_BUDGET (64 * 1024 * 1024)
+#define HISTORY_MAX_ZOOM_IN 4
 
+// The rows are a ring: screen row i lives in slot (head + i) % ROWS, so
+// scrolling overwrites the oldest slot and moves head instead of the rows
 typedef struct {
-    Row rows[ROWS];
+    BitRow rows[ROWS];
+    int head;
     int current_row;
-    int generation;
+    uint64_t generation;
+    int dirty_begin, dirty_count; // slots not yet uploaded to the board texture, wrapping around
 } Board;
 
 // OpenGL types
@@ -70,18 +73,71 @@ typedef struct {
     GLuint vao;
     GLuint vbo;
     GLuint program;
-    GLint uniforms[4]; // resolution, time, mouse, tex
+    GLuint board_tex;
+    GLint uniforms[8]; // resolution, time, mouse, tex, board_size, visible_rows, show_grid, head
+    GLuint history_program;
+    GLuint history_tex;
+    GLint history_uniforms[2]; // resolution, tex
+    GLuint hud_program;
+    GLint hud_uniforms[1]; // resolution
     size_t vertex_buf_sz;
     Vertex vertex_buf[VERTEX_BUF_CAP];
 } Renderer;
 
+// The automaton runs on a thread of its own with a board of its own and
+// sends every new row to the render thread through the queue. The controls
+// are only ever written by the render thread, all fields besides the board,
+// in_sync and seed are accessed atomically.
+#define QUEUE_ROWS (4 * ROWS)
+typedef struct {
+    Board board;
+    RowQueue queue;
+    bool in_sync; // every row so far went into the queue
+    uint64_t seed; // of the board, the next reset takes the one after it
+    pthread_t thread;
+    bool running;
+    bool paused;
+    bool reset;
+    int steps; // single steps asked for while paused
+    uint64_t generation_ns;
+    History *history; // every generation since the last reset
+    PerfStats *stats; // the step phase is timed on the simulation thread
+} Simulation;
+
+// The phases of a frame and of a generation, timed every time they run.
+// GL calls only queue work for the GPU, so upload and present are what the
+// CPU spends handing it over, and present also takes up the GPU catching up
+// and the wait for the vertical blank.
+enum { PHASE_STEP, PHASE_BUILD, PHASE_UPLOAD, PHASE_PRESENT, PHASES };
+static const char *const phase_names[PHASES] = {"step", "build", "upload", "present"};
+
+// The history view shows the whole run from the history pyramid instead of
+// the last ROWS generations. zoom is the level shown, each texel of it
+// drawn as one pixel, or as 2^-zoom pixels when zoom is negative. x and y
+// are the cell and generation at the top left corner.
+typedef struct {
+    bool enabled;
+    int zoom;
+    int64_t x, y;
+    bool follow; // keep the newest generations at the bottom
+    int64_t span_x, span_y; // cells and generations on screen in the last frame
+    uint8_t *texels;
+    size_t texels_cap;
+    // What the texture holds, so it is only fetched again when it changes
+    int level, texel_px, cols, rows;
+    int64_t tx, ty;
+    uint64_t generations;
+} HistoryView;
+
 // Global state
 static Board board = {0};
+static Simulation sim = {0};
 static Renderer renderer = {0};
-static double time_accumulator = 0.0;
+static HistoryView view = {.follow = true, .level = -1};
 static double generation_time = 0.15; // Time between generations
 static bool paused = false;
 static bool show_grid = true;
+static bool show_hud = false;
 
 // GL extension function pointers
 static void (*glGenVertexArrays)(GLsizei n, GLuint *arrays) = NULL;
@@ -181,13 +237,41 @@ bool load_shader_program(Renderer *r) {
         "    fragColor = aColor;\n"
         "}\n";
 
+    // The board is one quad over the whole window. Every texel of tex holds
+    // 32 cells of a row exactly as the BitRow stores them, the shader picks
+    // the bit of the cell under the fragment and draws the grid lines on top.
     const char *fragment_source = 
         "#version 330 core\n"
         "in vec2 fragUV;\n"
         "in vec4 fragColor;\n"
+        "uniform vec2 resolution;\n"
+        "uniform usampler2D tex;\n"
+        "uniform ivec2 board_size;\n"
+        "uniform int visible_rows;\n"
+        "uniform bool show_grid;\n"
+        "uniform int head;\n"
         "out vec4 finalColor;\n"
         "void main() {\n"
-        "    finalColor = fragColor;\n"
+        "    vec2 cell = fragUV * vec2(board_size);\n"
+        "    ivec2 c = min(ivec2(cell), board_size - 1);\n"
+        "    bool alive = false;\n"
+        "    if (c.y < visible_rows) {\n"
+        "        int slot = (head + c.y) % board_size.y;\n"
+        "        uint bits = texelFetch(tex, ivec2(c.x / 32, slot), 0).r;\n"
+        "        alive = ((bits >> uint(c.x % 32)) & 1u) != 0u;\n"
+        "    }\n"
+        "    vec4 color = alive ? fragColor : vec4(0.0);\n"
+        "    vec2 cell_px = resolution / vec2(board_size);\n"
+        "    if (show_grid && cell_px.x > 2.0 && cell_px.y > 2.0) {\n"
+        "        vec4 grid = vec4(0.2, 0.2, 0.2, 0.3);\n"
+        "        vec2 spacing = vec2(cell_px.x < 4.0 ? 5.0 : 1.0, cell_px.y < 4.0 ? 5.0 : 1.0);\n"
+        "        vec2 nearest = spacing * round(cell / spacing);\n"
+        "        vec2 dist = abs(cell - nearest) * cell_px;\n"
+        "        if (dist.x < 0.5 || (dist.y < 0.5 && nearest.y < float(visible_rows))) {\n"
+        "            color = alive ? vec4(mix(color.rgb, grid.rgb, grid.a), 1.0) : grid;\n"
+        "        }\n"
+        "    }\n"
+        "    finalColor = color;\n"
         "}\n";
 
     GLuint vert_shader, frag_shader;
@@ -206,58 +290,269 @@ bool load_shader_program(Renderer *r) {
     r->uniforms[1] = glGetUniformLocation(r->program, "time");
     r->uniforms[2] = glGetUniformLocation(r->program, "mouse");
     r->uniforms[3] = glGetUniformLocation(r->program, "tex");
+    r->uniforms[4] = glGetUniformLocation(r->program, "board_size");
+    r->uniforms[5] = glGetUniformLocation(r->program, "visible_rows");
+    r->uniforms[6] = glGetUniformLocation(r->program, "show_grid");
+    r->uniforms[7] = glGetUniformLocation(r->program, "head");
+    glUniform1i(r->uniforms[3], 0);
+
+    // The history view draws the densities of the history pyramid, filtered
+    // on the CPU already, over the background
+    const char *history_fragment_source =
+        "#version 330 core\n"
+        "in vec2 fragUV;\n"
+        "in vec4 fragColor;\n"
+        "uniform sampler2D tex;\n"
+        "out vec4 finalColor;\n"
+        "void main() {\n"
+        "    finalColor = vec4(fragColor.rgb, texture(tex, fragUV).r);\n"
+        "}\n";
+
+    if (!compile_shader_source(vertex_source, GL_VERTEX_SHADER, &vert_shader)) {
+        return false;
+    }
+    if (!compile_shader_source(history_fragment_source, GL_FRAGMENT_SHADER, &frag_shader)) {
+        return false;
+    }
+    if (!link_program(vert_shader, frag_shader, &r->history_program)) {
+        return false;
+    }
+
+    glUseProgram(r->history_program);
+    r->history_uniforms[0] = glGetUniformLocation(r->history_program, "resolution");
+    r->history_uniforms[1] = glGetUniformLocation(r->history_program, "tex");
+    glUniform1i(r->history_uniforms[1], 0);
+
+    // The HUD is flat colored quads on top of everything else
+    const char *hud_fragment_source =
+        "#version 330 core\n"
+        "in vec2 fragUV;\n"
+        "in vec4 fragColor;\n"
+        "out vec4 finalColor;\n"
+        "void main() {\n"
+        "    finalColor = fragColor;\n"
+        "}\n";
+
+    if (!compile_shader_source(vertex_source, GL_VERTEX_SHADER, &vert_shader)) {
+        return false;
+    }
+    if (!compile_shader_source(hud_fragment_source, GL_FRAGMENT_SHADER, &frag_shader)) {
+        return false;
+    }
+    if (!link_program(vert_shader, frag_shader, &r->hud_program)) {
+        return false;
+    }
+    r->hud_uniforms[0] = glGetUniformLocation(r->hud_program, "resolution");
 
     return true;
 }
 
 // Rule 110 functions
-Row next_row(Row prev) {
-    Row next = {0};
-    for (int i = 0; i < COLS; ++i) {
-        int left = (i == 0) ? 0 : prev.cells[i-1];
-        int center = prev.cells[i];
-        int right = (i == COLS-1) ? 0 : prev.cells[i+1];
-        int pattern_index = (left << 2) | (center << 1) | right;
-        next.cells[i] = patterns[pattern_index];
-    }
-    return next;
-}
-
-Row random_row(void) {
-    Row result = {0};
-    // Start with a single cell in the middle
-    result.cells[COLS/2] = I;
-    // Or add some randomness
-    for (int i = 0; i < COLS; ++i) {
-        if (rand() % 100 < 5) { // 5% chance
-            result.cells[i] = I;
-        }
+void random_row(BitRow *row, uint64_t seed) {
+    // Some randomness, 5% of the cells, the same for a seed
+    randfill(row->bits, row->width, 1, row->words, seed, 0.05, 1);
+    // And always a single cell in the middle
+    bitrow_set(row, COLS/2, true);
+}
+
+/* The row shown on screen row i. */
+BitRow *board_row(Board *board, int i) {
+    return &board->rows[(board->head + i) % ROWS];
+}
+
+/* Add count slots from begin, wrapping around the ring, to the slots the
+ * renderer has to upload. They are kept as the shortest arc of the ring
+ * covering both, so scrolling from the last slot onto the first still
+ * uploads only the new rows. */
+void board_mark_dirty(Board *board, int begin, int count) {
+    if (board->dirty_count == 0) {
+        board->dirty_begin = begin;
+        board->dirty_count = count;
+        return;
     }
-    return result;
+    // The arc from the old begin to the end of the new slots, or the other
+    // way around
+    int from_old = (begin - board->dirty_begin + ROWS) % ROWS + count;
+    int from_new = (board->dirty_begin - begin + ROWS) % ROWS + board->dirty_count;
+    if (from_old < board->dirty_count) from_old = board->dirty_count;
+    if (from_new < count) from_new = count;
+    if (from_old <= from_new) {
+        board->dirty_count = from_old;
+    } else {
+        board->dirty_begin = begin;
+        board->dirty_count = from_new;
+    }
+    if (board->dirty_count > ROWS) board->dirty_count = ROWS;
 }
 
-void board_init(Board *board) {
-    memset(board, 0, sizeof(*board));
-    board->rows[0] = random_row();
+void board_init(Board *board, uint64_t seed) {
+    // Rows are allocated once and reused by every reset
+    for (int i = 0; i < ROWS; ++i) {
+        if (board->rows[i].bits == NULL && !bitrow_init(&board->rows[i], COLS)) {
+            panic_errno("Could not allocate board row");
+        }
+        bitrow_clear(&board->rows[i]);
+    }
+    random_row(&board->rows[0], seed);
+    board->head = 0;
     board->current_row = 0;
     board->generation = 0;
+    board_mark_dirty(board, 0, ROWS);
 }
 
-void board_next_generation(Board *board) {
+/* Make room for a new bottom row and return its slot. */
+int board_advance(Board *board) {
+    int slot;
     if (board->current_row < ROWS - 1) {
         board->current_row++;
-        board->rows[board->current_row] = next_row(board->rows[board->current_row - 1]);
-        board->generation++;
+        slot = (board->head + board->current_row) % ROWS;
+    } else {
+        // Scroll up - the oldest slot becomes the new bottom row
+        slot = board->head;
+        board->head = (board->head + 1) % ROWS;
+    }
+    board_mark_dirty(board, slot, 1);
+    return slot;
+}
+
+void board_next_generation(Board *board) {
+    BitRow *prev = board_row(board, board->current_row);
+    bitrow_rule110(prev, &board->rows[board_advance(board)]);
+    board->generation++;
+}
+
+/* Add a row computed elsewhere at the bottom of the board; a restart row
+ * becomes the only row of the board. */
+void board_push_row(Board *board, const uint64_t *bits, uint64_t generation, bool restart) {
+    int slot;
+    if (restart) {
+        board->head = 0;
+        board->current_row = 0;
+        slot = 0;
+        board_mark_dirty(board, 0, 1);
     } else {
-        // Scroll up - shift all rows up and generate new bottom row
-        for (int i = 0; i < ROWS - 1; ++i) {
-            board->rows[i] = board->rows[i + 1];
+        slot = board_advance(board);
+    }
+    memcpy(board->rows[slot].bits, bits, board->rows[slot].words * sizeof(uint64_t));
+    board->generation = generation;
+}
+
+/* Take the rows the simulation sent since the last frame. Only the newest
+ * ROWS of them can be on screen, older ones are dropped without a copy. */
+void board_receive(Board *board, RowQueue *queue) {
+    size_t count = rowqueue_count(queue);
+    size_t first = count > ROWS ? count - ROWS : 0;
+    for (size_t i = first; i < count; ++i) {
+        uint64_t generation;
+        bool restart;
+        const uint64_t *bits = rowqueue_row(queue, i, &generation, &restart);
+        board_push_row(board, bits, generation, restart || (i == first && first > 0));
+    }
+    rowqueue_pop(queue, count);
+}
+
+// Simulation thread
+
+/* Send the newest row of the simulation board. When the renderer falls
+ * behind and the queue fills up rows are dropped, and as soon as there is
+ * room again the whole board goes out, starting with a restart row, so the
+ * renderer never shows a history with holes in it. */
+void sim_publish(Simulation *s) {
+    Board *b = &s->board;
+    if (s->in_sync && rowqueue_push(&s->queue, board_row(b, b->current_row), b->generation, false)) return;
+    s->in_sync = false;
+    size_t rows = b->current_row + 1;
+    if (rowqueue_space(&s->queue) < rows) return;
+    for (size_t i = 0; i < rows; ++i) {
+        rowqueue_push(&s->queue, board_row(b, i), b->generation - (rows - 1 - i), i == 0);
+    }
+    s->in_sync = true;
+}
+
+void sleep_ns(uint64_t ns) {
+    struct timespec ts = {(time_t)(ns / 1000000000), (long)(ns % 1000000000)};
+    nanosleep(&ts, NULL);
+}
+
+uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void *sim_main(void *arg) {
+    Simulation *s = arg;
+    uint64_t deadline = now_ns();
+    while (__atomic_load_n(&s->running, __ATOMIC_ACQUIRE)) {
+        if (__atomic_exchange_n(&s->reset, false, __ATOMIC_ACQ_REL)) {
+            board_init(&s->board, ++s->seed);
+            history_clear(s->history);
+            history_append(s->history, board_row(&s->board, 0));
+            s->in_sync = false;
+            sim_publish(s);
         }
-        board->rows[ROWS - 1] = next_row(board->rows[ROWS - 2]);
-        board->generation++;
+
+        bool step = !__atomic_load_n(&s->paused, __ATOMIC_ACQUIRE);
+        if (!step && __atomic_load_n(&s->steps, __ATOMIC_ACQUIRE) > 0) {
+            __atomic_fetch_sub(&s->steps, 1, __ATOMIC_ACQ_REL);
+            step = true;
+        }
+        if (!step) {
+            sleep_ns(1000000);
+            deadline = now_ns();
+            continue;
+        }
+
+        uint64_t start = now_ns();
+        board_next_generation(&s->board);
+        history_append(s->history, board_row(&s->board, s->board.current_row));
+        sim_publish(s);
+        perfstats_record(s->stats, PHASE_STEP, now_ns() - start);
+        perfstats_add_generations(s->stats, 1);
+
+        // A zero generation time runs the automaton as fast as it goes
+        uint64_t generation_ns = __atomic_load_n(&s->generation_ns, __ATOMIC_ACQUIRE);
+        if (generation_ns > 0) {
+            deadline += generation_ns;
+            uint64_t now = now_ns();
+            if (deadline > now) sleep_ns(deadline - now);
+            else deadline = now;
+        }
+    }
+    return NULL;
+}
+
+void sim_set_generation_time(Simulation *s, double seconds) {
+    __atomic_store_n(&s->generation_ns, (uint64_t)(seconds * 1e9), __ATOMIC_RELEASE);
+}
+
+void sim_start(Simulation *s) {
+    if (!rowqueue_init(&s->queue, QUEUE_ROWS, COLS)) {
+        panic_errno("Could not allocate the row queue");
+    }
+    s->history = history_new(COLS, HISTORY_BUDGET);
+    if (s->history == NULL) {
+        panic_errno("Could not allocate the history");
+    }
+    board_init(&s->board, s->seed);
+    history_append(s->history, board_row(&s->board, 0));
+    s->in_sync = false;
+    sim_publish(s);
+    s->running = true;
+    sim_set_generation_time(s, generation_time);
+    if (pthread_create(&s->thread, NULL, sim_main, s) != 0) {
+        fprintf(stderr, "ERROR: could not start the simulation thread\n");
+        exit(1);
     }
 }
 
+void sim_stop(Simulation *s) {
+    __atomic_store_n(&s->running, false, __ATOMIC_RELEASE);
+    pthread_join(s->thread, NULL);
+    rowqueue_free(&s->queue);
+    history_free(s->history);
+}
+
 // Rendering functions
 void r_vertex(Renderer *r, V2f pos, V2f uv, V4f color) {
     if (r->vertex_buf_sz >= VERTEX_BUF_CAP) {
@@ -317,64 +612,228 @@ void r_clear(Renderer *r) {
     r->vertex_buf_sz = 0;
 }
 
+/* Upload the slots that changed since the last frame to the board texture,
+ * which holds the ring as it is, so a scrolling generation is one row.
+ * Rows go up bit-packed as they are, 32 cells per texel. */
+void r_upload_board(Renderer *r, Board *board) {
+    glBindTexture(GL_TEXTURE_2D, r->board_tex);
+    for (int i = 0; i < board->dirty_count; ++i) {
+        int slot = (board->dirty_begin + i) % ROWS;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, slot, (GLsizei)(board->rows[slot].words * 2), 1,
+                        GL_RED_INTEGER, GL_UNSIGNED_INT, board->rows[slot].bits);
+    }
+    board->dirty_begin = board->dirty_count = 0;
+}
+
+/* The cells and the grid are both drawn by the fragment shader, so the
+ * board is a single quad whatever its size and population. */
 void board_render(Renderer *r, const Board *board, int width, int height) {
-    float cell_width = (float)width / COLS;
-    float cell_height = (float)height / ROWS;
-    
-    // Render cells first
     int max_row = (board->current_row < ROWS - 1) ? board->current_row : ROWS - 1;
-    for (int row = 0; row <= max_row; ++row) {
-        for (int col = 0; col < COLS; ++col) {
-            if (board->rows[row].cells[col] == I) {
-                float x = col * cell_width;
-                float y = row * cell_height;
-                r_quad(r, 
-                       v2f(x, y), 
-                       v2f(x + cell_width, y + cell_height), 
-                       COLOR_PINK_V4F);
+    glUniform2i(r->uniforms[4], COLS, ROWS);
+    glUniform1i(r->uniforms[5], max_row + 1);
+    glUniform1i(r->uniforms[6], show_grid);
+    glUniform1i(r->uniforms[7], board->head);
+    r_quad(r, v2f(0, 0), v2f(width, height), COLOR_PINK_V4F);
+}
+
+/* Draw the part of the history under the window. Only the texels on screen
+ * are read from the history, and only when the view moved or new
+ * generations came in, so a frame costs the same however long the run. */
+void history_view_render(Renderer *r, HistoryView *v, History *h, int width, int height) {
+    int level = v->zoom > 0 ? v->zoom : 0;
+    int64_t level_width = (int64_t)history_level_width(h, level);
+    int texel_px = v->zoom < 0 ? 1 << -v->zoom : 1;
+    // A tape narrower than the window is stretched to fill it
+    if (level_width * texel_px < width) texel_px = width / level_width;
+    int64_t visible_cols = width / texel_px, visible_rows = height / texel_px;
+
+    // Level 0 only has whole bands of HISTORY_TILE generations
+    uint64_t generations = history_generations(h);
+    int64_t known = (int64_t)((level == 0 ? generations / HISTORY_TILE * HISTORY_TILE : generations) >> level);
+
+    int64_t last_tx = level_width > visible_cols ? level_width - visible_cols : 0;
+    int64_t last_ty = known > visible_rows ? known - visible_rows : 0;
+    int64_t tx = v->x > 0 ? v->x >> level : 0;
+    int64_t ty = v->follow ? last_ty : v->y > 0 ? v->y >> level : 0;
+    if (tx > last_tx) tx = last_tx;
+    if (ty > last_ty) ty = last_ty;
+    v->x = tx << level;
+    v->y = ty << level;
+    v->span_x = visible_cols << level;
+    v->span_y = visible_rows << level;
+
+    int cols = (int)(visible_cols + 1 < level_width ? visible_cols + 1 : level_width);
+    int rows = (int)visible_rows + 1;
+    glBindTexture(GL_TEXTURE_2D, r->history_tex);
+    if (level != v->level || texel_px != v->texel_px || cols != v->cols || rows != v->rows ||
+        tx != v->tx || ty != v->ty || generations != v->generations) {
+        size_t size = (size_t)cols * rows;
+        if (size > v->texels_cap) {
+            v->texels = realloc(v->texels, size);
+            if (v->texels == NULL) {
+                panic_errno("Could not allocate the history view");
             }
+            v->texels_cap = size;
         }
+        history_read(h, level, tx, ty, cols, rows, v->texels);
+        if (cols != v->cols || rows != v->rows) {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, cols, rows, 0, GL_RED, GL_UNSIGNED_BYTE, v->texels);
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, cols, rows, GL_RED, GL_UNSIGNED_BYTE, v->texels);
+        }
+        v->level = level;
+        v->texel_px = texel_px;
+        v->cols = cols;
+        v->rows = rows;
+        v->tx = tx;
+        v->ty = ty;
+        v->generations = generations;
     }
 
-    // Render grid if enabled (optimized - only render visible area)
-    if (show_grid && cell_width > 2.0f && cell_height > 2.0f) {
-        V4f grid_color = v4f(0.2f, 0.2f, 0.2f, 0.3f);
-        
-        // Vertical lines (skip some if too dense)
-        int col_step = (cell_width < 4.0f) ? 5 : 1;
-        for (int col = 0; col <= COLS; col += col_step) {
-            float x = col * cell_width;
-            r_line(r, v2f(x, 0), v2f(x, height), grid_color, 1.0f);
-        }
-        
-        // Horizontal lines (skip some if too dense)
-        int row_step = (cell_height < 4.0f) ? 5 : 1;
-        for (int row = 0; row <= max_row; row += row_step) {
-            float y = row * cell_height;
-            r_line(r, v2f(0, y), v2f(width, y), grid_color, 1.0f);
+    glUseProgram(r->history_program);
+    glUniform2f(r->history_uniforms[0], (float)width, (float)height);
+    r_quad(r, v2f(0, 0), v2f(cols * texel_px, rows * texel_px), COLOR_PINK_V4F);
+}
+
+// 3x5 glyphs for the HUD, one octal digit per row from the top with the
+// leftmost pixel in the high bit; capitals are drawn as lower case
+static const uint16_t hud_font[128] = {
+    ['0'] = 075557, ['1'] = 026227, ['2'] = 071747, ['3'] = 071717, ['4'] = 055711,
+    ['5'] = 074717, ['6'] = 074757, ['7'] = 071111, ['8'] = 075757, ['9'] = 075717,
+    ['a'] = 025755, ['b'] = 065656, ['c'] = 034443, ['d'] = 065556, ['e'] = 074647,
+    ['f'] = 074644, ['g'] = 034553, ['h'] = 055755, ['i'] = 072227, ['j'] = 011152,
+    ['k'] = 055655, ['l'] = 044447, ['m'] = 057755, ['n'] = 065555, ['o'] = 025552,
+    ['p'] = 065644, ['q'] = 025563, ['r'] = 065655, ['s'] = 034216, ['t'] = 072222,
+    ['u'] = 055557, ['v'] = 055552, ['w'] = 055775, ['x'] = 055255, ['y'] = 055222,
+    ['z'] = 071247, ['.'] = 000002, ['/'] = 011244, [':'] = 002020, ['-'] = 000700,
+};
+
+#define HUD_PIXEL 3.0f
+#define HUD_LINE (7 * HUD_PIXEL)
+#define HUD_ADVANCE (4 * HUD_PIXEL)
+
+void hud_text(Renderer *r, V2f p, const char *text, V4f color) {
+    for (; *text != '\0'; ++text, p.x += HUD_ADVANCE) {
+        unsigned char c = (unsigned char)*text;
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        uint16_t glyph = c < 128 ? hud_font[c] : 0;
+        for (int y = 0; y < 5; ++y) {
+            for (int x = 0; x < 3; ++x) {
+                if (((glyph >> ((4 - y) * 3 + (2 - x))) & 1) == 0) continue;
+                V2f a = v2f(p.x + x * HUD_PIXEL, p.y + y * HUD_PIXEL);
+                r_quad(r, a, v2f_add(a, v2f(HUD_PIXEL, HUD_PIXEL)), color);
+            }
         }
     }
 }
 
+/* The timings of the last whole second in the top left corner: the
+ * generations per second and the p50 and p99 of every phase. */
+void hud_render(Renderer *r, const PerfStats *stats) {
+    char lines[PHASES + 1][64];
+    snprintf(lines[0], sizeof(lines[0]), "%.0f gen/s", stats->last_rate);
+    size_t longest = strlen(lines[0]);
+    for (int i = 0; i < PHASES; ++i) {
+        char p50[16], p99[16];
+        perfstats_format(p50, sizeof(p50), stats->last[i].p50);
+        perfstats_format(p99, sizeof(p99), stats->last[i].p99);
+        snprintf(lines[i + 1], sizeof(lines[i + 1]), "%-8s p50 %-8s p99 %s", phase_names[i], p50, p99);
+        if (strlen(lines[i + 1]) > longest) longest = strlen(lines[i + 1]);
+    }
+
+    float margin = 2 * HUD_PIXEL;
+    r_quad(r, v2f(0, 0), v2f(longest * HUD_ADVANCE + 2 * margin, (PHASES + 1) * HUD_LINE + 2 * margin),
+           v4f(0.0f, 0.0f, 0.0f, 0.7f));
+    for (int i = 0; i <= PHASES; ++i) {
+        hud_text(r, v2f(margin, margin + i * HUD_LINE), lines[i], COLOR_GREEN_V4F);
+    }
+}
+
+/* Zoom and pan the history view, keeping the centre of the screen where it
+ * is when zooming. Returns false for keys the view does not use. */
+bool history_view_key(HistoryView *v, int key) {
+    switch (key) {
+        case GLFW_KEY_EQUAL:
+            if (v->zoom <= -HISTORY_MAX_ZOOM_IN) break;
+            v->zoom--;
+            v->x += v->span_x / 4;
+            v->y += v->span_y / 4;
+            break;
+        case GLFW_KEY_MINUS:
+            if (v->zoom >= HISTORY_LEVELS - 1) break;
+            v->zoom++;
+            v->x -= v->span_x / 2;
+            v->y -= v->span_y / 2;
+            break;
+        case GLFW_KEY_LEFT:
+            v->x -= v->span_x / 4;
+            break;
+        case GLFW_KEY_RIGHT:
+            v->x += v->span_x / 4;
+            break;
+        case GLFW_KEY_UP:
+            v->y -= v->span_y / 4;
+            v->follow = false;
+            break;
+        case GLFW_KEY_DOWN:
+            v->y += v->span_y / 4;
+            v->follow = false;
+            break;
+        case GLFW_KEY_PAGE_UP:
+            v->y -= v->span_y;
+            v->follow = false;
+            break;
+        case GLFW_KEY_PAGE_DOWN:
+            v->y += v->span_y;
+            v->follow = false;
+            break;
+        case GLFW_KEY_HOME:
+            v->y = 0;
+            v->follow = false;
+            break;
+        case GLFW_KEY_END:
+            v->follow = true;
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     (void) scancode; (void) mods;
 
+    if (action == GLFW_PRESS || action == GLFW_REPEAT) {
+        if (view.enabled && history_view_key(&view, key)) return;
+    }
+
     if (action == GLFW_PRESS) {
         switch (key) {
             case GLFW_KEY_SPACE:
                 paused = !paused;
+                __atomic_store_n(&sim.paused, paused, __ATOMIC_RELEASE);
                 break;
             case GLFW_KEY_R:
-                board_init(&board);
+                __atomic_store_n(&sim.reset, true, __ATOMIC_RELEASE);
                 break;
             case GLFW_KEY_G:
                 show_grid = !show_grid;
                 break;
+            case GLFW_KEY_H:
+                view.enabled = !view.enabled;
+                break;
+            case GLFW_KEY_T:
+                show_hud = !show_hud;
+                break;
             case GLFW_KEY_UP:
-                generation_time = fmax(0.01, generation_time - 0.01);
+                // All the way up the simulation runs at full speed
+                generation_time = fmax(0.0, generation_time - 0.01);
+                if (generation_time < 0.005) generation_time = 0.0;
+                sim_set_generation_time(&sim, generation_time);
                 break;
             case GLFW_KEY_DOWN:
                 generation_time = fmin(1.0, generation_time + 0.01);
+                sim_set_generation_time(&sim, generation_time);
                 break;
             case GLFW_KEY_ESCAPE:
             case GLFW_KEY_Q:
@@ -383,7 +842,7 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
         }
         
         if (paused && key == GLFW_KEY_RIGHT) {
-            board_next_generation(&board);
+            __atomic_fetch_add(&sim.steps, 1, __ATOMIC_ACQ_REL);
         }
     }
 }
@@ -412,9 +871,51 @@ void r_init(Renderer *r) {
     // Color attribute
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(4 * sizeof(float)));
+
+    // Board texture, one 32-bit texel per 32 cells; integer textures can
+    // only be sampled with nearest filtering
+    glGenTextures(1, &r->board_tex);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, r->board_tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, (GLsizei)(bitrow_words(COLS) * 2), ROWS, 0,
+                 GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+    // History view texture, one density byte per texel; it is allocated at
+    // the size of the view when it is first shown
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glGenTextures(1, &r->history_tex);
+    glBindTexture(GL_TEXTURE_2D, r->history_tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 }
 
-int main() {
+int main(int argc, char **argv) {
+    const char *stats_path = NULL;
+    uint64_t seed = time(NULL);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            stats_path = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            if (!randfill_parse_seed(argv[++i], &seed)) exit(1);
+        } else {
+            fprintf(stderr, "Usage: %s [--stats <file>] [--seed N]\n", argv[0]);
+            exit(1);
+        }
+    }
+
+    // Frames are always timed, for the HUD, and every second goes to the
+    // stats file if there is one
+    PerfStats *stats = perfstats_new(phase_names, PHASES, stats_path);
+    if (stats == NULL) {
+        exit(1);
+    }
+
     if (!glfwInit()) {
         fprintf(stderr, "Could not initialize GLFW\n");
         exit(1);
@@ -440,39 +941,34 @@ int main() {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    srand(time(NULL));
-    
     // Initialize renderer and board
     r_init(&renderer);
     if (!load_shader_program(&renderer)) {
         fprintf(stderr, "Failed to load shaders\n");
         exit(1);
     }
-    board_init(&board);
+    board_init(&board, seed);
+    sim.seed = seed;
+    sim.stats = stats;
+    sim_start(&sim);
 
+    printf("Seed: %" PRIu64 " (every reset takes the next one)\n", seed);
     printf("Controls:\n");
     printf("  SPACE - Pause/Resume\n");
     printf("  R - Reset\n");
     printf("  G - Toggle Grid\n");
-    printf("  UP/DOWN - Speed control\n");
+    printf("  UP/DOWN - Speed control (all the way up is full speed)\n");
     printf("  RIGHT - Step (when paused)\n");
+    printf("  T - Toggle the frame timings\n");
+    printf("  H - Toggle the history of the whole run\n");
+    printf("    +/- - Zoom, arrows/PAGE UP/PAGE DOWN - Pan, HOME/END - First/newest generations\n");
     printf("  Q/ESC - Quit\n");
 
-    double prev_time = glfwGetTime();
-    
     while (!glfwWindowShouldClose(window)) {
-        double current_time = glfwGetTime();
-        double delta_time = current_time - prev_time;
-        prev_time = current_time;
-
-        // Update simulation
-        if (!paused) {
-            time_accumulator += delta_time;
-            while (time_accumulator >= generation_time) {
-                board_next_generation(&board);
-                time_accumulator -= generation_time;
-            }
-        }
+        uint64_t frame_start = now_ns();
+
+        // Take whatever the simulation thread produced since the last frame
+        board_receive(&board, &sim.queue);
 
         // Get window size
         int width, height;
@@ -483,20 +979,41 @@ int main() {
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        // Render
-        glUseProgram(renderer.program);
-        glUniform2f(renderer.uniforms[0], (float)width, (float)height);
-        
+        // Render; the history view reads and uploads its texels while it is
+        // built, which counts as building
         r_clear(&renderer);
-        board_render(&renderer, &board, width, height);
-        r_sync_buffers(&renderer);
-        
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)renderer.vertex_buf_sz);
+        if (view.enabled) {
+            history_view_render(&renderer, &view, sim.history, width, height);
+        } else {
+            glUseProgram(renderer.program);
+            glUniform2f(renderer.uniforms[0], (float)width, (float)height);
+            board_render(&renderer, &board, width, height);
+        }
+        size_t scene_vertices = renderer.vertex_buf_sz;
+        if (show_hud) hud_render(&renderer, stats);
+        uint64_t built = now_ns();
+        perfstats_record(stats, PHASE_BUILD, built - frame_start);
 
+        if (!view.enabled) r_upload_board(&renderer, &board);
+        r_sync_buffers(&renderer);
+        uint64_t uploaded = now_ns();
+        perfstats_record(stats, PHASE_UPLOAD, uploaded - built);
+
+        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)scene_vertices);
+        if (show_hud) {
+            glUseProgram(renderer.hud_program);
+            glUniform2f(renderer.hud_uniforms[0], (float)width, (float)height);
+            glDrawArrays(GL_TRIANGLES, (GLint)scene_vertices, (GLsizei)(renderer.vertex_buf_sz - scene_vertices));
+        }
         glfwSwapBuffers(window);
+        perfstats_record(stats, PHASE_PRESENT, now_ns() - uploaded);
+
+        perfstats_poll(stats);
         glfwPollEvents();
     }
 
+    sim_stop(&sim);
+    free(view.texels);
     glfwTerminate();
-    return 0;
+    return perfstats_finish(stats) ? 0 : 1;
 }